@@ -55,7 +55,7 @@ namespace TREX {
       }
     }
 
-    Observation* getObservation(){
+    ObservationByValue* getObservation(){
 
       TREX_INFO("ros:debug:synchronization", nameString() << "First call - before checking flag. " <<
 		"Last updated at " << lastUpdated << " and last published " <<  lastPublished);
@@ -71,7 +71,7 @@ namespace TREX {
 	//TREX_INFO("ros:debug:synchronization", nameString() << "Transitioning INACTIVE with status=" << 
 	//	  LabelStr(getResultStatus(_observation).getSingletonValue()).toString());
 	
-	obs = new ObservationByValue(timelineName, inactivePredicate);
+	obs = ObservationPool::acquire(timelineName, inactivePredicate);
 
 	fillInactiveObservationParameters(_observation.feedback, obs);
 
@@ -81,7 +81,7 @@ namespace TREX {
       else if(isActiveObs(_observation) && !is_active){
 	TREX_INFO("ros:debug:synchronization", nameString() << "Transitioning ACTIVE");
 
-	obs = new ObservationByValue(timelineName, activePredicate);
+	obs = ObservationPool::acquire(timelineName, activePredicate);
 
 	fillActiveObservationParameters(_observation.goal, obs);
 
@@ -145,13 +145,13 @@ namespace TREX {
     bool synchronize(){
       TREX_INFO("ros:debug:synchronization", nameString() << "Synchronizing");
       // Derived class will populate actual observations
-      Observation* obs = NULL;
+      ObservationByValue* obs = NULL;
       obs = getObservation();
       
       if(obs != NULL){
 	TREX_INFO("ros:info", nameString() << "Found observation:" << obs->toString());
 	sendNotify(*obs);
-	delete obs;
+	ObservationPool::release(obs);
       }
       
       return true;
@@ -49,14 +49,127 @@
 #include "LogManager.hh"
 #include "AgentListener.hh"
 #include "DbCore.hh"
+#include "TraceLog.hh"
+#include "DebugStream.hh"
+#include "MutexWrapper.hh"
+#include "Guardian.hh"
+#include "Thread.hh"
+#include "Checkpoint.hh"
 #include <algorithm>
 #include <stdexcept>
+#include <sys/mman.h>
 
 namespace TREX {
 
   AgentId Agent::s_id;
+  __thread Agent* Agent::s_current = NULL;
+  unsigned int Agent::s_count = 0;
+
+  namespace {
+    /**
+     * @brief Guards the agents count and the first agent
+     */
+    Mutex& agentsMutex(){
+      static Mutex sl_mutex;
+      return sl_mutex;
+    }
+  }
+
+  /**
+   * @brief Writes the periodic checkpoints of an agent, so that the tick does not wait for the disk.
+   * The agent hands over a checkpoint captured right after synchronization. The writer polls for it,
+   * writes it and syncs the file, then reports the outcome on the next hand over.
+   */
+  class CheckpointWriter: public Thread {
+  public:
+    CheckpointWriter(const std::string& file)
+      : m_file(file), m_pending(NULL), m_busy(false), m_stopping(false) {}
+
+    ~CheckpointWriter(){
+      delete m_pending;
+    }
+
+    /**
+     * @brief Hand over @e state to write. Ownership is transferred.
+     * @return false, leaving @e state to the caller, if the previous checkpoint is not on disk yet
+     */
+    bool post(Checkpoint* state){
+      Guardian<Mutex> guard(m_mutex);
+      if(m_busy)
+	return false;
+      m_pending = state;
+      m_busy = true;
+      return true;
+    }
+
+    /**
+     * @brief True once the last checkpoint handed over is on disk, or failed to be.
+     * @param error Set to the reason of the failure, empty if none.
+     */
+    bool idle(std::string& error){
+      Guardian<Mutex> guard(m_mutex);
+      if(m_busy)
+	return false;
+      error = m_error;
+      m_error.clear();
+      return true;
+    }
+
+    /**
+     * @brief Stop the thread once done with what was handed over.
+     */
+    void shutdown(){
+      {
+	Guardian<Mutex> guard(m_mutex);
+	m_stopping = true;
+      }
+      try {
+	join();
+      }
+      catch(ThreadExcept const&){
+	// Already done
+      }
+    }
+
+  protected:
+    void* run(){
+      while(true){
+	Checkpoint* state = NULL;
+	{
+	  Guardian<Mutex> guard(m_mutex);
+	  if(m_pending == NULL && m_stopping)
+	    return NULL;
+	  std::swap(state, m_pending);
+	}
 
-  bool Agent::s_terminated(false);
+	if(state == NULL){
+	  Clock::sleep(0.01);
+	  continue;
+	}
+
+	std::string error;
+	try {
+	  state->write(m_file);
+	}
+	catch(ErrnoExcept const& e){
+	  error = e.what();
+	}
+	delete state;
+
+	Guardian<Mutex> guard(m_mutex);
+	m_error = error;
+	m_busy = false;
+      }
+    }
+
+  private:
+    const std::string m_file;
+    Mutex m_mutex; /*!< Guards all the members below */
+    Checkpoint* m_pending;
+    bool m_busy;
+    bool m_stopping;
+    std::string m_error;
+  };
 
   /**
    * This value is based on a notion of infinite time in EUROPA which is a limit of the system to avoid overflow in the temporal
@@ -66,6 +179,21 @@ namespace TREX {
     return PLUS_INFINITY / 8;
   }
 
+  Agent::AgendaPolicy Agent::getAgendaPolicy(const char * valueStr){
+    if(valueStr == NULL || strcmp(valueStr, "priority") == 0)
+      return PriorityAgenda;
+    if(strcmp(valueStr, "roundRobin") == 0)
+      return RoundRobinAgenda;
+    if(strcmp(valueStr, "weighted") == 0)
+      return WeightedAgenda;
+    if(strcmp(valueStr, "deadline") == 0)
+      return DeadlineAgenda;
+
+    ConfigurationException::configurationCheckError(false, "Invalid agenda policy - " + std::string(valueStr) +
+						    ". Expected priority, roundRobin, weighted or deadline.");
+    return PriorityAgenda;
+  }
+
   TICK Agent::getFinalTick(const char * valueStr){
     if(strcmp(valueStr, "forever") == 0)
       return  forever();
@@ -88,52 +216,295 @@ namespace TREX {
     AgentId m_agent;
   };
 
-  AgentId Agent::initialize(const TiXmlElement& configData, Clock& clock, TICK timeLimit, bool enableEventLog){
-    checkError(s_id.isNoId(), "Already have an active agent. Must reset first.");
-    new Agent(configData, clock, timeLimit, enableEventLog);
-    return s_id;
+  AgentId Agent::initialize(const TiXmlElement& configData, Clock& clock, TICK timeLimit, bool enableEventLog,
+			    const char* checkpoint){
+    // Checked first, so that an invalid setting leaves nothing behind
+    ThreadConfig threadConfig = parseThreadConfig(configData);
+
+    LogManager* logs = NULL;
+    bool hadDefault;
+    {
+      Guardian<Mutex> guard(agentsMutex());
+      hadDefault = s_id.isId();
+      // Agents running along the first one log to their own directory, leaving "latest" to the first
+      if(s_count++ > 0)
+	logs = new LogManager(false);
+      else
+	// A new run: its trace must not hold the events of the previous one
+	TraceLog::reset();
+    }
+    // The logs have to be in place before the agent allocates its own
+    Agent* const previous = s_current;
+    LogManager* const previousLogs = LogManager::s_current;
+    LogManager::s_current = logs;
+
+    Agent* agent;
+    try {
+      agent = new Agent(configData, clock, timeLimit, enableEventLog, logs, checkpoint);
+    }
+    catch(...){
+      // The agent was never alive: the next one has to be the first again
+      {
+	Guardian<Mutex> guard(agentsMutex());
+	s_count--;
+	if(!hadDefault)
+	  s_id = AgentId::noId();
+      }
+      s_current = previous;
+      LogManager::s_current = previousLogs;
+      delete logs;
+      throw;
+    }
+
+    agent->m_threadConfig = threadConfig;
+    configureThread(threadConfig);
+    return agent->getId();
+  }
+
+  /**
+   * @brief Read a CPU index at the start of text, moving text past it
+   */
+  static bool parseCpu(const char*& text, int& cpu){
+    // strtol would accept leading blanks and signs
+    if(*text < '0' || *text > '9')
+      return false;
+    char* end;
+    long value = strtol(text, &end, 10);
+    if(value >= CPU_SETSIZE)
+      return false;
+    cpu = (int) value;
+    text = end;
+    return true;
+  }
+
+  std::vector<int> Agent::parseCpus(const std::string& spec){
+    std::vector<int> set;
+    const char* text = spec.c_str();
+    bool valid = (*text != '\0');
+    while(valid && *text != '\0'){
+      int first, last;
+      valid = parseCpu(text, first);
+      last = first;
+      if(valid && *text == '-'){
+	text++;
+	valid = parseCpu(text, last) && first <= last;
+      }
+      if(valid && *text == ',')
+	valid = (*++text != '\0');
+      else
+	valid = valid && *text == '\0';
+      for(int i = first; valid && i <= last; i++)
+	set.push_back(i);
+    }
+    ConfigurationException::configurationCheckError(valid, "Invalid cpus - " + spec + ". Expected a list of cpu indices and ranges, e.g. 0,2-3.");
+    return set;
+  }
+
+  Agent::ThreadConfig Agent::parseThreadConfig(const TiXmlElement& configData){
+    ThreadConfig config;
+    const char* cpus = configData.Attribute("cpus");
+    if(cpus != NULL)
+      config.cpus = parseCpus(cpus);
+
+    const char* scheduler = configData.Attribute("scheduler");
+    const char* priority = configData.Attribute("priority");
+    if(scheduler != NULL || priority != NULL){
+      config.policy = Thread::otherPolicy;
+      if(scheduler != NULL && strcmp(scheduler, "fifo") == 0)
+	config.policy = Thread::fifoPolicy;
+      else
+	ConfigurationException::configurationCheckError(scheduler == NULL || strcmp(scheduler, "other") == 0,
+							"Invalid scheduler - " + std::string(scheduler == NULL ? "" : scheduler) + ". Expected other or fifo.");
+      config.priority = (priority == NULL ? (config.policy == Thread::fifoPolicy ? 1 : 0) : atoi(priority));
+    }
+
+    const char* lockMemory = configData.Attribute("lockMemory");
+    config.lockMemory = (lockMemory != NULL && strcmp(lockMemory, "true") == 0);
+    return config;
+  }
+
+  void Agent::configureThread(const ThreadConfig& config){
+    if(!config.cpus.empty()){
+      try {
+	Thread::setCurrentAffinity(config.cpus);
+      }
+      catch(ErrnoExcept const& e){
+	TREXLog() << "[agent] Failed to set cpus: " << e.what() << std::endl;
+      }
+    }
+
+    if(config.policy >= 0){
+      try {
+	Thread::setCurrentScheduling((Thread::Policy) config.policy, config.priority);
+      }
+      catch(ErrnoExcept const& e){
+	TREXLog() << "[agent] Failed to set scheduling: " << e.what() << std::endl;
+      }
+    }
+
+    bool locked = false;
+    if(config.lockMemory){
+      if(::mlockall(MCL_CURRENT | MCL_FUTURE) == 0)
+	locked = true;
+      else
+	TREXLog() << "[agent] Failed to lock memory: " << strerror(errno) << std::endl;
+    }
+
+    // Report what we actually got
+    try {
+      std::vector<int> set = Thread::getCurrentAffinity();
+      int policy, level;
+      Thread::getCurrentScheduling(policy, level);
+      std::ostringstream ss;
+      for(std::vector<int>::const_iterator it = set.begin(); it != set.end(); ++it)
+	ss << (it == set.begin() ? "" : ",") << *it;
+      TREXLog() << "[agent] Running on cpus " << ss.str() << " with " << (policy == SCHED_FIFO ? "fifo" : "other")
+		<< " scheduling at priority " << level << (locked ? ", memory locked." : ".") << std::endl;
+    }
+    catch(ErrnoExcept const& e){
+      TREXLog() << "[agent] Failed to read the thread settings: " << e.what() << std::endl;
+    }
+  }
+
+  void Agent::configureThread(Thread& thread) const {
+    try {
+      if(!m_threadConfig.cpus.empty())
+	thread.setAffinity(m_threadConfig.cpus);
+      if(m_threadConfig.policy >= 0)
+	thread.setScheduling((Thread::Policy) m_threadConfig.policy, m_threadConfig.priority);
+    }
+    catch(ErrnoExcept const& e){
+      TREXLog() << "[agent] Failed to set the cpus or scheduling of a thread: " << e.what() << std::endl;
+    }
   }
 
   const AgentId& Agent::instance(){
+    if(s_current != NULL)
+      return s_current->getId();
     return s_id;
   }
 
   void Agent::reset(){
-    checkError(s_id.isNoId() || s_id.isValid(), "Bad Agent Id.");
+    AgentId agent = instance();
+    checkError(agent.isNoId() || agent.isValid(), "Bad Agent Id.");
 
-    if(s_id.isId())
-      delete (Agent*) s_id;
+    if(agent.isId())
+      delete (Agent*) agent;
+  }
+
+  Agent::Scope::Scope(const AgentId& agent)
+    : m_previous(s_current), m_previousLogs(LogManager::s_current){
+    checkError(agent.isValid(), agent);
+    s_current = (Agent*) agent;
+    LogManager::s_current = s_current->m_logs;
+  }
 
-    s_id = AgentId::noId();
+  Agent::Scope::~Scope(){
+    s_current = m_previous;
+    LogManager::s_current = m_previousLogs;
   }
 
-  Agent::Agent(const TiXmlElement& configData, Clock& clock, TICK timeLimit, bool enableLogging): 
+  Agent::Agent(const TiXmlElement& configData, Clock& clock, TICK timeLimit, bool enableLogging, LogManager* logs,
+	       const char* checkpoint): 
     m_id(this), 
+    m_logs(logs),
+    m_terminated(false),
     m_name(extractData(configData, "name")),
     m_thisObserver(new AgentObserver(m_id)),
     m_currentTick(0),
     m_finalTick(timeLimit == 0 ?getFinalTick(extractData(configData, "finalTick").c_str()) : timeLimit),
     m_attempts(0),
+    m_selections(0),
+    m_agendaPolicy(getAgendaPolicy(configData.Attribute("agenda"))),
     m_clock(clock),
     m_synchUsage(RStat::zeroed), 
     m_deliberationUsage(RStat::zeroed),
+    m_stepOverruns(0),
+    m_burstCap(configData.Attribute("burstCap") == NULL ? 0 : atoi(configData.Attribute("burstCap"))),
+    m_burstSteps(0),
+    m_longestBurst(0),
+    m_cappedBursts(0),
+    m_latencyLog(LogManager::instance().file_name("latency.log").c_str()),
+    m_latencyPeriod(configData.Attribute("latencyReport") == NULL ? 100 : atoi(configData.Attribute("latencyReport"))),
+    m_checkpointFile(configData.Attribute("checkpoint") == NULL ? "" : configData.Attribute("checkpoint")),
+    m_checkpointPeriod(configData.Attribute("checkpointPeriod") == NULL ? 100 : atoi(configData.Attribute("checkpointPeriod"))),
+    m_checkpointWriter(NULL),
+    m_historyLimit(configData.Attribute("historyLimit") == NULL ? 0 : atoi(configData.Attribute("historyLimit"))),
+    m_coalesce(configData.Attribute("coalesce") == NULL || strcmp(configData.Attribute("coalesce"), "false") != 0),
+    m_coalescedObservations(0),
+    m_logObservations(configData.Attribute("logObservations") == NULL || strcmp(configData.Attribute("logObservations"), "false") != 0),
     m_enableEventLogger(enableLogging),
     m_obsLog(buildLogName(extractData(configData, "name"))),
-    m_standardDebugStream(DebugMessage::getStream()){
+    m_bus(NULL),
+    m_standardDebugStream(DebugStream::current()){
 
+    uint64_t const startupStart = LatencyHistogram::now();
     bool useExternalFile = (configData.Attribute("config") != NULL);
 
     // Obtain the configuration file if present, otherwise expect that the configuration is provided in-line
     const TiXmlElement* configSrcRoot = (useExternalFile ? initXml(findFile(extractData(configData, "config").toString()).c_str()) : &configData);
 
+    // Binary tracing of synchronization, e.g. trace="synchronization,tokenAgenda". See TraceLog.
+    if(configData.Attribute("traceCapacity") != NULL)
+      TraceLog::setCapacity(atoi(configData.Attribute("traceCapacity")));
+    if(configData.Attribute("trace") != NULL)
+      TraceLog::enable(configData.Attribute("trace"));
+
+    // syslog="false" skips the formatting of every TREXLog() entry
+    if(configData.Attribute("syslog") != NULL)
+      LogManager::instance().syslog().setEnabled(strcmp(configData.Attribute("syslog"), "false") != 0);
+
+    // historyLimit="N" compacts every N ticks and keeps about N ticks of monitor data instead of the whole run. See compact.
+    m_monitor.setCapacity(m_historyLimit);
+
+    LogManager::instance().getTickLog(CPU_STAT_LOG)->addField("stepOverruns", m_stepOverruns);
+    LogManager::instance().getTickLog(CPU_STAT_LOG)->addField("burst.nSteps", m_burstSteps);
+    LogManager::instance().getTickLog(CPU_STAT_LOG)->addField("burst.longest", m_longestBurst);
+    LogManager::instance().getTickLog(CPU_STAT_LOG)->addField("burst.nCapped", m_cappedBursts);
+    LogManager::instance().getTickLog(CPU_STAT_LOG)->addField("observations.coalesced", m_coalescedObservations);
+
+    // Timelines whose every observation has to be delivered, e.g. uncoalesced="a,b"
+    if(configData.Attribute("uncoalesced") != NULL){
+      std::string timelines(configData.Attribute("uncoalesced"));
+      std::string::size_type start = 0;
+      while(start < timelines.size()){
+	std::string::size_type end = timelines.find(',', start);
+	if(end == std::string::npos)
+	  end = timelines.size();
+	if(end > start)
+	  m_uncoalesced.insert(LabelStr(timelines.substr(start, end - start)));
+	start = end + 1;
+      }
+    }
+
+    // Shared memory publication for monitors, e.g. bus="/trex.agent" busSize="1048576"
+    if(configData.Attribute("bus") != NULL){
+      size_t busSize = (configData.Attribute("busSize") == NULL ? 1<<20 : atoi(configData.Attribute("busSize")));
+      try {
+	m_bus = new ObservationBus(configData.Attribute("bus"), busSize);
+	LogManager::instance().getTickLog(CPU_STAT_LOG)->addField("bus.dropped", m_bus->dropped());
+      }
+      catch(ErrnoExcept const& e){
+	TREXLog() << "[agent] No observation bus: " << e.what() << std::endl;
+      }
+    }
+
+    m_latencyLog << "report\ttick\treactor\tphase\t";
+    LatencyHistogram::printHeader(m_latencyLog);
+    m_latencyLog << std::endl;
+
     // Should always be true
     Entity::gcRequired() = true;
 
-    // Reset termination flag
-    s_terminated = false;
+    // Make it the current agent of this thread, and the default one if it is the first
+    s_current = this;
+    {
+      Guardian<Mutex> guard(agentsMutex());
+      if(s_id.isNoId())
+	s_id = m_id;
+    }
 
-    // Post static id.
-    s_id = m_id;
+    uint64_t const configured = LatencyHistogram::now() - startupStart;
 
     // This map will be populated as we read in the timeline modes for each reactor
     std::map<double, ServerId> serversByTimeline;
@@ -170,7 +541,9 @@ namespace TREX {
 	if(component == NULL)
 	  component = DEFAULT;
 	
+	uint64_t const constructStart = LatencyHistogram::now();
 	TeleoReactorId reactor = TeleoReactor::createInstance(m_name, component, *child);
+	reactor->addStartupPhase("construct", LatencyHistogram::now() - constructStart);
 	ConfigurationException::configurationCheckError(!getReactor(reactor->getName()).isId(), reactor->getName().toString() + " is not unique. It must be.");
 
 	m_reactorsByName.insert(std::pair<double, TeleoReactorId>(reactor->getName(), reactor));
@@ -210,15 +583,30 @@ namespace TREX {
     }
     
 
+    // One observation buffer per observer
+    for(std::multimap<LabelStr, ObserverId>::const_iterator it = m_observersByTimeline.begin(); it != m_observersByTimeline.end(); ++it)
+      if(m_pendingObservations.find(it->second) == m_pendingObservations.end())
+	m_pendingObservations.insert(std::make_pair(it->second, new ObservationBuffer()));
+
     // Reactors loaded : I can close the log header 
     m_obsLog.endHeader(getCurrentTick());
 
     // Now we should have built up the map for servers and so we can initialize the reactors with final communication binding
     for(std::vector<TeleoReactorId>::const_iterator it = m_reactors.begin(); it != m_reactors.end(); ++it){
       TeleoReactorId reactor = *it;
+      uint64_t const initStart = LatencyHistogram::now();
       reactor->doHandleInit(0, serversByTimeline, m_thisObserver);
+      reactor->addStartupPhase("handleInit", LatencyHistogram::now() - initStart);
     }
 
+    if(checkpoint != NULL)
+      restore(checkpoint);
+
+    // Achieved share of the deliberation time, per reactor. Sized once as the log keeps references.
+    m_cpuShares.resize(m_reactors.size(), 0.0);
+    for(unsigned int i = 0; i < m_reactors.size(); i++)
+      LogManager::instance().getTickLog(CPU_STAT_LOG)->addField(m_reactors[i]->getName().toString()+".search.cpuShare", m_cpuShares[i]);
+
     m_sortedReactors = m_reactors;
 
     // Sort for suitable dependency graph, uses a priority comparator
@@ -230,20 +618,41 @@ namespace TREX {
     // Deallocate configuration root
     if(useExternalFile)
       delete configSrcRoot;
+
+    reportStartup(configured, LatencyHistogram::now() - startupStart);
   }
 
   Agent::~Agent() {
     // Reset the Debug Message Stream before deallocating any reactors
-    DebugMessage::setStream(m_standardDebugStream);
+    DebugStream::select(m_standardDebugStream);
 
-    s_terminated = true;       
+    m_terminated = true;
 
     // Close the observation log
     m_obsLog.endFile();
 
+    // Let the last checkpoint reach the disk
+    if(m_checkpointWriter != NULL){
+      waitForCheckpoint();
+      m_checkpointWriter->shutdown();
+      delete m_checkpointWriter;
+    }
+
+    // Latencies over the whole run, while the reactors are still around
+    reportLatency(true);
+
+    // Drop the observations never delivered
+    for(std::map<ObserverId, ObservationBuffer*>::const_iterator it = m_pendingObservations.begin(); it != m_pendingObservations.end(); ++it)
+      delete it->second;
+
     // Delete all the reactors
     cleanup(m_reactorsByName);
 
+    delete m_bus;
+
+    // Write whatever was traced. Render it with the trextrace script.
+    TraceLog::dump(LogManager::instance().file_name("trace.bin"));
+
     // Garbage collect any remaining entities
     Entity::garbageCollect();
 
@@ -258,6 +667,21 @@ namespace TREX {
       delete (AgentListener *) l;
     }
 
+    {
+      Guardian<Mutex> guard(agentsMutex());
+      s_count--;
+      if(s_id == m_id)
+	s_id = AgentId::noId();
+    }
+    if(s_current == this)
+      s_current = NULL;
+
+    if(m_logs != NULL){
+      if(LogManager::s_current == m_logs)
+	LogManager::s_current = NULL;
+      delete m_logs;
+    }
+
     m_id.remove();
   }
 
@@ -265,6 +689,7 @@ namespace TREX {
    * @brief Run the agent to completion.
    */
   void Agent::run(){
+    Scope scope(m_id);
     m_clock.doStart();    
     LogManager::instance().handleInit();
 
@@ -278,11 +703,12 @@ namespace TREX {
 
   void Agent::terminate(){
     debugMsg("Agent:terminate", "Terminating the Agent.");
-    s_terminated = true;
+    if(instance().isId())
+      instance()->m_terminated = true;
   }
 
   bool Agent::terminated(){
-    return s_terminated;
+    return instance().isNoId() || instance()->m_terminated;
   }
 
   /**
@@ -294,6 +720,8 @@ namespace TREX {
    * @see executeReactor
    */
   bool Agent::doNext(){
+    Scope scope(m_id);
+
     if(missionCompleted())
       return false;
 
@@ -301,59 +729,318 @@ namespace TREX {
 
     synchronize();
 
+    if(!m_checkpointFile.empty() && m_checkpointPeriod > 0 && m_currentTick % m_checkpointPeriod == 0)
+      startCheckpoint();
+
     // Deliberate as necessary while we have cpu available.
     while(executeReactor() && m_clock.getNextTick() == m_currentTick){}
 
+    updateCpuShares();
+
     // Wait for next tick
     while(m_clock.getNextTick() == m_currentTick){m_clock.sleep();}
 
     // Output results
-    m_monitor.addTickData(m_synchUsage.user_time(), m_deliberationUsage.user_time());
+    m_monitor.addTickData(m_synchUsage, m_deliberationUsage);
     m_synchUsage.reset();
     m_deliberationUsage.reset();
 
+    if(m_latencyPeriod > 0 && (m_currentTick+1) % m_latencyPeriod == 0)
+      reportLatency(false);
+
+    if(m_historyLimit > 0 && (m_currentTick+1) % m_historyLimit == 0)
+      compact();
+
     // Advance the tick
     m_currentTick++;
     return true;
   }
 
-  bool Agent::executeReactor(){
-    TeleoReactorId reactor = nextReactor();
+  void Agent::reportLatency(bool final){
+    for(std::map<double, TeleoReactorId>::const_iterator it = m_reactorsByName.begin(); it != m_reactorsByName.end(); ++it)
+      it->second->reportLatency(m_latencyLog, final);
+    m_latencyLog.flush();
+  }
 
-    if(reactor.isId()){
-      RStatLap chrono(m_deliberationUsage, RStat::self);
-      reactor->doResume();
-      // If a zero latency reactor, then do not cede control. Recursive execution  instead. This allows for more robustness
-      // to timing errors for really reactive controllers
-      if(reactor->getLatency() == 0)
-	return executeReactor();
+  void Agent::reportStartup(uint64_t configured, uint64_t total){
+    std::ofstream out(LogManager::instance().file_name("startup.log").c_str());
+    out << "reactor\tphase\tmsec" << std::endl;
+    out << m_name.toString() << "\tconfig\t" << configured / 1e6 << std::endl;
 
-      return true;
+    TeleoReactorId slowest;
+    uint64_t slowestTime = 0;
+    for(std::vector<TeleoReactorId>::const_iterator it = m_reactors.begin(); it != m_reactors.end(); ++it){
+      const std::vector<std::pair<std::string, uint64_t> >& phases = (*it)->getStartupPhases();
+      uint64_t time = 0;
+      for(std::vector<std::pair<std::string, uint64_t> >::const_iterator phase = phases.begin(); phase != phases.end(); ++phase){
+	out << (*it)->getName().toString() << '\t' << phase->first << '\t' << phase->second / 1e6 << std::endl;
+	// construct already includes the steps recorded by the reactor constructor
+	if(phase->first == "construct" || phase->first == "handleInit" ||
+	   phase->first == "restore" || phase->first == "restoreLinks")
+	  time += phase->second;
+      }
+      if(slowest.isNoId() || time > slowestTime){
+	slowest = *it;
+	slowestTime = time;
+      }
     }
+    out << m_name.toString() << "\ttotal\t" << total / 1e6 << std::endl;
 
-    return false;
+    if(slowest.isId())
+      TREXLog() << "[agent] Started " << m_reactors.size() << " reactors in " << total / 1e6 << " ms, slowest "
+		<< slowest->getName().toString() << " in " << slowestTime / 1e6 << " ms. See startup.log" << std::endl;
+  }
+
+  void Agent::compact(){
+    // Events are kept for as long as any reactor keeps the tokens they are about
+    TICK frontier = m_currentTick + 1;
+    for(std::vector<TeleoReactorId>::const_iterator it = m_reactors.begin(); it != m_reactors.end(); ++it){
+      (*it)->doCompact();
+      frontier = std::min(frontier, (*it)->getArchiveFrontier());
+    }
+
+    std::vector<Event>::iterator kept = m_eventLog.begin();
+    while(kept != m_eventLog.end() && kept->m_tick < frontier)
+      ++kept;
+    m_eventLog.erase(m_eventLog.begin(), kept);
+
+    debugMsg("Agent:compact", "Kept " << m_eventLog.size() << " events from tick " << frontier);
+  }
+
+  bool Agent::captureCheckpoint(Checkpoint& state){
+    for(std::vector<TeleoReactorId>::const_iterator it = m_reactors.begin(); it != m_reactors.end(); ++it){
+      if(DbCoreId::convertable(*it)){
+	DbCoreId db = *it;
+	if(db->isInvalid()){
+	  debugMsg("Agent:writeCheckpoint", "Skipped as " << db->getName().toString() << " is invalid");
+	  return false;
+	}
+	db->checkpoint(state);
+      }
+    }
+    return true;
+  }
+
+  bool Agent::writeCheckpoint(const std::string& file){
+    Checkpoint state(m_name.toString(), m_currentTick);
+    if(!captureCheckpoint(state))
+      return false;
+    state.write(file);
+    debugMsg("Agent:writeCheckpoint", "Wrote " << file << " at tick " << m_currentTick);
+    return true;
+  }
+
+  void Agent::startCheckpoint(){
+    std::string error;
+    if(m_checkpointWriter == NULL){
+      // The writer runs with the cpus and scheduling of the agent, or with the defaults if the system refuses them
+      m_checkpointWriter = new CheckpointWriter(m_checkpointFile);
+      configureThread(*m_checkpointWriter);
+      try {
+	m_checkpointWriter->start();
+      }
+      catch(ErrnoExcept const& e){
+	TREXLog() << "[agent] Checkpoint writer started without the configured cpus and scheduling: " << e.what() << std::endl;
+	delete m_checkpointWriter;
+	m_checkpointWriter = new CheckpointWriter(m_checkpointFile);
+	m_checkpointWriter->start();
+      }
+    }
+    else if(!m_checkpointWriter->idle(error)){
+      TREXLog() << "[agent][" << m_currentTick << "] Checkpoint skipped: the previous one is still being written" << std::endl;
+      return;
+    }
+
+    if(!error.empty())
+      TREXLog() << "[agent][" << m_currentTick << "] Checkpoint failed: " << error << std::endl;
+
+    Checkpoint* state = new Checkpoint(m_name.toString(), m_currentTick);
+    if(!captureCheckpoint(*state) || !m_checkpointWriter->post(state))
+      delete state;
+  }
+
+  void Agent::waitForCheckpoint(){
+    if(m_checkpointWriter == NULL)
+      return;
+
+    std::string error;
+    while(!m_checkpointWriter->idle(error))
+      Clock::sleep(0.01);
+
+    if(!error.empty())
+      TREXLog() << "[agent][" << m_currentTick << "] Checkpoint failed: " << error << std::endl;
+  }
+
+  void Agent::restore(const std::string& file){
+    Checkpoint state;
+    try {
+      state.read(file);
+    }
+    catch(std::exception const& e){
+      ConfigurationException::configurationCheckError(false, std::string("Cannot resume: ") + e.what());
+    }
+    ConfigurationException::configurationCheckError(state.agent() == m_name.toString(),
+						     file + " is a checkpoint of agent " + state.agent());
+
+    m_currentTick = state.tick() + 1;
+    m_clock.resume(m_currentTick);
+
+    std::vector<DbCoreId> dbs;
+    for(std::vector<TeleoReactorId>::const_iterator it = m_reactors.begin(); it != m_reactors.end(); ++it)
+      if(DbCoreId::convertable(*it))
+	dbs.push_back(*it);
+
+    // Restore each database, then link the goals to the requests they came from, which may be restored later
+    std::map<std::string, std::map<uint32_t, TokenId> > restored;
+    for(std::vector<DbCoreId>::const_iterator it = dbs.begin(); it != dbs.end(); ++it){
+      DbCoreId db = *it;
+      const Checkpoint::Reactor* saved = state.reactor(db->getName().toString());
+      ConfigurationException::configurationCheckError(saved != NULL, file + " has no state for reactor " + db->getName().toString());
+      uint64_t const restoreStart = LatencyHistogram::now();
+      if(!db->restore(*saved, restored[saved->name]))
+	TREXLog() << "[agent][" << m_currentTick << "] " << db->getName().toString()
+		  << " restored an inconsistent plan and will repair it" << std::endl;
+      db->addStartupPhase("restore", LatencyHistogram::now() - restoreStart);
+    }
+
+    TokenSet linked;
+    for(std::vector<DbCoreId>::const_iterator it = dbs.begin(); it != dbs.end(); ++it){
+      uint64_t const linkStart = LatencyHistogram::now();
+      (*it)->restoreLinks(*state.reactor((*it)->getName().toString()), restored, linked);
+      (*it)->addStartupPhase("restoreLinks", LatencyHistogram::now() - linkStart);
+    }
+
+    for(std::vector<DbCoreId>::const_iterator it = dbs.begin(); it != dbs.end(); ++it)
+      (*it)->releaseDispatches(linked);
+
+    TREXLog() << "[agent] Resumed at tick " << m_currentTick << " from " << file << std::endl;
+  }
+
+  bool Agent::executeReactor(){
+    unsigned long burst = 0;
+
+    while(true){
+      TeleoReactorId reactor = nextReactor();
+
+      // Leave for the next tick the steps that would overrun this one. A step already deferred
+      // on an earlier tick runs regardless, or a slow reactor could wait forever.
+      while(reactor.isId()){
+	double cost = reactor->getStepCostEstimate();
+	if(reactor->isStepOverdue() || cost <= m_clock.timeToDeadline() || cost >= m_clock.getSecondsPerTick())
+	  break;
+	reactor->deferStep();
+	dropDeliberator(reactor);
+	reactor = nextReactor();
+      }
+
+      if(reactor.isNoId())
+	return false;
+
+      {
+	RStatLap chrono(m_deliberationUsage, RStat::self);
+	reactor->doResume();
+      }
+      double left = m_clock.timeToDeadline();
+      if(left < 0){
+	m_stepOverruns++;
+	TREXLog() << "[agent][" << m_currentTick << "] " << reactor->getName().toString() 
+		  << " step ended " << -left << " secs past the tick deadline." << std::endl;
+      }
+
+      if(reactor->getLatency() > 0)
+	return true;
+
+      // A zero latency reactor does not cede control. This allows for more robustness
+      // to timing errors for really reactive controllers
+      m_burstSteps++;
+      m_longestBurst = std::max(m_longestBurst, ++burst);
+
+      // Cede control for the caller to check the clock between steps
+      if(m_burstCap > 0 && burst >= m_burstCap){
+	m_cappedBursts++;
+	debugMsg("Agent:executeReactor", "[" << m_currentTick << "] Zero latency burst stopped after " << burst << " steps.");
+	return true;
+      }
+    }
   }
 
   /**
-   * @brief Selection of first available reactor
+   * @brief Selection of the next reactor with work, according to the agenda policy
    */
   TeleoReactorId Agent::nextReactor(){
-    static unsigned int sl_counter(0);
+    debugMsg("Agent:nextReactor", "[" << m_selections << "] Size=" << m_deliberators.size());
+    m_selections++;
+
+    if(m_agendaPolicy == PriorityAgenda){
+      // Remove the reactors that are done until the first one has work
+      while(!m_deliberators.empty() && (m_deliberators[0]->getLookAhead() == 0 || !m_deliberators[0]->hasWork()))
+	m_deliberators.erase(m_deliberators.begin());
 
-    debugMsg("Agent:nextReactor", "[" << sl_counter << "] Size=" << m_deliberators.size());
-    sl_counter++;
+      return m_deliberators.empty() ? TeleoReactorId::noId() : m_deliberators[0];
+    }
+
+    // The other policies compare all the candidates, so remove every reactor that is done
+    std::vector<TeleoReactorId>::iterator it = m_deliberators.begin();
+    while(it != m_deliberators.end()){
+      if((*it)->getLookAhead() == 0 || !(*it)->hasWork())
+	it = m_deliberators.erase(it);
+      else
+	++it;
+    }
 
     if(m_deliberators.empty())
       return TeleoReactorId::noId();
 
-    if(m_deliberators[0]->getLookAhead() > 0 && m_deliberators[0]->hasWork())
-      return m_deliberators[0];
+    TeleoReactorId reactor = m_deliberators[0];
+    switch(m_agendaPolicy){
+    case RoundRobinAgenda:
+      m_deliberators.erase(m_deliberators.begin());
+      m_deliberators.push_back(reactor);
+      break;
+    case WeightedAgenda:
+      for(it = m_deliberators.begin() + 1; it != m_deliberators.end(); ++it)
+	if((*it)->getTickSearchTime() / (*it)->getShare() < reactor->getTickSearchTime() / reactor->getShare())
+	  reactor = *it;
+      break;
+    case DeadlineAgenda:
+      // Ties go to the first in dependency order
+      for(it = m_deliberators.begin() + 1; it != m_deliberators.end(); ++it)
+	if((*it)->getPlanningDeadline() < reactor->getPlanningDeadline())
+	  reactor = *it;
+      break;
+    default:
+      break;
+    }
+
+    return reactor;
+  }
+
+  void Agent::dropDeliberator(const TeleoReactorId& reactor){
+    std::vector<TeleoReactorId>::iterator it = std::find(m_deliberators.begin(), m_deliberators.end(), reactor);
+    if(it != m_deliberators.end())
+      m_deliberators.erase(it);
+  }
 
-    // Remove the reactor that is done
-    m_deliberators.erase(m_deliberators.begin());
+  void Agent::updateCpuShares(){
+    double total = 0.0;
+    for(unsigned int i = 0; i < m_reactors.size(); i++)
+      total += m_reactors[i]->getTickSearchTime();
 
-    // Tail-recursion
-    return nextReactor();
+    for(unsigned int i = 0; i < m_reactors.size(); i++)
+      m_cpuShares[i] = (total > 0.0 ? m_reactors[i]->getTickSearchTime() / total : 0.0);
+  }
+
+  bool Agent::isValidObservation(const Observation& observation) const {
+    for(std::vector<TeleoReactorId>::const_iterator it = m_reactors.begin(); it != m_reactors.end(); ++it)
+      if(!(*it)->isValidObservation(observation))
+	return false;
+    return true;
+  }
+
+  double Agent::getCpuShare(const TeleoReactorId& reactor) const {
+    std::vector<TeleoReactorId>::const_iterator it = std::find(m_reactors.begin(), m_reactors.end(), reactor);
+    checkError(it != m_reactors.end(), "Not a reactor of agent " << m_name.toString());
+    return m_cpuShares[it - m_reactors.begin()];
   }
 
   const AgentId& Agent::getId() const { return m_id; }
@@ -400,6 +1087,8 @@ namespace TREX {
 
   void Agent::logRequest(const TokenId& goal){
     debugMsg("Agent:logRequest", goal->toString());
+    if(m_bus != NULL)
+      m_bus->publish(getCurrentTick(), ObservationBus::REQUEST, goal);
     if(m_enableEventLogger){
       ObjectId object = (ObjectId) goal->getObject()->lastDomain().getSingletonValue();
       m_eventLog.push_back(Agent::Event(getCurrentTick(), Agent::Request, object->getName().toString(), goal->getPredicateName()));
@@ -408,6 +1097,8 @@ namespace TREX {
 
   void Agent::logRecall(const TokenId& goal){
     debugMsg("Agent:logRecall", goal->toString());
+    if(m_bus != NULL)
+      m_bus->publish(getCurrentTick(), ObservationBus::RECALL, goal);
     if(m_enableEventLogger){
       ObjectId object = (ObjectId) goal->getObject()->lastDomain().getSingletonValue();
       m_eventLog.push_back(Agent::Event(getCurrentTick(), Agent::Recall, object->getName().toString(), goal->getPredicateName()));
@@ -418,8 +1109,12 @@ namespace TREX {
    * @brief Goes through the observersByTimeline structure set up on initialization and multi-casts to them
    */
   void Agent::notify(const Observation& observation){
-    debugMsg("Agent:notify", observation.toString());
-    TREXLog() << observation.toString() << std::endl;
+    debugMsg("Agent:notify", observation);
+    if(m_logObservations)
+      TREXLog() << observation << std::endl;
+
+    if(m_bus != NULL)
+      m_bus->publish(getCurrentTick(), observation);
 
     if(m_enableEventLogger)
       m_eventLog.push_back(Agent::Event(getCurrentTick(), Agent::Notify, observation.getObjectName(), observation.getPredicate()));
@@ -432,9 +1127,13 @@ namespace TREX {
       if(it->first != observation.getObjectName())
 	return;
 
-      // Otherwise, pass it on.
+      // Otherwise, pass it on, or hold it until the observer synchronizes
       ObserverId observer = it->second;
-      observer->notify(observation);
+      std::map<ObserverId, ObservationBuffer*>::const_iterator buffer = m_pendingObservations.find(observer);
+      if(!m_coalesce || buffer == m_pendingObservations.end() || m_synchronizedObservers.find(observer) != m_synchronizedObservers.end())
+	observer->notify(observation);
+      else
+	buffer->second->push(observation, m_uncoalesced.find(observation.getObjectName()) == m_uncoalesced.end());
     }
   }
 
@@ -447,11 +1146,22 @@ namespace TREX {
     std::vector<TeleoReactorId>::const_iterator it = m_sortedReactors.begin();
     while(it != m_sortedReactors.end() && !terminated()){
       TeleoReactorId r = *it;
+
+      // Deliver the observations posted so far in this tick
+      std::map<ObserverId, ObservationBuffer*>::const_iterator buffer = m_pendingObservations.find(r->toObserver());
+      if(buffer != m_pendingObservations.end())
+	buffer->second->flush(*(r->toObserver()));
+      m_synchronizedObservers.insert(r->toObserver());
+
       if(!r->doSynchronize())
 	throw std::runtime_error("Unknown synchronization failure. In a future iteration, this will be recoverable.");
       ++it;
     }
 
+    m_coalescedObservations = 0;
+    for(std::map<ObserverId, ObservationBuffer*>::const_iterator b = m_pendingObservations.begin(); b != m_pendingObservations.end(); ++b)
+      m_coalescedObservations += b->second->coalesced();
+
     LogManager::instance().handleNewTick(m_currentTick);
   }
 
@@ -469,6 +1179,9 @@ namespace TREX {
     // Reset the collection of deliberators
     m_deliberators = m_sortedReactors;
 
+    // Observations are held again until each observer synchronizes
+    m_synchronizedObservers.clear();
+
     // Iterate over all reactors and pass on the message
     std::vector<TeleoReactorId>::const_iterator it = m_reactors.begin();
     while(it != m_reactors.end() && !terminated()){
@@ -570,6 +1283,8 @@ namespace TREX {
 
   void Agent::setMonitor(PerformanceMonitor& monitor){
     m_monitor = monitor;
+    if(m_historyLimit > 0)
+      m_monitor.setCapacity(m_historyLimit);
   }
 
   const PerformanceMonitor& Agent::getMonitor()const {
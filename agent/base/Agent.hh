@@ -41,7 +41,8 @@
  * allocate reactors and connect them together according to their configuratiun requirements. It will also play the role
  * of middle-man to route observations from sender to receiver.
  * @status Documented
- * @note The Agent class is not thread safe.
+ * @note An Agent instance is not thread safe. Several agents can coexist in a process, but they must be driven from the
+ * same thread (see Agent::Scope), or their calls serialized with a lock : EUROPA's entity table and schema are process wide.
  */
 
 #include "TREXDefs.hh"
@@ -49,13 +50,21 @@
 #include "TeleoReactor.hh"
 #include "AgentClock.hh"
 #include "ObservationLogger.hh"
+#include "ObservationBus.hh"
 #include "PerformanceMonitor.hh"
 #include "RStat.hh"
+#include "LogManager.hh"
 #include <vector>
 #include <map>
+#include <set>
+#include <fstream>
 
 namespace TREX {
 
+  class Checkpoint;
+  class Thread;
+  class CheckpointWriter;
+
   /**
    * @brief The Agent is an observer of messages from TeleoReactors. It is the message bus for distribution of observations
    * @see TeleoReactor
@@ -73,6 +82,17 @@ namespace TREX {
       Recall /*!< For recalls made on a reactor */
     };
 
+    /**
+     * @brief Policies for choosing, among the reactors with deliberation work, the one to step next.
+     * Set with the agenda attribute of the agent configuration.
+     */
+    enum AgendaPolicy {
+      PriorityAgenda = 0, /*!< "priority": first reactor in dependency order, until it is done. The default */
+      RoundRobinAgenda, /*!< "roundRobin": one step for each reactor in turn */
+      WeightedAgenda, /*!< "weighted": reactor with the least deliberation time this tick relative to its share attribute */
+      DeadlineAgenda /*!< "deadline": reactor whose plan is due first */
+    };
+
     /**
      * @brief An Agent Event is used for logging. This is particularly useful when applying an event log for regression testing to validate
      * current execution against prior stored values.
@@ -89,19 +109,40 @@ namespace TREX {
     };
 
     /**
-     * @brief The Agent is a singleton per process.
+     * @brief Makes an agent the current one of the calling thread for the lifetime of this instance.
+     * Agent::instance() and LogManager::instance() then refer to this agent and its logs, which allows
+     * to step several agents from the same thread.
+     * @note doNext and run do it already.
+     */
+    class Scope {
+    public:
+      Scope(const AgentId& agent);
+      ~Scope();
+    private:
+      Agent* m_previous;
+      LogManager* m_previousLogs;
+    };
+
+    /**
+     * @brief Create an agent and make it the current one of the calling thread. The first agent of the process
+     * is also the one seen by threads without a current agent. Any other agent gets its own log directory.
      * @param configData The Agent XML Configuration file.
      * @param clock The clock to be used by the agent. Different clocks are used to provide different run-time behavior.
      * @param timeLimit The maximum tick to run for. Agetr this time, the agent will terminate. The timeLimit defined here will over-ride
      * any value provided in the configuration file.
      * @param enableEventLog Set this true if event logging should be enabled. If true, it will store events for all observations, requests and recalls
      * in memory.
-     * @see Agent::Agent
+     * The calling thread, which has to be the one running the agent, is configured from the cpus, scheduler, priority and
+     * lockMemory attributes. The settings achieved are written to the TREX log.
+     * @param checkpoint If not NULL, a file written by writeCheckpoint to resume from. The agent and the clock then
+     * start at the tick following the one of the checkpoint.
+     * @see Agent::Agent, Agent::configureThread, Agent::writeCheckpoint
      */
-    static AgentId initialize(const TiXmlElement& configData, Clock& clock, TICK timeLimit = 0, bool enableEventLog = false);
+    static AgentId initialize(const TiXmlElement& configData, Clock& clock, TICK timeLimit = 0, bool enableEventLog = false,
+			      const char* checkpoint = NULL);
 
     /**
-     * @brief Accessor for the singleton instance
+     * @brief Accessor for the current agent of the calling thread
      */
     static const AgentId& instance();
 
@@ -117,12 +158,12 @@ namespace TREX {
     static TICK forever();
 
     /**
-     * @brief Terminate the agent
+     * @brief Terminate the current agent
      */
     static void terminate();
 
     /**
-     * @brief Access termination flag
+     * @brief Access termination flag of the current agent
      */
     static bool terminated();
 
@@ -158,11 +199,22 @@ namespace TREX {
      */
     const TeleoReactorId& getOwner(const LabelStr& timeline);
 
+    /**
+     * @brief Test an observation received from outside the agent against the models of the reactors observing its timeline.
+     * @see TeleoReactor::isValidObservation
+     */
+    bool isValidObservation(const Observation& observation) const;
+
     /**
      * @brief Get the reactor count
      */
     int getReactorCount() const {return m_reactors.size();}
 
+    /**
+     * @brief Share of the deliberation time of the last tick taken by a reactor, as reported in the cpu stat log
+     */
+    double getCpuShare(const TeleoReactorId& reactor) const;
+
     /**
      * @brief Accessor for debug stream
      */
@@ -170,8 +222,10 @@ namespace TREX {
 
     /**
      * @brief Called by Reactors when the post observations. The agent will route to 0 or more reactors who track this observation timeline.
+     * Observers that did not synchronize yet in this tick get the observations in a batch just before they synchronize. Only the
+     * last observation of a timeline is delivered, unless coalesce is false or the timeline is listed in uncoalesced.
      * @param observation The observation reported.
-     * @see Observer
+     * @see Observer, ObservationBuffer
      */
     void notify(const Observation& observation);
 
@@ -215,6 +269,29 @@ namespace TREX {
      */
     const Clock& getClock() const;
 
+    /**
+     * @brief The shared memory bus where the agent activity is published for monitors, NULL if none.
+     * @see bus attribute of the agent configuration
+     */
+    ObservationBus* getBus() const {return m_bus;}
+
+    /**
+     * @brief Save the execution state of all the DbCore reactors to @e file : values at the execution frontier,
+     * current observations, the plan with what was dispatched from it and the goals still to achieve.
+     * @return false if nothing was written because a reactor has an inconsistent plan.
+     * @throw ErrnoExcept If the file cannot be written
+     * @see DbCore::checkpoint, Checkpoint
+     */
+    bool writeCheckpoint(const std::string& file);
+
+    /**
+     * @brief Wait until the periodic checkpoint handed to the writer thread is on disk.
+     * When the checkpoint attribute of the agent configuration names a file, the execution state is captured
+     * every checkpointPeriod ticks right after synchronization, and written to that file by a thread of its own
+     * so that the tick does not wait for the disk.
+     */
+    void waitForCheckpoint();
+
     /**
      * Over-write default, allowing different statistics collector
      */
@@ -292,6 +369,12 @@ namespace TREX {
      */
     std::string dumpState(const bool export_assembly);
 
+    /**
+     * @brief Parse the cpus attribute: a comma separated list of CPU indices and ranges, e.g. "2" or "0,2-3".
+     * @throw ConfigurationException if an entry is empty, not a number, out of range or a decreasing range.
+     */
+    static std::vector<int> parseCpus(const std::string& spec);
+
   private:
 
     static LabelStr buildLogName(LabelStr const &prefix);
@@ -304,11 +387,23 @@ namespace TREX {
     /**
      * @brief Instantiated by singleton initialization function
      */
-    Agent(const TiXmlElement& configData, Clock& clock, TICK timelimit, bool enableLogging = true);
+    Agent(const TiXmlElement& configData, Clock& clock, TICK timelimit, bool enableLogging, LogManager* logs,
+	  const char* checkpoint);
+
+    /**
+     * @brief Resume the execution of the DbCore reactors from a checkpoint and start at the tick that follows it.
+     * @see DbCore::restore
+     */
+    void restore(const std::string& file);
 
     /**
      * @brief execute the next reactor for a step.
+     * Reactors whose step is not expected to complete before the clock deadline are deferred to the next tick,
+     * unless the step would not fit in a whole tick anyway or was already deferred on an earlier tick.
+     * A zero latency reactor does not cede control: steps are taken in a burst until a reactor with latency is stepped
+     * or there is no work left. A burst that reached burstCap steps is stopped, so that the caller checks the clock.
      * @return true if more work to do
+     * @see TeleoReactor::getStepCostEstimate, Clock::timeToDeadline
      */
     bool executeReactor();
 
@@ -328,29 +423,121 @@ namespace TREX {
     void synchronize();
 
     /**
-     * @brief Select the next reactor to work on
+     * @brief Write the phase latencies of all reactors to latency.log
+     * @param final If true, write the totals for the run rather than the last interval
+     * @see TeleoReactor::reportLatency
+     */
+    void reportLatency(bool final);
+
+    /**
+     * @brief Write to startup.log how long each step of the construction of the agent took.
+     * @param configured Nanoseconds spent before the construction of the first reactor
+     * @param total Nanoseconds spent in the constructor
+     * @see TeleoReactor::addStartupPhase
+     */
+    void reportStartup(uint64_t configured, uint64_t total);
+
+    /**
+     * @brief Bounded memory mode, every historyLimit ticks. Let each reactor release what it has archived,
+     * then drop the events before the oldest archive frontier of the reactors.
+     * @see TeleoReactor::doCompact, TeleoReactor::getArchiveFrontier
+     */
+    void compact();
+
+    /**
+     * @brief Add the execution state of all the DbCore reactors to @e state.
+     * @return false if a reactor has an inconsistent plan, in which case there is nothing worth saving.
+     */
+    bool captureCheckpoint(Checkpoint& state);
+
+    /**
+     * @brief Capture the execution state and hand it to the writer thread. Skipped while the previous one is being written.
+     * @see waitForCheckpoint
+     */
+    void startCheckpoint();
+
+    /**
+     * @brief Select the next reactor to work on, according to the agenda policy
      * @return reactor The next reactor to work on. If no work required, returns a noId()
+     * @see AgendaPolicy
      */
     TeleoReactorId nextReactor();
 
+    /**
+     * @brief Remove a reactor from the deliberation agenda until the next tick
+     */
+    void dropDeliberator(const TeleoReactorId& reactor);
+
+    /**
+     * @brief Update the share of this tick's deliberation time used by each reactor
+     */
+    void updateCpuShares();
+
+    /**
+     * Helper method to obtain the agenda policy from the agenda attribute
+     */
+    static AgendaPolicy getAgendaPolicy(const char * valueStr);
+
+    /**
+     * @brief Real-time settings of the configuration, see parseThreadConfig.
+     */
+    struct ThreadConfig {
+      ThreadConfig(): policy(-1), priority(0), lockMemory(false) {}
+
+      std::vector<int> cpus; /*!< CPUs to run on. Empty to leave the affinity as is */
+      int policy; /*!< A Thread::Policy. -1 to leave the scheduling as is */
+      int priority; /*!< Priority for the policy */
+      bool lockMemory; /*!< True to lock the process memory */
+    };
+
+    /**
+     * @brief Read the real-time settings of the configuration. cpus is a list of CPU indices and ranges, e.g. "2" or "0,2-3",
+     * see parseCpus. scheduler is "other" (default) or "fifo", with the given priority. lockMemory="true" locks the process memory.
+     * @throw ConfigurationException if cpus or scheduler is invalid.
+     */
+    static ThreadConfig parseThreadConfig(const TiXmlElement& configData);
+
+    /**
+     * @brief Apply real-time settings to the calling thread and report what was achieved. Settings refused by the system are
+     * reported and the agent runs without them.
+     */
+    static void configureThread(const ThreadConfig& config);
+
+    /**
+     * @brief Give a thread of the agent, not started yet, the cpus and scheduling of the agent.
+     */
+    void configureThread(Thread& thread) const;
+
     /**
      * Helper method to obtain the correct final tick value from the input parameter string
      */
     static TICK getFinalTick(const char * valueStr);
 
-    static AgentId s_id; /*!< Store for the singleton instance */
+    static AgentId s_id; /*!< First agent, used by threads without a current agent */
+    static __thread Agent* s_current; /*!< Current agent of the thread */
+    static unsigned int s_count; /*!< Number of agents alive */
     AgentId m_id; /*!< This Id */
+    LogManager* m_logs; /*!< Log manager owned by this agent. NULL when using the process one */
+    bool m_terminated; /*!< Marker for termination */
     const LabelStr m_name; /*! Name - from configuration file. */
     ObserverId m_thisObserver; /*!< A connector to allow the agent to play as a middleman by intercepting observations from Reactors */
     unsigned int m_currentTick; /*!< Set by the clock */
     unsigned int m_finalTick; /*!< Determines mission end */
     unsigned int m_attempts; /*!< Tracks the number of times this tick has been attempted to be resolved */
+    unsigned int m_selections; /*!< Number of calls to nextReactor. Debugging aid */
     std::multimap<LabelStr, ObserverId> m_observersByTimeline; /*!< Routing table for observations */
+    std::map<ObserverId, ObservationBuffer*> m_pendingObservations; /*!< Observations held until each observer synchronizes */
+    std::set<ObserverId> m_synchronizedObservers; /*!< Observers that synchronized this tick, and get observations right away */
+    const bool m_coalesce; /*!< If false, observations are delivered as soon as they are posted */
+    const bool m_logObservations; /*!< If false, observations are not written to the syslog */
+    std::set<LabelStr> m_uncoalesced; /*!< Timelines whose every observation is delivered */
+    unsigned long m_coalescedObservations; /*!< Observations replaced before delivery */
     std::vector<TeleoReactorId> m_reactors; /*!< The reactors in order of allocation */
     std::map< double, TeleoReactorId> m_reactorsByName; /*!< The set of reactors */
     std::map< double, TeleoReactorId> m_ownersByTimeline; /*!< Lookup table for getting owners */
     std::vector<TeleoReactorId> m_sortedReactors; /*!< Sorted by dependency for synchronization */
     std::vector<TeleoReactorId> m_deliberators; /*!< The agenda of reactors for deliberation. Refreshed on every tick. */
+    const AgendaPolicy m_agendaPolicy; /*!< How to pick the next deliberator */
     std::list<AgentListenerId> m_listeners; /*!< For monitoring events by external listeners */
 
     Clock& m_clock; /*!< The clock used to drive agent ticks. */
@@ -359,14 +546,26 @@ namespace TREX {
     PerformanceMonitor m_monitor;
     RStat m_synchUsage;
     RStat m_deliberationUsage;
+    unsigned long m_stepOverruns; /*!< Reactor steps that ended past the tick deadline */
+    const unsigned int m_burstCap; /*!< Length after which a burst stops. 0 for no limit */
+    unsigned long m_burstSteps; /*!< Zero latency steps taken in bursts */
+    unsigned long m_longestBurst; /*!< Most zero latency steps taken in one burst */
+    unsigned long m_cappedBursts; /*!< Bursts stopped by the cap */
+    std::vector<double> m_cpuShares; /*!< Share of the deliberation time of the tick, in the order of m_reactors */
+    std::ofstream m_latencyLog; /*!< Per reactor phase latency percentiles */
+    TICK m_latencyPeriod; /*!< Ticks between two latency reports. 0 for a final report only */
+    const std::string m_checkpointFile; /*!< Where to save the execution state periodically. Empty if not */
+    const TICK m_checkpointPeriod; /*!< Ticks between two checkpoints. 0 for on demand only */
+    CheckpointWriter* m_checkpointWriter; /*!< Writes the periodic checkpoints. NULL until the first one */
+    ThreadConfig m_threadConfig; /*!< Real-time settings, also given to the threads of the agent */
+    const TICK m_historyLimit; /*!< Ticks between two compactions, and of monitor data kept, in bounded memory mode. 0 to keep everything */
 
     /* Logging support */
     const bool m_enableEventLogger; /*!< If true, the agent will store events */
     std::vector<Event> m_eventLog; /*!< Used for analysis and testing */
     ObservationLogger m_obsLog;
+    ObservationBus* m_bus; /*!< Publication for monitors, NULL unless configured */
     std::ostream& m_standardDebugStream; /*!<Stores debug stream to allow it to be reset on destruction */
-
-    static bool s_terminated; /*!< Marker for termination */    
   };
 
 }
@@ -37,6 +37,7 @@
 #include <time.h>
 #include <cmath>
 #include <cstring>
+#include <limits>
 
 #include "LogManager.hh"
 #include "Guardian.hh"
@@ -51,6 +52,10 @@ namespace TREX {
     clk->addField("userTime", m_diff.user_time());
     clk->addField("systemTime", m_diff.system_time());
     clk->addField("maxRSS", m_cur.max_resident());
+    clk->addField("wallTime", m_diff.wall_time());
+    clk->addField("threadTime", m_diff.thread_time());
+    clk->addField("volCtxSwitches", m_diff.n_voluntary_switches());
+    clk->addField("involCtxSwitches", m_diff.n_involuntary_switches());
     start();
   }
 
@@ -93,6 +98,14 @@ namespace TREX {
     sleep(getSleepDelay());
   }
 
+  double Clock::timeToDeadline() const {
+    return std::numeric_limits<double>::max();
+  }
+
+  void Clock::resume(TICK tick) {
+    checkError(tick == 0, "This clock cannot resume a mission at tick " << tick);
+  }
+
   TICK PseudoClock::selectStep(unsigned int stepsPerTick) {
     if( stepsPerTick<=0 ) {
       TREXLog()<<"requested number of steps is invalid ("<<stepsPerTick<<")."
@@ -121,42 +134,54 @@ namespace TREX {
     return 0;
   }
 
+  void PseudoClock::resume(TICK tick) {
+    checkError(m_internalTicks == 0, "Cannot resume a clock already running");
+    m_tick = tick;
+  }
+
   /**
    * Real Time Clock
    */
-  void RealTimeClock::getDate(timeval &date) {
-    gettimeofday(&date, NULL);
+  void RealTimeClock::getDate(timespec &date) {
+    clock_gettime(CLOCK_MONOTONIC, &date);
   }
 
   RealTimeClock::RealTimeClock(double secondsPerTick, bool stats)
     : Clock(secondsPerTick, stats),
       m_started(false),
-      m_tick(0)
+      m_tick(0),
+      m_lastJitter(0.0),
+      m_overruns(0),
+      m_jitter("clock.jitter")
   {
-    m_tvSecondsPerTick.tv_sec = static_cast<long>(std::floor(secondsPerTick));
-    m_tvSecondsPerTick.tv_usec = static_cast<long>(std::floor((secondsPerTick-m_tvSecondsPerTick.tv_sec)*1e6));
+    m_tsSecondsPerTick.tv_sec = static_cast<time_t>(std::floor(secondsPerTick));
+    m_tsSecondsPerTick.tv_nsec = static_cast<long>(std::floor((secondsPerTick-m_tsSecondsPerTick.tv_sec)*1e9));
   }
 
   void RealTimeClock::start(){
+    TickLogger *clk = LogManager::instance().getTickLog(CPU_STAT_LOG);
+    clk->addField("clock.jitter", m_lastJitter);
+    clk->addField("clock.overruns", m_overruns);
+
     getDate(m_nextTickDate);
     setNextTickDate();
     m_started = true;
   }
 
   void RealTimeClock::setNextTickDate(unsigned factor) {
-    m_nextTickDate.tv_usec += factor*m_tvSecondsPerTick.tv_usec;
-    m_nextTickDate.tv_sec += factor*m_tvSecondsPerTick.tv_sec + (m_nextTickDate.tv_usec/1000000);
-    m_nextTickDate.tv_usec %= 1000000;
+    long long nsec = m_nextTickDate.tv_nsec + (long long) factor*m_tsSecondsPerTick.tv_nsec;
+    m_nextTickDate.tv_sec += factor*m_tsSecondsPerTick.tv_sec + (time_t) (nsec/1000000000);
+    m_nextTickDate.tv_nsec = (long) (nsec%1000000000);
   }
 
   double RealTimeClock::timeLeft() const {
-    timeval tv;
+    timespec ts;
     double result;
-    getDate(tv);
+    getDate(ts);
     
-    result = m_nextTickDate.tv_usec - tv.tv_usec;
-    result /= 1e6;
-    result += m_nextTickDate.tv_sec - tv.tv_sec;
+    result = m_nextTickDate.tv_nsec - ts.tv_nsec;
+    result /= 1e9;
+    result += m_nextTickDate.tv_sec - ts.tv_sec;
 
     return result;
   }
@@ -171,12 +196,46 @@ namespace TREX {
 	int tickIncr = 1+(int) std::floor(howLate/m_secondsPerTick);
 	m_tick += tickIncr;
 	setNextTickDate(tickIncr);
-// 	TREXLog()<<"[clock]["<<m_tick<<"] "<<howLate<<" secs late."<<std::endl; 
+
+	m_lastJitter = howLate;
+	m_jitter.record((uint64_t) (howLate*1e9));
+	if( tickIncr>1 ) {
+	  m_overruns += tickIncr-1;
+	  TREXLog()<<"[clock]["<<m_tick<<"] "<<howLate<<" secs late: missed "
+		   <<(tickIncr-1)<<" tick(s)."<<std::endl; 
+	}
       }
     }
     return m_tick;
   }
 
+  void RealTimeClock::sleep() const {
+    if( m_started ) {
+      timespec date;
+      {
+	Guardian<Mutex> guard(m_lock);
+	date = m_nextTickDate;
+      }
+      int rval;
+      while( (rval = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &date, NULL))==EINTR ) {}
+      checkError(rval == 0, "clock_nanosleep failed: " << strerror(rval));
+    } else 
+      Clock::sleep();
+  }
+
+  void RealTimeClock::resume(TICK tick) {
+    checkError(!m_started, "Cannot resume a clock already running");
+    m_tick = tick;
+  }
+
+  double RealTimeClock::timeToDeadline() const {
+    if( m_started ) {
+      Guardian<Mutex> guard(m_lock);
+      return timeLeft();
+    } else 
+      return Clock::timeToDeadline();
+  }
+
   double RealTimeClock::getSleepDelay() const {    
     if( m_started ) {
       double delay;
@@ -184,7 +243,6 @@ namespace TREX {
 	Guardian<Mutex> guard(m_lock);
 	delay = timeLeft();
       }
-//       TREXLog()<<"[clock]["<<m_tick<<"] sleeping for "<<delay<<" secs."<<std::endl;
       return delay;
     } else 
       return Clock::getSleepDelay();
@@ -38,7 +38,8 @@
 #include "TREXDefs.hh"
 #include "TeleoReactor.hh"
 #include "RStat.hh"
-#include <sys/time.h>
+#include "LatencyHistogram.hh"
+#include <time.h>
 #include "Mutex.hh"
 
 /**
@@ -74,6 +75,19 @@ namespace TREX {
      */
     static void sleep(double sleepDuration);
 
+    /**
+     * @brief Time left before the next tick, in seconds. Negative if the tick is already due.
+     * Used to avoid starting work that would not complete within the current tick.
+     * @return std::numeric_limits<double>::max() for clocks without a deadline
+     */
+    virtual double timeToDeadline() const;
+
+    /**
+     * @brief Count ticks from @e tick instead of 0, to resume a mission.
+     * @pre The clock is not started.
+     */
+    virtual void resume(TICK tick);
+
     bool debugStats() const {
       return m_processStats;
     }
@@ -147,6 +161,7 @@ namespace TREX {
      */
     TICK getNextTick();
     virtual double getSleepDelay() const;
+    void resume(TICK tick);
 
   private:
     /**
@@ -160,7 +175,11 @@ namespace TREX {
   };
 
   /**
-   * @brief A clock that monitors time on a separate thread and generates updates to the tick.
+   * @brief A clock that follows CLOCK_MONOTONIC.
+   * Tick dates are absolute, and sleep() waits until the next one with clock_nanosleep(TIMER_ABSTIME),
+   * so that neither system time adjustments nor sleep overheads accumulate into drift.
+   * The lateness with which each tick is observed (jitter) and the ticks missed altogether (overruns)
+   * are recorded, and logged in the cpu stats as clock.jitter and clock.overruns.
    */
   class RealTimeClock: public Clock {
   public:
@@ -176,18 +195,46 @@ namespace TREX {
      */
     TICK getNextTick();
 
+    using Clock::sleep;
+
+    /**
+     * @brief Sleep until the date of the next tick
+     */
+    void sleep() const;
+
+    double timeToDeadline() const;
+
+    void resume(TICK tick);
+
+    /**
+     * @brief Distribution of the delay between the date of a tick and its observation by getNextTick
+     */
+    LatencyHistogram const &jitter() const {
+      return m_jitter;
+    }
+
+    /**
+     * @brief Number of ticks that passed without being observed
+     */
+    unsigned long overruns() const {
+      return m_overruns;
+    }
+
   protected:
     double getSleepDelay() const;
 
   private:
-    static void getDate(timeval &val);
+    static void getDate(timespec &val);
     void setNextTickDate(unsigned factor=1);
     double timeLeft() const;
 
     bool m_started;
     TICK m_tick;
-    timeval m_tvSecondsPerTick;
-    timeval m_nextTickDate;
+    timespec m_tsSecondsPerTick;
+    timespec m_nextTickDate;
+    double m_lastJitter; /*!< Lateness of the last tick, in seconds */
+    unsigned long m_overruns;
+    LatencyHistogram m_jitter;
     mutable Mutex m_lock;
   };
     
@@ -66,8 +66,11 @@
 
 // Misc
 #include "Utils.hh"
+#include "MutexWrapper.hh"
+#include "Guardian.hh"
 
 #include <fstream>
+#include <map>
 #include <sstream>
 
 namespace TREX {
@@ -75,6 +78,57 @@ namespace TREX {
 
   Assembly::Schema* Assembly::Schema::s_instance = NULL;
 
+  namespace {
+    Mutex& includePathMutex(){
+      static Mutex sl_mutex;
+      return sl_mutex;
+    }
+
+    /**
+     * @brief Read the nddl include path of NDDL.cfg, or of temp_nddl_gen.cfg if there is none.
+     * Each file is only parsed once per process, by the first reactor that needs it. Another file,
+     * as found for a different configuration, is parsed again.
+     * @return false if the file declares no include path
+     */
+    bool readNddlIncludePath(std::string& path){
+      static std::map<std::string, std::pair<bool, std::string> > sl_paths;
+
+      std::string file = findFile("NDDL.cfg");
+      if (!std::ifstream(file.c_str()).good()) {
+	file = findFile("temp_nddl_gen.cfg");
+	checkError(std::ifstream(file.c_str()).good(), "Could not find 'NDDL.cfg' or 'temp_nddl_gen.cfg'");
+      }
+
+      Guardian<Mutex> guard(includePathMutex());
+      std::map<std::string, std::pair<bool, std::string> >::const_iterator cached = sl_paths.find(file);
+      if (cached != sl_paths.end()) {
+	path = cached->second.second;
+	return cached->second.first;
+      }
+
+      bool found = false;
+      TiXmlElement* iroot = EUROPA::initXml(file.c_str());
+      if (iroot) {
+	for (TiXmlElement * ichild = iroot->FirstChildElement();
+	     ichild != NULL;
+	     ichild = ichild->NextSiblingElement()) {
+	  if (std::string(ichild->Value()) == "include") {
+	    path = std::string(ichild->Attribute("path"));
+	    for (unsigned int i = 0; i < path.size(); i++) {
+	      if (path[i] == ';') {
+		path[i] = ':';
+	      }
+	    }
+	    found = true;
+	  }
+	}
+	delete iroot;
+      }
+      sl_paths[file] = std::make_pair(found, path);
+      return found;
+    }
+  }
+
   Assembly::Assembly()
   {
     assertTrue(ALWAYS_FAIL, "Should never get here.");
@@ -118,7 +172,8 @@ namespace TREX {
 
   Assembly::~Assembly() 
   {  
-    if(m_ppw == NULL)
+    // Before the shutdown as the writer may be listening to the database
+    if(m_ppw != NULL)
       delete m_ppw;
 
     doShutdown(); 
@@ -129,31 +184,10 @@ namespace TREX {
     check_error(txSource != NULL, "NULL transaction source provided.");
     static bool isFile(true);
 
-    std::ifstream f1(findFile("NDDL.cfg").c_str());
-    std::ifstream f2(findFile("temp_nddl_gen.cfg").c_str());
-    TiXmlElement* iroot = NULL;
-    if (f1.good()) {
-      iroot = EUROPA::initXml(findFile("NDDL.cfg").c_str());
-    } else if (f2.good()) {
-      iroot = EUROPA::initXml(findFile("temp_nddl_gen.cfg").c_str());
-    } else {
-      checkError(false, "Could not find 'NDDL.cfg' or 'temp_nddl_gen.cfg'");
-    }
-    if (iroot) {
-      for (TiXmlElement * ichild = iroot->FirstChildElement();
-	   ichild != NULL;
-	   ichild = ichild->NextSiblingElement()) {
-	if (std::string(ichild->Value()) == "include") {
-	  std::string path = std::string(ichild->Attribute("path"));
-	  for (unsigned int i = 0; i < path.size(); i++) {
-	    if (path[i] == ';') {
-	      path[i] = ':';
-	    }
-	  }
-	  getLanguageInterpreter("nddl")->getEngine()->getConfig()->setProperty("nddl.includePath", path);
-	}
-      }
-    }
+    std::string includePath;
+    if(readNddlIncludePath(includePath))
+      getLanguageInterpreter("nddl")->getEngine()->getConfig()->setProperty("nddl.includePath", includePath);
+
     try {
       std::string ret = executeScript("nddl", txSource, isFile);
       assertTrue(ret == "", "Parser failed in " + std::string(txSource) + " with return: " + ret);
@@ -180,6 +214,11 @@ namespace TREX {
     return sl_reply;
   }
 
+  void Assembly::exportBinary(size_t segmentSize, TICK keyframePeriod){
+    getPPW()->setBinary(segmentSize);
+    getPPW()->setKeyframePeriod(keyframePeriod);
+  }
+
   DbWriter* Assembly::getPPW(){
     if(m_ppw == NULL){
       m_ppw = new DbWriter(m_agentName.toString(), m_reactorName.toString(), m_planDatabase, m_constraintEngine, m_rulesEngine);
@@ -93,6 +93,16 @@ namespace TREX {
      */
     const std::string& exportToPlanWorks(TICK tick, unsigned int attempt);
 
+    /**
+     * @brief Export to a compressed, segmented step log rather than the PlanWorks layout.
+     * @param segmentSize Maximum size of a segment in bytes
+     * @param keyframePeriod Ticks between two full snapshots. Steps in between only hold what changed.
+     * 0 makes every step a full snapshot.
+     * @see DbWriter::setBinary
+     * @see DbWriter::setKeyframePeriod
+     */
+    void exportBinary(size_t segmentSize, TICK keyframePeriod = 0);
+
     /**
      * @brief A plug-in class for schemas
      */
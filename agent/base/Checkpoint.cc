@@ -0,0 +1,448 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+* 
+*  Copyright (c) 2007. MBARI.
+*  All rights reserved.
+* 
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+* 
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the TREX Project nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+* 
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* -*- C++ -*-
+ * $Id$
+ */
+/** @file "Checkpoint.cc"
+ */
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <list>
+#include <set>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "Domains.hh"
+#include "DataTypes.hh"
+#include "Object.hh"
+#include "PlanDatabase.hh"
+#include "Token.hh"
+#include "TokenVariable.hh"
+
+#include "Compression.hh"
+#include "ErrnoExcept.hh"
+#include "Checkpoint.hh"
+
+using namespace TREX;
+
+namespace {
+
+  char const MAGIC[8] = {'T', 'R', 'X', 'C', 'K', 'P', 'T', '\0'};
+  uint32_t const VERSION = 2;
+  /** Largest uncompressed checkpoint we accept to read. Far above what a model holds. */
+  uint32_t const MAX_RAW_SIZE = 64<<20;
+
+  template<typename Ty>
+  void put(std::string &out, Ty val) {
+    out.append(reinterpret_cast<char const *>(&val), sizeof(val));
+  }
+
+  template<typename Ty>
+  bool get(char const *&data, char const *end, Ty &val) {
+    if( static_cast<size_t>(end-data)<sizeof(val) )
+      return false;
+    memcpy(&val, data, sizeof(val));
+    data += sizeof(val);
+    return true;
+  }
+
+  void putString(std::string &out, std::string const &str) {
+    checkError(str.length()<=0xffff, "Name too long for a checkpoint: "<<str);
+    put<uint16_t>(out, str.length());
+    out.append(str);
+  }
+
+  bool getString(char const *&data, char const *end, std::string &str) {
+    uint16_t len;
+    if( !get(data, end, len) || static_cast<size_t>(end-data)<len )
+      return false;
+    str.assign(data, len);
+    data += len;
+    return true;
+  }
+
+  void corrupted(std::string const &path, char const *what) {
+    throw ErrnoExcept("Checkpoint "+path, what);
+  }
+
+  void putDomain(std::string &out, Checkpoint::Domain const &dom) {
+    put<uint8_t>(out, dom.form);
+    switch( dom.form ) {
+    case Checkpoint::INTERVAL:
+      put<double>(out, dom.lb);
+      put<double>(out, dom.ub);
+      break;
+    case Checkpoint::NUMBERS:
+      put<uint16_t>(out, dom.numbers.size());
+      for(std::vector<double>::const_iterator n=dom.numbers.begin(); dom.numbers.end()!=n; ++n)
+	put<double>(out, *n);
+      break;
+    case Checkpoint::LABELS:
+    case Checkpoint::OBJECTS:
+      put<uint16_t>(out, dom.labels.size());
+      for(std::vector<std::string>::const_iterator l=dom.labels.begin(); dom.labels.end()!=l; ++l)
+	putString(out, *l);
+      break;
+    default:
+      break;
+    }
+  }
+
+  void putVariables(std::string &out, std::string const &predicate,
+		    std::vector< std::pair<std::string, Checkpoint::Domain> > const &vars) {
+    checkError(vars.size()<=0xffff, "Too many variables in "<<predicate);
+    put<uint16_t>(out, vars.size());
+    for(std::vector< std::pair<std::string, Checkpoint::Domain> >::const_iterator v=vars.begin();
+	vars.end()!=v; ++v) {
+      putString(out, v->first);
+      putDomain(out, v->second);
+    }
+  }
+
+  void getVariables(char const *&data, char const *end, std::string const &path,
+		    std::vector< std::pair<std::string, Checkpoint::Domain> > &vars) {
+    uint16_t nVars;
+    if( !get(data, end, nVars) )
+      corrupted(path, "truncated token");
+    for(uint16_t v=0; v<nVars; ++v) {
+      uint16_t count;
+      vars.push_back(std::make_pair(std::string(), Checkpoint::Domain()));
+      Checkpoint::Domain &dom = vars.back().second;
+      if( !getString(data, end, vars.back().first) || !get(data, end, dom.form) )
+	corrupted(path, "truncated variable");
+      switch( dom.form ) {
+      case Checkpoint::ANY:
+	break;
+      case Checkpoint::INTERVAL:
+	if( !get(data, end, dom.lb) || !get(data, end, dom.ub) )
+	  corrupted(path, "truncated interval");
+	break;
+      case Checkpoint::NUMBERS:
+	if( !get(data, end, count) )
+	  corrupted(path, "truncated enumeration");
+	dom.numbers.resize(count);
+	for(uint16_t i=0; i<count; ++i)
+	  if( !get(data, end, dom.numbers[i]) )
+	    corrupted(path, "truncated enumeration");
+	break;
+      case Checkpoint::LABELS:
+      case Checkpoint::OBJECTS:
+	if( !get(data, end, count) )
+	  corrupted(path, "truncated enumeration");
+	dom.labels.resize(count);
+	for(uint16_t i=0; i<count; ++i)
+	  if( !getString(data, end, dom.labels[i]) )
+	    corrupted(path, "truncated enumeration");
+	break;
+      default:
+	corrupted(path, "unknown domain form");
+      }
+    }
+  }
+
+}
+
+/*
+ * class TREX::Checkpoint
+ */
+
+// structors :
+
+Checkpoint::Domain::Domain()
+  :form(ANY), lb(0.0), ub(0.0) {}
+
+Checkpoint::Token::Token()
+  :kind(0), key(0) {}
+
+Checkpoint::Checkpoint()
+  :m_tick(0) {}
+
+Checkpoint::Checkpoint(std::string const &agent, TICK tick)
+  :m_agent(agent), m_tick(tick) {}
+
+// Observers :
+
+Checkpoint::Reactor const *Checkpoint::reactor(std::string const &name) const {
+  for(std::vector<Reactor>::const_iterator i=m_reactors.begin(); m_reactors.end()!=i; ++i)
+    if( name==i->name )
+      return &*i;
+  return NULL;
+}
+
+void Checkpoint::write(std::string const &path) const {
+  std::string raw, block;
+
+  put<uint32_t>(raw, m_tick);
+  putString(raw, m_agent);
+  put<uint32_t>(raw, m_reactors.size());
+  for(std::vector<Reactor>::const_iterator r=m_reactors.begin(); m_reactors.end()!=r; ++r) {
+    putString(raw, r->name);
+    put<uint32_t>(raw, r->tokens.size());
+    for(std::vector<Token>::const_iterator t=r->tokens.begin(); r->tokens.end()!=t; ++t) {
+      put<uint8_t>(raw, t->kind);
+      put<uint32_t>(raw, t->key);
+      putString(raw, t->predicate);
+      putVariables(raw, t->predicate, t->variables);
+      putVariables(raw, t->predicate, t->specified);
+    }
+    put<uint32_t>(raw, r->links.size());
+    for(std::vector<Link>::const_iterator l=r->links.begin(); r->links.end()!=l; ++l) {
+      put<uint32_t>(raw, l->local);
+      putString(raw, l->reactor);
+      put<uint32_t>(raw, l->foreign);
+    }
+  }
+  compress(raw.data(), raw.size(), block);
+
+  std::string file(MAGIC, sizeof(MAGIC));
+  put<uint32_t>(file, VERSION);
+  put<uint32_t>(file, raw.size());
+  put<uint32_t>(file, block.size());
+  file.append(block);
+
+  // Write aside and rename, so that a crash never leaves a partial checkpoint
+  std::string const tmp = path+".tmp";
+  int fd = ::open(tmp.c_str(), O_WRONLY|O_CREAT|O_TRUNC, 0644);
+  if( fd<0 )
+    throw ErrnoExcept("Checkpoint "+tmp);
+  for(size_t done=0; done<file.size(); ) {
+    ssize_t n = ::write(fd, file.data()+done, file.size()-done);
+    if( n<0 ) {
+      if( EINTR==errno )
+	continue;
+      ErrnoExcept e("Checkpoint "+tmp);
+      ::close(fd);
+      throw e;
+    }
+    done += n;
+  }
+  if( 0!=::fsync(fd) ) {
+    ErrnoExcept e("Checkpoint "+tmp);
+    ::close(fd);
+    throw e;
+  }
+  ::close(fd);
+  if( 0!=::rename(tmp.c_str(), path.c_str()) )
+    throw ErrnoExcept("Checkpoint "+path);
+}
+
+// Manipulators :
+
+Checkpoint::Reactor &Checkpoint::addReactor(std::string const &name) {
+  m_reactors.push_back(Reactor());
+  m_reactors.back().name = name;
+  return m_reactors.back();
+}
+
+void Checkpoint::capture(AbstractDomain const &dom, Domain &out) {
+  out.form = ANY;
+  if( dom.isEmpty() || dom.isOpen() )
+    return;
+  if( dom.isInterval() ) {
+    out.form = INTERVAL;
+    dom.getBounds(out.lb, out.ub);
+    return;
+  }
+
+  std::list<double> values;
+  dom.getValues(values);
+  checkError(values.size()<=0xffff, "Enumeration too large for a checkpoint: "<<dom.toString());
+  if( dom.isEntity() ) {
+    out.form = OBJECTS;
+    for(std::list<double>::const_iterator i=values.begin(); values.end()!=i; ++i) {
+      ObjectId object = *i;
+      out.labels.push_back(object->getName().toString());
+    }
+  } else if( dom.getDataType()->isNumeric() || dom.getDataType()->isBool() ) {
+    out.form = NUMBERS;
+    out.numbers.assign(values.begin(), values.end());
+  } else {
+    out.form = LABELS;
+    for(std::list<double>::const_iterator i=values.begin(); values.end()!=i; ++i)
+      out.labels.push_back(LabelStr(*i).toString());
+  }
+}
+
+void Checkpoint::addToken(Reactor &reactor, TokenKind kind, TokenId const &token) {
+  std::vector<ConstrainedVariableId> vars;
+  vars.push_back(token->getObject());
+  vars.push_back(token->start());
+  vars.push_back(token->end());
+  vars.push_back(token->duration());
+  vars.insert(vars.end(), token->parameters().begin(), token->parameters().end());
+
+  reactor.tokens.push_back(Token());
+  Token &out = reactor.tokens.back();
+  out.kind = kind;
+  out.key = token->getKey();
+  out.predicate = token->getPredicateName().toString();
+  for(std::vector<ConstrainedVariableId>::const_iterator v=vars.begin(); vars.end()!=v; ++v) {
+    out.variables.push_back(std::make_pair((*v)->getName().toString(), Domain()));
+    capture((*v)->baseDomain(), out.variables.back().second);
+    if( (*v)->isSpecified() ) {
+      AbstractDomain *value = (*v)->baseDomain().copy();
+      value->set((*v)->getSpecifiedValue());
+      out.specified.push_back(std::make_pair((*v)->getName().toString(), Domain()));
+      capture(*value, out.specified.back().second);
+      delete value;
+    }
+  }
+}
+
+AbstractDomain *Checkpoint::narrow(ConstrainedVariableId const &var, Domain const &dom, PlanDatabaseId const &db) {
+  AbstractDomain *local = var->baseDomain().copy();
+  if( INTERVAL==dom.form )
+    local->intersect(dom.lb, dom.ub);
+  else if( NUMBERS==dom.form && local->isInterval() ) {
+    if( dom.numbers.empty() )
+      local->empty();
+    else
+      local->intersect(*std::min_element(dom.numbers.begin(), dom.numbers.end()),
+		       *std::max_element(dom.numbers.begin(), dom.numbers.end()));
+  } else if( local->isEnumerated() && !local->isOpen() ) {
+    std::set<double> allowed;
+
+    if( NUMBERS==dom.form )
+      allowed.insert(dom.numbers.begin(), dom.numbers.end());
+    else
+      for(std::vector<std::string>::const_iterator l=dom.labels.begin(); dom.labels.end()!=l; ++l) {
+	if( OBJECTS==dom.form ) {
+	  ObjectId object = db->getObject(LabelStr(*l));
+	  if( object.isId() )
+	    allowed.insert((double) object);
+	} else
+	  allowed.insert((double) LabelStr(*l));
+      }
+
+    std::list<double> values;
+    local->getValues(values);
+    for(std::list<double>::const_iterator i=values.begin(); values.end()!=i; ++i)
+      if( allowed.end()==allowed.find(*i) )
+	local->remove(*i);
+  }
+  return local;
+}
+
+bool Checkpoint::restrict(ConstrainedVariableId const &var, Domain const &dom, PlanDatabaseId const &db) {
+  if( ANY==dom.form )
+    return true;
+
+  AbstractDomain *local = narrow(var, dom, db);
+  bool const consistent = !local->isEmpty();
+  if( consistent )
+    var->restrictBaseDomain(*local);
+  delete local;
+  return consistent;
+}
+
+bool Checkpoint::specify(ConstrainedVariableId const &var, Domain const &dom, PlanDatabaseId const &db) {
+  if( ANY==dom.form || !var->canBeSpecified() )
+    return false;
+
+  AbstractDomain *local = narrow(var, dom, db);
+  bool const valid = local->isSingleton();
+  if( valid )
+    var->specify(local->getSingletonValue());
+  delete local;
+  return valid;
+}
+
+void Checkpoint::read(std::string const &path) {
+  std::ifstream in(path.c_str(), std::ios::binary);
+  if( !in.good() )
+    throw ErrnoExcept("Checkpoint "+path);
+  std::string const file((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+  char const *data = file.data(), *end = data+file.size();
+  uint32_t version, rawSize, size;
+  if( file.size()<sizeof(MAGIC) || 0!=memcmp(data, MAGIC, sizeof(MAGIC)) )
+    corrupted(path, "not a checkpoint");
+  data += sizeof(MAGIC);
+  if( !get(data, end, version) || !get(data, end, rawSize) || !get(data, end, size) )
+    corrupted(path, "truncated header");
+  if( VERSION!=version )
+    corrupted(path, "unsupported version");
+  if( rawSize>MAX_RAW_SIZE )
+    corrupted(path, "oversized block");
+
+  std::string raw;
+  if( static_cast<size_t>(end-data)!=size || !uncompress(data, size, rawSize, raw) )
+    corrupted(path, "corrupted block");
+
+  data = raw.data();
+  end = data+raw.size();
+
+  uint32_t tick, nReactors;
+  std::string agent;
+  if( !get(data, end, tick) || !getString(data, end, agent) || !get(data, end, nReactors) )
+    corrupted(path, "truncated agent");
+
+  std::vector<Reactor> reactors;
+  for(uint32_t r=0; r<nReactors; ++r) {
+    uint32_t nTokens, nLinks;
+    reactors.push_back(Reactor());
+    Reactor &reactor = reactors.back();
+    if( !getString(data, end, reactor.name) || !get(data, end, nTokens) )
+      corrupted(path, "truncated reactor");
+    for(uint32_t t=0; t<nTokens; ++t) {
+      reactor.tokens.push_back(Token());
+      Token &token = reactor.tokens.back();
+      if( !get(data, end, token.kind) || token.kind<VALUE || token.kind>DISPATCHED ||
+	  !get(data, end, token.key) || !getString(data, end, token.predicate) )
+	corrupted(path, "truncated token");
+      getVariables(data, end, path, token.variables);
+      getVariables(data, end, path, token.specified);
+    }
+    if( !get(data, end, nLinks) )
+      corrupted(path, "truncated reactor");
+    for(uint32_t l=0; l<nLinks; ++l) {
+      reactor.links.push_back(Link());
+      Link &link = reactor.links.back();
+      if( !get(data, end, link.local) || !getString(data, end, link.reactor) || !get(data, end, link.foreign) )
+	corrupted(path, "truncated link");
+    }
+  }
+  if( data!=end )
+    corrupted(path, "trailing bytes");
+
+  m_agent = agent;
+  m_tick = tick;
+  m_reactors.swap(reactors);
+}
@@ -0,0 +1,215 @@
+/* -*- C++ -*-
+ * $Id$
+ */
+/** @file "Checkpoint.hh"
+ * @brief Binary snapshot of the execution state of an agent.
+ */
+#ifndef _CHECKPOINT_HH
+#define _CHECKPOINT_HH
+
+/*********************************************************************
+* Software License Agreement (BSD License)
+* 
+*  Copyright (c) 2007. MBARI.
+*  All rights reserved.
+* 
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+* 
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the TREX Project nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+* 
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <stdint.h>
+
+#include "TREXDefs.hh"
+#include "PlanDatabaseDefs.hh"
+#include "ConstraintEngineDefs.hh"
+
+namespace TREX {
+
+  /** @brief Agent checkpoint
+   *
+   * A checkpoint holds, for each DbCore of an agent, its execution state
+   * right after synchronization : the current values, the plan ahead of
+   * them, which of the planned tokens were dispatched, the goals not planned
+   * yet and which requests of other reactors these goals stand for. An
+   * agent resumed from it starts at the tick following the checkpoint with
+   * these tokens in place of the initial state of the model, and carries on
+   * with the plan instead of replaying the mission from its first tick or
+   * planning again from scratch.
+   *
+   * Tokens are kept as the base domains of their variables, along with the
+   * values the planner specified. Labels and objects are stored by name as
+   * keys are only valid within a process. The key of a token only serves to
+   * link a goal to the request of another reactor it was posted for.
+   *
+   * The file is
+   * @code
+   * file     : char[8] u32 version u32 rawSize u32 size block
+   * raw      : u32 tick str agent u32 count reactor[count]
+   * reactor  : str name u32 count token[count] u32 count link[count]
+   * token    : u8 kind u32 key str predicate u16 count variable[count] u16 count variable[count]
+   * variable : str name u8 form value
+   * link     : u32 key str reactor u32 key
+   * str      : u16 length char[length]
+   * @endcode
+   * where @e block is @e raw compressed with compress. The variables of a
+   * token are its base domains and then its specified values. A link is the
+   * key of a local goal, followed by the name of the reactor that requested
+   * it and the key of the request in that reactor. The value of a variable
+   * depends on its form :
+   * @li ANY : nothing, the domain is left as is
+   * @li INTERVAL : f64 lower bound and f64 upper bound
+   * @li NUMBERS : u16 count and f64[count], for enumerations of numbers and booleans
+   * @li LABELS and OBJECTS : u16 count and str[count]
+   *
+   * Numbers are in the byte order of the host.
+   *
+   * @sa DbCore::checkpoint, DbCore::restore
+   */
+  class Checkpoint {
+  public:
+    enum TokenKind {
+      VALUE = 1,      //!< Current value of a timeline
+      OBSERVED_VALUE, //!< Current value that is an observation
+      GOAL_VALUE,     //!< Current value that is a goal
+      OBSERVATION,    //!< Current observation merged with another value
+      GOAL,           //!< Goal yet to be planned
+      PLANNED,        //!< Token of the plan ahead of the current values, in timeline order
+      PLANNED_GOAL,   //!< Goal placed in the plan, in timeline order
+      DISPATCHED      //!< Planned token already requested from the owner of its timeline
+    };
+    enum DomainForm {
+      ANY = 0,
+      INTERVAL,
+      NUMBERS,
+      LABELS,
+      OBJECTS
+    };
+
+    struct Domain {
+      Domain();
+
+      uint8_t form;
+      double lb, ub;
+      std::vector<double> numbers;
+      std::vector<std::string> labels;
+    };
+
+    struct Token {
+      Token();
+
+      uint8_t kind;
+      uint32_t key;
+      std::string predicate;
+      /** Base domains of the object, start, end, duration and parameters, by variable name */
+      std::vector< std::pair<std::string, Domain> > variables;
+      /** Values specified by the planner, by variable name */
+      std::vector< std::pair<std::string, Domain> > specified;
+    };
+
+    /** @brief A goal posted for the request of another reactor */
+    struct Link {
+      uint32_t local;      //!< Key of the goal
+      std::string reactor; //!< Name of the requesting reactor
+      uint32_t foreign;    //!< Key of the request in the requesting reactor
+    };
+
+    struct Reactor {
+      std::string name;
+      std::vector<Token> tokens;
+      std::vector<Link> links;
+    };
+
+    Checkpoint();
+    /** @brief Constructor
+     * @param agent Name of the agent
+     * @param tick The last tick synchronized
+     */
+    Checkpoint(std::string const &agent, TICK tick);
+    ~Checkpoint() {}
+
+    std::string const &agent() const {
+      return m_agent;
+    }
+    TICK tick() const {
+      return m_tick;
+    }
+    /** @brief The state of reactor @e name, or NULL if there is none */
+    Reactor const *reactor(std::string const &name) const;
+
+    Reactor &addReactor(std::string const &name);
+    /** @brief Add the base domains of @e token to @e reactor */
+    static void addToken(Reactor &reactor, TokenKind kind, TokenId const &token);
+
+    /** @brief Restrict the base domain of a variable
+     *
+     * @param var The variable
+     * @param dom The domain recorded for it
+     * @param db The database where labels and objects are looked up
+     *
+     * @retval false the restriction would empty the domain, which is left unchanged
+     */
+    static bool restrict(ConstrainedVariableId const &var, Domain const &dom, PlanDatabaseId const &db);
+    /** @brief Specify a variable
+     *
+     * @param var The variable
+     * @param dom The value recorded for it
+     * @param db The database where labels and objects are looked up
+     *
+     * @retval false the value is not in the base domain of @e var, which is left unspecified
+     */
+    static bool specify(ConstrainedVariableId const &var, Domain const &dom, PlanDatabaseId const &db);
+
+    /** @brief Write to a file
+     *
+     * The checkpoint is written next to @e path and then renamed, so that
+     * @e path always holds a complete checkpoint.
+     *
+     * @throw ErrnoExcept if the file could not be written
+     */
+    void write(std::string const &path) const;
+    /** @brief Read from a file
+     * @throw ErrnoExcept if the file could not be read or is corrupted
+     */
+    void read(std::string const &path);
+
+  private:
+    static void capture(AbstractDomain const &dom, Domain &out);
+    /** @brief Restrict a copy of a base domain to what @e dom allows */
+    static AbstractDomain *narrow(ConstrainedVariableId const &var, Domain const &dom, PlanDatabaseId const &db);
+
+    std::string m_agent;
+    TICK m_tick;
+    std::vector<Reactor> m_reactors;
+  }; // TREX::Checkpoint
+
+} // TREX
+
+#endif // _CHECKPOINT_HH
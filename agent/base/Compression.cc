@@ -0,0 +1,164 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+* 
+*  Copyright (c) 2007. MBARI.
+*  All rights reserved.
+* 
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+* 
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the TREX Project nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+* 
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* -*- C++ -*-
+ * $Id$
+ */
+/** @file "Compression.cc"
+ */
+#include <cstring>
+#include <vector>
+
+#include <stdint.h>
+
+#include "Compression.hh"
+
+namespace {
+
+  size_t const MIN_MATCH = 4;
+  size_t const MAX_OFFSET = 0xffff;
+  unsigned const HASH_BITS = 13;
+
+  inline uint32_t read32(char const *p) {
+    uint32_t ret;
+    memcpy(&ret, p, sizeof(ret));
+    return ret;
+  }
+
+  inline size_t hash(uint32_t v) {
+    return (v*2654435761U)>>(32-HASH_BITS);
+  }
+
+  void putLength(size_t len, std::string &out) {
+    for( ; len>=255; len -= 255)
+      out.push_back(static_cast<char>(255));
+    out.push_back(static_cast<char>(len));
+  }
+
+  void putSequence(char const *lit, size_t nLit, size_t offset, size_t matchLen,
+		   std::string &out) {
+    size_t m = matchLen>=MIN_MATCH ? matchLen-MIN_MATCH : 0;
+    unsigned char token = ((nLit<15 ? nLit : 15)<<4)|(m<15 ? m : 15);
+
+    out.push_back(static_cast<char>(token));
+    if( nLit>=15 )
+      putLength(nLit-15, out);
+    out.append(lit, nLit);
+    if( matchLen>=MIN_MATCH ) {
+      out.push_back(static_cast<char>(offset&0xff));
+      out.push_back(static_cast<char>(offset>>8));
+      if( m>=15 )
+	putLength(m-15, out);
+    }
+  }
+
+  bool getLength(unsigned char const *&p, unsigned char const *end, size_t &len) {
+    unsigned char b;
+    do {
+      if( p>=end )
+	return false;
+      b = *(p++);
+      len += b;
+    } while( 255==b );
+    return true;
+  }
+
+} // unnamed
+
+namespace TREX {
+
+  void compress(char const *data, size_t size, std::string &out) {
+    std::vector<long> table(1<<HASH_BITS, -1);
+    size_t anchor = 0, i = 0;
+
+    out.reserve(out.size()+size/2+16);
+    while( i+MIN_MATCH<=size ) {
+      uint32_t v = read32(data+i);
+      size_t h = hash(v);
+      long cand = table[h];
+      
+      table[h] = i;
+      if( cand>=0 && i-cand<=MAX_OFFSET && read32(data+cand)==v ) {
+	size_t len = MIN_MATCH;
+	
+	while( i+len<size && data[cand+len]==data[i+len] )
+	  ++len;
+	putSequence(data+anchor, i-anchor, i-cand, len, out);
+	i += len;
+	anchor = i;
+      } else 
+	++i;
+    }
+    putSequence(data+anchor, size-anchor, 0, 0, out);
+  }
+
+  bool uncompress(char const *data, size_t size, size_t rawSize, std::string &out) {
+    unsigned char const *p = reinterpret_cast<unsigned char const *>(data);
+    unsigned char const *end = p+size;
+    size_t start = out.size();
+
+    // rawSize usually comes from a file : a block never expands more than
+    // 255 times, so do not reserve memory for what it cannot hold
+    if( rawSize/255>size )
+      return false;
+    out.reserve(start+rawSize);
+    while( p<end ) {
+      unsigned char token = *(p++);
+      size_t nLit = token>>4, len = token&0xf;
+      
+      if( 15==nLit && !getLength(p, end, nLit) )
+	return false;
+      if( static_cast<size_t>(end-p)<nLit || out.size()-start+nLit>rawSize )
+	return false;
+      out.append(reinterpret_cast<char const *>(p), nLit);
+      p += nLit;
+      if( p==end )
+	break;
+      if( end-p<2 )
+	return false;
+      size_t offset = p[0]|(p[1]<<8);
+      p += 2;
+      if( 15==len && !getLength(p, end, len) )
+	return false;
+      len += MIN_MATCH;
+      if( offset==0 || offset>out.size()-start || out.size()-start+len>rawSize )
+	return false;
+      // byte per byte as the match may overlap what it produces
+      for(size_t from = out.size()-offset; len>0; --len, ++from)
+	out.push_back(out[from]);
+    }
+    return out.size()-start==rawSize;
+  }
+
+} // TREX
@@ -0,0 +1,93 @@
+/* -*- C++ -*-
+ * $Id$
+ */
+/** @file "Compression.hh"
+ * @brief Fast LZ block compression of log records.
+ */
+#ifndef _COMPRESSION_HH
+#define _COMPRESSION_HH
+
+/*********************************************************************
+* Software License Agreement (BSD License)
+* 
+*  Copyright (c) 2007. MBARI.
+*  All rights reserved.
+* 
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+* 
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the TREX Project nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+* 
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <string>
+
+namespace TREX {
+
+  /** @brief Compress a block
+   *
+   * @param data The bytes to compress
+   * @param size Number of bytes in @e data
+   * @param out Where the compressed block is appended
+   *
+   * This is a byte oriented LZ77 coder in the spirit of LZ4 : it is
+   * fast enough to run every tick and typically divides the size of
+   * our tab separated logs by 4 or more. The block does not store
+   * @e size, callers have to keep it along with the block.
+   *
+   * A block is a sequence of
+   * @code
+   * token literals [offset match]
+   * @endcode
+   * where the high nibble of the 1 byte @e token is the number of
+   * literals and the low nibble the match length minus 4. A nibble
+   * of 15 is followed by bytes added to it until one is not 255.
+   * The @e offset is a 2 bytes little endian distance back in the output.
+   * The last sequence of a block has literals only.
+   *
+   * @sa uncompress
+   */
+  void compress(char const *data, size_t size, std::string &out);
+
+  /** @brief Uncompress a block
+   *
+   * @param data A block produced by compress
+   * @param size Number of bytes in @e data
+   * @param rawSize Number of bytes of the original data
+   * @param out Where the original data is appended
+   *
+   * @retval true Success
+   * @retval false The block is corrupted or its original size is not @e rawSize
+   *
+   * Nothing is read past @e size bytes of @e data nor written past @e rawSize
+   * bytes of @e out, and a @e rawSize larger than what @e size bytes can
+   * expand to is rejected before any allocation.
+   *
+   * @sa compress
+   */
+  bool uncompress(char const *data, size_t size, size_t rawSize, std::string &out);
+
+} // TREX
+
+#endif // _COMPRESSION_HH
@@ -61,6 +61,10 @@
 #include "Utilities.hh"
 #include "Filters.hh"
 #include "TestMonitor.hh"
+#include "StringExtract.hh"
+#include "DebugStream.hh"
+#include "MutexWrapper.hh"
+#include "Guardian.hh"
 
 // For fileio
 #include <sys/stat.h>
@@ -76,14 +80,12 @@ namespace TREX {
 
   /* IMPLEMENTATION FOR DELIBERATION FILTER */
 
-  DeliberationFilter::DeliberationFilter(const TiXmlElement& configData): FlawFilter(configData, true) {}
+  DeliberationFilter::DeliberationFilter(const TiXmlElement& configData): FlawFilter(configData, true), m_evaluations(0) {}
 
   /**
    * This method implements the horizon policy for deliberation.
    */
   bool DeliberationFilter::test(const EntityId& entity){
-    static unsigned int sl_counter(0);
-
     TokenId token;
 
     if(ConstrainedVariableId::convertable(entity)){
@@ -115,7 +117,7 @@ namespace TREX {
       m_core = DbCore::getInstance(token);
     }
 
-    TREX_INFO("trex:debug:planning", "[" << sl_counter++ << "] Evaluating " << tokenToString(token) << " with " << 
+    TREX_INFO("trex:debug:planning", "[" << m_evaluations++ << "] Evaluating " << tokenToString(token) << " with " << 
 	     token->start()->lastDomain().toString() << " AND " << 
 	     token->end()->lastDomain().toString());
 
@@ -181,22 +183,19 @@ namespace TREX {
     return (Agent::instance().isId() ? Agent::instance()->getCurrentTick() : 0);
   }
 
-  void DeliberationFilter::update(TICK start, TICK end){
-    checkError(start >= Agent::instance()->getCurrentTick(), start << " < " << Agent::instance()->getCurrentTick());
-    checkError(end <= Agent::instance()->getFinalTick(), end << " > " << Agent::instance()->getCurrentTick());
-    horizon() = IntervalIntDomain((int) start, (int) end);
-  }
-
-  const IntervalIntDomain& DeliberationFilter::getHorizon(){
-    if(Agent::instance().isId())
-      return horizon();
+  const IntervalIntDomain& DeliberationFilter::getHorizon(const PlanDatabaseId& db){
+    DbCoreId core = DbCore::getInstance(db);
+    if(core.isId())
+      return core->getPlanningHorizon();
     else
       return HorizonFilter::getHorizon();
   }
 
-  IntervalIntDomain& DeliberationFilter::horizon(){
-    static IntervalIntDomain sl_horizon(0, PLUS_INFINITY);
-    return sl_horizon;
+  const IntervalIntDomain& DeliberationFilter::horizon() const {
+    if(m_core.isId())
+      return m_core->getPlanningHorizon();
+    else
+      return HorizonFilter::getHorizon();
   }
 
   std::ostream& DeliberationFilter::getStream(){
@@ -206,8 +205,36 @@ namespace TREX {
       return DebugMessage::getStream();
   }
 
-  // Allocate key collection
-  std::map<int, EntityId> DbCore::s_foreignKeyRelation;
+  namespace {
+    /**
+     * @brief Guards DbCore::instancesByDb, which reactors running on other threads may query
+     */
+    Mutex& instancesMutex(){
+      static Mutex sl_mutex;
+      return sl_mutex;
+    }
+
+    /**
+     * @brief A variable of base domain @e base can be restricted to an observed @e value if both hold the same kind of
+     * data and have a value in common. Objects are only compared by kind as they are mapped by name in restrict.
+     */
+    bool fitsDomain(const AbstractDomain& base, const AbstractDomain& value){
+      const DataTypeId& type = base.getDataType();
+      const DataTypeId& valueType = value.getDataType();
+      if(type->isBool() != valueType->isBool() || type->isNumeric() != valueType->isNumeric() ||
+	 type->isString() != valueType->isString() || type->isEntity() != valueType->isEntity())
+	return false;
+
+      if(type->isNumeric())
+	return (type->minDelta() < 1.0 || valueType->minDelta() >= 1.0) &&
+	  value.getLowerBound() <= base.getUpperBound() && base.getLowerBound() <= value.getUpperBound();
+
+      if(type->isEntity() || base.isOpen() || !value.isSingleton())
+	return true;
+
+      return base.isMember(value.getSingletonValue());
+    }
+  }
 
   /**
    * @brief Little utility function for composing strings to make names
@@ -302,18 +329,38 @@ namespace TREX {
       m_statePath(LogManager::instance().reactor_dir_path(agentName.toString(),getName().toString(),"reactor_states").c_str()),
       m_conflictPath(LogManager::instance().reactor_dir_path(agentName.toString(),getName().toString(),"conflicts").c_str()),
       m_planLog(LogManager::instance().reactor_file_path(agentName.toString(),getName().toString(),"plan.log").c_str()),
-      m_lastRecalled(0)
+      m_lastRecalled(0),
+      m_horizon(0, PLUS_INFINITY),
+      m_terminated(0),
+      m_archiveFrontier(0),
+      m_slavesEvaluated(0),
+      m_pendingLatency(addLatencyPhase("sync.processPendingTokens")),
+      m_resolveLatency(addLatencyPhase("sync.resolve")),
+      m_commitLatency(addLatencyPhase("sync.commit")),
+      m_notifyLatency(addLatencyPhase("sync.notifyObservers")),
+      m_updateGoalsLatency(addLatencyPhase("sync.updateGoals")),
+      m_archiveLatency(addLatencyPhase("sync.archive")),
+      m_dispatchLatency(addLatencyPhase("dispatch"))
   {
 
-    DebugMessage::setStream(getStream());
+    DebugStream::select(getStream());
 
-    instancesByDb().insert(std::pair<PlanDatabaseId, DbCoreId>(m_db, getId()));
+    {
+      Guardian<Mutex> guard(instancesMutex());
+      instancesByDb().insert(std::pair<PlanDatabaseId, DbCoreId>(m_db, getId()));
+    }
 
     const LabelStr  configFile(findFile(compose(getAgentName(), compose(getName(), "nddl")).toString()));
 
     LogManager::use(configFile.toString());
+    uint64_t phaseStart = LatencyHistogram::now();
     m_assembly.playTransactions(configFile.c_str());
 
+    // PlanWorks exports can go to a compressed step log, cheap enough to leave on. See trexplans.
+    if(string_cast<bool>(false, checked_string(configData.Attribute("binaryPlans"))))
+      m_assembly.exportBinary(string_cast<size_t>(64<<20, checked_string(configData.Attribute("planSegmentSize"))),
+			      string_cast<TICK>(0, checked_string(configData.Attribute("planKeyframe"))));
+
     // Close the database if not already closed. No new objects will be created
     if(!m_db->isClosed())
       m_db->close();
@@ -327,12 +374,17 @@ namespace TREX {
     double tick_duration = Agent::instance()->getClock().getSecondsPerTick();
     TREX_INFO("trex:info", "Using a tick duration of " << tick_duration << " seconds.");
     tickDurationVar->restrictBaseDomain(IntervalDomain(tick_duration, tick_duration));
+    addStartupPhase("model", LatencyHistogram::now() - phaseStart);
 
     // Load the solver configuration file
+    phaseStart = LatencyHistogram::now();
     TiXmlElement* solverCfg = LogManager::initXml( m_solverCfg.c_str() );
     m_solver = new DbSolver(m_db, solverCfg);
     delete solverCfg;
     checkError(m_solver.isValid(), m_solver);
+    addStartupPhase("solver", LatencyHistogram::now() - phaseStart);
+
+    phaseStart = LatencyHistogram::now();
 
     // Finally, get all inactive tokens loaded in the initial state and store them in the initial goal set. If there are any goals
     // that are not rejectable, flag an error and quit
@@ -363,10 +415,11 @@ namespace TREX {
     configure();
 
     propagate();
+    addStartupPhase("setup", LatencyHistogram::now() - phaseStart);
   }
 
    DbCore::~DbCore(){
-     DebugMessage::setStream(getStream());
+     DebugStream::select(getStream());
 
      TREX_INFO("DbCore:~DbCore", "Cleaning up " << getName().toString());
 
@@ -392,24 +445,37 @@ namespace TREX {
        }
      }
 
-     instancesByDb().clear();
-
-     s_foreignKeyRelation.clear();
+     {
+       Guardian<Mutex> guard(instancesMutex());
+       instancesByDb().erase(m_db);
+     }
   }
 
   void DbCore::notify(const Observation& observation){
-    TREX_INFO("trex:info:trace", nameString() << observation.toString());
+    TREX_INFO("trex:info:trace", nameString() << observation);
+
+    std::map<double, ObservationBinding>::iterator b_it = m_observationBindings.find(observation.getObjectName());
+    checkError(b_it != m_observationBindings.end(), "Failed to find and entry for " << observation.getObjectName().toString());
+    ObservationBinding& binding = b_it->second;
+
+    // Steady state: the value has not changed. Leave it to the inertial value assumption to extend the current value
+    // rather than creating a token to be merged into it.
+    if(isUnchangedObservation(binding, observation)){
+      TREX_INFO("trex:info:trace", nameString() << "Unchanged value on " << observation.getObjectName().toString());
+      m_unchangedObservations++;
+      return;
+    }
 
     // Get the client to work with
     DbClientId client = m_db->getClient();
 
     // Allocate a token - it should be inactive but not rejectable - cannot deny the truth
     TokenId token = client->createToken(observation.getPredicate().c_str(), NULL, NOT_REJECTABLE);
+    TREX_TRACE(TRACE_DBCORE, TRACE_DBCORE_OBSERVATION, getCurrentTick(), getTraceId(), token->getKey(), observation.countParameters());
 
     // Bind the object variable
-    ObjectId timeline = client->getObject(observation.getObjectName().c_str());
     const ConstrainedVariableId& objectVar = token->getObject();
-    objectVar->specify(timeline);
+    objectVar->specify(binding.object);
     objectVar->restrictBaseDomain(objectVar->lastDomain());
 
     // A notification of a value should have the semantics of stating a fact is true at a given time. This means the latest start is
@@ -418,27 +484,99 @@ namespace TREX {
     token->start()->restrictBaseDomain(IntervalIntDomain(getCurrentTick(), getCurrentTick()));
     token->end()->restrictBaseDomain(IntervalIntDomain(getCurrentTick()+1, PLUS_INFINITY));
 
-    // Restrict the base domains for each parameter specifed.
-    // TO DO: Make sure this is type safe
+    // Restrict the base domains for each parameter specifed. A value outside the base domain declared by the predicate
+    // would make the database inconsistent for good, so the observation is dropped first.
+    std::vector<ConstrainedVariableId> params(observation.countParameters());
     for(unsigned int i = 0; i < observation.countParameters(); i++){
-      const std::pair<LabelStr, const AbstractDomain*>& nameValuePair = observation[i];
-      const LabelStr& varName = nameValuePair.first;
-      const AbstractDomain& varDom = *(nameValuePair.second);
-      const ConstrainedVariableId& param = token->getVariable(varName);
-      checkError(param.isValid(), tokenToString(token) << " has no variable named " << varName.toString() << ". " << token->toLongString());
-      TREX_INFO("trex:info:trace", nameString() << "Restricting " << param->toString() << " to " << varDom.toString());
-      restrict(param, varDom);
+      const LabelStr& varName = observation[i].first;
+      params[i] = getObservedParameter(binding, token, observation.getPredicate(), i, varName);
+      checkError(params[i].isValid(), tokenToString(token) << " has no variable named " << varName.toString() << ". " << token->toLongString());
+      if(!fitsDomain(params[i]->baseDomain(), *(observation[i].second))){
+	TREXLog() << nameString() << "Dropped observation " << observation.toString() << ": " << varName.toString()
+		  << " is not in " << params[i]->baseDomain().toString() << std::endl;
+	token->discard();
+	return;
+      }
+    }
+
+    for(unsigned int i = 0; i < observation.countParameters(); i++){
+      const AbstractDomain& varDom = *(observation[i].second);
+      TREX_INFO("trex:info:trace", nameString() << "Restricting " << params[i]->toString() << " to " << varDom.toString());
+      restrict(params[i], varDom);
     }
 
     // Store the token in the observation list
-    std::map< int, TimelineContainer  >::iterator it = m_externalTimelineTable.find(timeline->getKey());
-    checkError(it != m_externalTimelineTable.end(), "Failed to find and entry for " << observation.getObjectName().toString());
-    it->second.updateLastObserved(getCurrentTick());
+    binding.container->updateLastObserved(getCurrentTick());
 
     // Buffer the observation for identification purposes later
     bufferObservation(token);
   }
 
+  bool DbCore::isValidObservation(const Observation& observation) const {
+    std::map<double, ObservationBinding>::const_iterator b_it = m_observationBindings.find(observation.getObjectName());
+    if(b_it == m_observationBindings.end())
+      return true;
+
+    const SchemaId& schema = m_assembly.getSchema();
+    const LabelStr& predicate = observation.getPredicate();
+    if(!schema->isPredicate(predicate) || !schema->isA(b_it->second.object->getType(), schema->getObjectType(predicate)))
+      return false;
+
+    const CESchemaId& ceSchema = m_assembly.getConstraintEngine()->getCESchema();
+    for(unsigned int i = 0; i < observation.countParameters(); i++){
+      if(!schema->hasMember(predicate, observation[i].first))
+	return false;
+
+      // Values declared on the parameter itself are only known to its token. See notify.
+      const LabelStr type = schema->getMemberType(predicate, observation[i].first);
+      if(ceSchema->isDataType(type.c_str()) && !fitsDomain(ceSchema->getDataType(type.c_str())->baseDomain(), *(observation[i].second)))
+	return false;
+    }
+
+    return true;
+  }
+
+  ConstrainedVariableId DbCore::getObservedParameter(ObservationBinding& binding, const TokenId& token, const LabelStr& predicate,
+						     unsigned int index, const LabelStr& varName){
+    std::vector< std::pair<double, unsigned int> >& slots = binding.slots[predicate];
+    if(index < slots.size() && slots[index].first == varName)
+      return token->parameters()[slots[index].second];
+
+    // Resolve by name, and remember the slot if observations of this predicate use the same order
+    const std::vector<ConstrainedVariableId>& params = token->parameters();
+    for(unsigned int slot = 0; slot < params.size(); slot++){
+      if(params[slot]->getName() == varName){
+	if(index == slots.size())
+	  slots.push_back(std::make_pair((double) varName, slot));
+	return params[slot];
+      }
+    }
+
+    return token->getVariable(varName);
+  }
+
+  bool DbCore::isUnchangedObservation(const ObservationBinding& binding, const Observation& observation){
+    TICK tick = getCurrentTick();
+    if(tick == 0 || m_state == DbCore::INVALID || binding.container->lastObserved() == tick)
+      return false;
+
+    // It has to be a prior observation of the same predicate, that can still be extended
+    TokenId token = getValue(binding.container->getTimeline(), tick - 1);
+    if(token.isNoId() || !isObservation(token) || token->getPredicateName() != observation.getPredicate() ||
+       token->start()->lastDomain().getUpperBound() > tick || token->end()->lastDomain().getUpperBound() <= tick)
+      return false;
+
+    // With the same values. Object parameters refer to foreign objects, so do not bother with them.
+    for(unsigned int i = 0; i < observation.countParameters(); i++){
+      const std::pair<LabelStr, const AbstractDomain*> nameValuePair = observation[i];
+      ConstrainedVariableId param = token->getVariable(nameValuePair.first);
+      if(param.isNoId() || ObjectVarId::convertable(param) || !(param->baseDomain() == *(nameValuePair.second)))
+	return false;
+    }
+
+    return true;
+  }
+
   /**
    * @brief Post the goal and all the constraints you can. The goal is from another database. The key here is to
    * replicate the requested token and its related entities (variables and consraints). We maintain the mapping for all
@@ -474,24 +612,14 @@ namespace TREX {
     localGoal->end()->restrictBaseDomain(goal->end()->lastDomain());
     localGoal->duration()->restrictBaseDomain(goal->duration()->lastDomain());
     setDispatchTime(localGoal);
- 
-    addEntity(goal, localGoal);
-    addEntity(goal->getObject(), localGoal->getObject());
-    addEntity(goal->duration(), localGoal->duration());
-    addEntity(goal->start(), localGoal->start());
-    addEntity(goal->end(), localGoal->end());
 
-    // Iterate over parameters
+    // Parameters
     const std::vector<ConstrainedVariableId>& foreignParams = goal->parameters();
     const std::vector<ConstrainedVariableId>& localParams = localGoal->parameters();
-    unsigned int paramCount = localParams.size();
+    for(unsigned int i = 0; i < localParams.size(); i++)
+      restrict(localParams[i], foreignParams[i]->lastDomain());
 
-    for(unsigned int i = 0; i < paramCount; i++) {
-      const ConstrainedVariableId& foreignParam = foreignParams[i];
-      const ConstrainedVariableId& localParam = localParams[i];
-      restrict(localParam, foreignParam->lastDomain());
-      addEntity(foreignParam, localParam);
-    }
+    linkRequest(goal, localGoal);
 
     // Finally, we migrate constraints. This leverages the foreign key mapping constructed above.
     applyConstraints(goal);
@@ -516,6 +644,19 @@ namespace TREX {
     return true;
   }
 
+  void DbCore::linkRequest(const TokenId& goal, const TokenId& localGoal){
+    addEntity(goal, localGoal);
+    addEntity(goal->getObject(), localGoal->getObject());
+    addEntity(goal->duration(), localGoal->duration());
+    addEntity(goal->start(), localGoal->start());
+    addEntity(goal->end(), localGoal->end());
+
+    const std::vector<ConstrainedVariableId>& foreignParams = goal->parameters();
+    const std::vector<ConstrainedVariableId>& localParams = localGoal->parameters();
+    for(unsigned int i = 0; i < localParams.size(); i++)
+      addEntity(foreignParams[i], localParams[i]);
+  }
+
   /**
    * Handling a recall requires goals corresponding to the foreign key to be removed and the foreign key mapping to be
    * removed also. Goals are buffered for removal in synchronization for the next tick.
@@ -653,14 +794,20 @@ namespace TREX {
     }
 
     m_sync_stepCount = 0;
+    m_unchangedObservations = 0;
     m_search_depth = 0;
     m_search_stepCount = 0;
-    
+    accountMemory();
 
     TickLogger *log = LogManager::instance().getTickLog(CPU_STAT_LOG);
     log->addField(getName().toString()+".sync.nSteps", m_sync_stepCount);
+    log->addField(getName().toString()+".sync.nUnchangedObs", m_unchangedObservations);
     log->addField(getName().toString()+".search.maxDepth", m_search_depth);
     log->addField(getName().toString()+".search.nSteps", m_search_stepCount);
+    log->addField(getName().toString()+".memory.nTokens", m_nTokens);
+    log->addField(getName().toString()+".memory.nVariables", m_nVariables);
+    log->addField(getName().toString()+".memory.nConstraints", m_nConstraints);
+    log->addField(getName().toString()+".memory.nKeys", m_nKeys);
   }
 
   /**
@@ -685,7 +832,12 @@ namespace TREX {
       if(mode->getSpecifiedValue() == Agent::EXTERNAL_TIMELINE()){
 	m_externalLabels.push_back(object_name);
 	// Add an entry for external timelines. Link server later
-	m_externalTimelineTable.insert(std::pair<int, TimelineContainer >(object->getKey(), TimelineContainer(object)));
+	std::map<int, TimelineContainer>::iterator entry =
+	  m_externalTimelineTable.insert(std::pair<int, TimelineContainer >(object->getKey(), TimelineContainer(object))).first;
+	// Resolve once what notify needs for this timeline
+	ObservationBinding& binding = m_observationBindings[object_name];
+	binding.object = object;
+	binding.container = &(entry->second);
 	m_timelines.push_back(object);
       }
       else if(mode->getSpecifiedValue() == Agent::INTERNAL_TIMELINE()){
@@ -846,6 +998,138 @@ namespace TREX {
     return std::string("Success.");
   }
 
+  void DbCore::checkpoint(Checkpoint& out){
+    Checkpoint::Reactor& state = out.addReactor(getName().toString());
+    double next = out.tick() + 1;
+
+    // Current values and observations, as found by Synchronizer::isCurrent and resetObservations on the next tick
+    const TokenSet& tokens = m_db->getTokens();
+    for(TokenSet::const_iterator it = tokens.begin(); it != tokens.end(); ++it){
+      TokenId token = *it;
+      double end = token->end()->baseDomain().getUpperBound();
+      if(token->isTerminated() || isAction(token) || end < next || (end == next && !isInternal(token)))
+	continue;
+
+      if(token->isCommitted())
+	Checkpoint::addToken(state, isObservation(token) ? Checkpoint::OBSERVED_VALUE : (isGoal(token) ? Checkpoint::GOAL_VALUE : Checkpoint::VALUE), token);
+      else if(isCurrentObservation(token))
+	Checkpoint::addToken(state, Checkpoint::OBSERVATION, token);
+    }
+
+    // The plan ahead of the current values, timeline by timeline in order, with what was dispatched from it
+    for(std::vector<TimelineId>::const_iterator it = m_timelines.begin(); it != m_timelines.end(); ++it){
+      std::map<int, TimelineContainer>::iterator tc = m_externalTimelineTable.find((*it)->getKey());
+      const std::list<TokenId>& sequence = (*it)->getTokenSequence();
+      for(std::list<TokenId>::const_iterator t = sequence.begin(); t != sequence.end(); ++t){
+	TokenId token = *t;
+	if(token->isCommitted() || token->isTerminated() || isObservation(token) || isAction(token) ||
+	   token->start()->lastDomain().getUpperBound() < next)
+	  continue;
+
+	if(tc != m_externalTimelineTable.end() && tc->second.isDispatched(token))
+	  Checkpoint::addToken(state, Checkpoint::DISPATCHED, token);
+	else
+	  Checkpoint::addToken(state, isGoal(token) ? Checkpoint::PLANNED_GOAL : Checkpoint::PLANNED, token);
+      }
+    }
+
+    // Goals still to plan, as kept by Synchronizer::resetGoals on the next tick
+    for(TokenSet::const_iterator it = m_goals.begin(); it != m_goals.end(); ++it){
+      TokenId goal = *it;
+      if(goal->isCommitted() || goal->isTerminated() || goal->isActive())
+	continue;
+
+      const IntervalIntDomain& endTime = (goal->isMerged() ? goal->getActiveToken()->end()->baseDomain() : goal->end()->baseDomain());
+      if(endTime.getUpperBound() <= next || goal->start()->baseDomain().getUpperBound() < next ||
+	 (goal->isMerged() && goal->getActiveToken()->isCommitted()))
+	continue;
+
+      Checkpoint::addToken(state, Checkpoint::GOAL, goal);
+    }
+
+    // Which of these goals stand for the requests of another DbCore
+    std::set<int> saved;
+    for(std::vector<Checkpoint::Token>::const_iterator it = state.tokens.begin(); it != state.tokens.end(); ++it)
+      saved.insert(it->key);
+    for(std::map<int, EntityId>::const_iterator it = m_foreignKeyRelation.begin(); it != m_foreignKeyRelation.end(); ++it){
+      EntityId foreign = Entity::getEntity(it->first);
+      if(it->second->isDiscarded() || saved.find(it->second->getKey()) == saved.end() || foreign.isNoId() || !TokenId::convertable(foreign))
+	continue;
+
+      DbCoreId requester = DbCore::getInstance((TokenId) foreign);
+      if(requester.isNoId())
+	continue;
+
+      Checkpoint::Link link;
+      link.local = it->second->getKey();
+      link.reactor = requester->getName().toString();
+      link.foreign = it->first;
+      state.links.push_back(link);
+    }
+  }
+
+  bool DbCore::restore(const Checkpoint::Reactor& state, std::map<uint32_t, TokenId>& restored){
+    DebugStream::select(getStream());
+
+    m_solver->reset();
+
+    // The checkpoint replaces the facts and goals of the model. Slaves go with their masters.
+    std::vector<TokenId> initial;
+    const TokenSet& tokens = m_db->getTokens();
+    for(TokenSet::const_iterator it = tokens.begin(); it != tokens.end(); ++it)
+      if((*it)->master().isNoId())
+	initial.push_back(*it);
+    Entity::discardAll(initial);
+    purgeOrphanedKeys();
+
+    m_currentTickCycle = getCurrentTick();
+    m_state = DbCore::INACTIVE;
+
+    return m_synchronizer.restore(state, restored) && propagate();
+  }
+
+  void DbCore::restoreLinks(const Checkpoint::Reactor& state, const std::map<std::string, std::map<uint32_t, TokenId> >& restored,
+			    TokenSet& linked){
+    DebugStream::select(getStream());
+
+    std::map<std::string, std::map<uint32_t, TokenId> >::const_iterator local = restored.find(getName().toString());
+    for(std::vector<Checkpoint::Link>::const_iterator it = state.links.begin(); it != state.links.end(); ++it){
+      std::map<std::string, std::map<uint32_t, TokenId> >::const_iterator requester = restored.find(it->reactor);
+      if(local == restored.end() || requester == restored.end())
+	continue;
+
+      std::map<uint32_t, TokenId>::const_iterator goal = local->second.find(it->local);
+      std::map<uint32_t, TokenId>::const_iterator request = requester->second.find(it->foreign);
+      if(goal == local->second.end() || request == requester->second.end()){
+	debugMsg("DbCore:restoreLinks", nameString() << "Dropping the link of " << it->local << " to " << it->reactor << ":" << it->foreign);
+	continue;
+      }
+
+      linkRequest(request->second, goal->second);
+      applyConstraints(request->second);
+      linked.insert(request->second);
+    }
+
+    if(!state.links.empty())
+      propagate();
+  }
+
+  void DbCore::releaseDispatches(const TokenSet& linked){
+    for(std::map<int, TimelineContainer>::iterator it = m_externalTimelineTable.begin(); it != m_externalTimelineTable.end(); ++it){
+      TimelineContainer& tc = it->second;
+
+      // The server lost the goal this token was dispatched for, or is an adapter built anew: dispatch it again
+      TokenSet dispatched = tc.getDispatchedTokens();
+      for(TokenSet::const_iterator t = dispatched.begin(); t != dispatched.end(); ++t){
+	if(linked.find(*t) != linked.end())
+	  continue;
+	TREX_INFO("DbCore:releaseDispatches", nameString() << "Will dispatch " << tokenToString(*t) << " again");
+	tc.clearDispatched(*t);
+	resetDispatchTime(*t);
+      }
+    }
+  }
+
   std::string DbCore::writeConflict(std::string brief_description, std::string analysis) {
 
     // Write out associated DbState and Assembly for all reactors
@@ -877,6 +1161,7 @@ namespace TREX {
 
   void DbCore::handleTickStart(){
     m_sync_stepCount = 0;
+    m_unchangedObservations = 0;
     m_search_depth = 0;
     m_search_stepCount = 0;
     
@@ -906,7 +1191,10 @@ namespace TREX {
       return;
     
     // Send goals planned on server timelines
-    dispatchCommands();
+    {
+      LatencyLap lap(m_dispatchLatency);
+      dispatchCommands();
+    }
 
     TREX_INFO("trex:info", nameString() << "Database State Below" <<  std::endl << PlanDatabaseWriter::toString(m_db));
   }
@@ -939,6 +1227,13 @@ namespace TREX {
     return true;
   }
 
+  TICK DbCore::getPlanningDeadline() const {
+    if(m_state != DbCore::ACTIVE)
+      return TeleoReactor::getPlanningDeadline();
+
+    return (TICK) m_horizon.getLowerBound() - 1 + getLatency();
+  }
+
   void DbCore::resume(){
     TREX_INFO("DbCore:resume",  nameString() );
 
@@ -975,9 +1270,9 @@ namespace TREX {
     checkError(m_state == DbCore::ACTIVE, "Should always be in this state by now if clean up done correctly.");
 
 
-    // Retrieve and store a copy of the old horizon to reset afterwards. It is shared state for the process.
+    // The horizon is specific to this reactor, so it has to be set before each step.
     setHorizon();
-    const IntervalIntDomain& horizon = DeliberationFilter::getHorizon();
+    const IntervalIntDomain& horizon = getPlanningHorizon();
 
     TREX_INFO("DbCore:resume",  nameString() << "Using horizon " << horizon.toString());
 
@@ -1042,8 +1337,7 @@ namespace TREX {
    * In terminating a token, we can declare its final outcome if it were a goal
    */
   void DbCore::terminate(const TokenId& token){
-    static unsigned int sl_counter(0);
-    sl_counter++;
+    m_terminated++;
 
     TREX_INFO("trex:info", nameString() << "Terminating " << tokenToString(token));
 
@@ -1226,6 +1520,7 @@ namespace TREX {
 	// on the next iteration
 	if(startTime.intersects(dispatchWindow)){
 	  TREX_INFO("trex:dispatching", nameString() << "Dispatching " << token->toLongString());
+	  TREX_TRACE(TRACE_DISPATCH, TRACE_DISPATCH_REQUEST, getCurrentTick(), getTraceId(), token->getKey(), 0);
 	  token->getObject()->restrictBaseDomain(token->getObject()->lastDomain());
 
 	  if(!propagate()){
@@ -1279,6 +1574,7 @@ namespace TREX {
 	if(tc.isDispatched(token) && token->end()->baseDomain().getUpperBound() > getCurrentTick() && !observedNow(token)){
 
 	  TREX_INFO("trex:dispatching", nameString() << "Recalling " << tokenToString(token));
+	  TREX_TRACE(TRACE_DISPATCH, TRACE_DISPATCH_RECALL, getCurrentTick(), getTraceId(), token->getKey(), 0);
 	  server->recall(token);
 	  tc.clearDispatched(token);
 	  resetDispatchTime(token);
@@ -1341,6 +1637,7 @@ namespace TREX {
    */
   bool DbCore::extendCurrentValue(const TokenId& token){
     TREX_INFO("DbCore:extendCurrentValue:token", nameString() << "Extending " << tokenToString(token) << " for end >= " << getCurrentTick());
+    TREX_TRACE(TRACE_DBCORE, TRACE_DBCORE_EXTEND, getCurrentTick(), getTraceId(), token->getKey(), getCurrentTick());
 
     checkError(token->start()->lastDomain().getUpperBound() <= getCurrentTick(),
 	       token->start()->lastDomain() << " and TICK " << getCurrentTick());
@@ -1424,11 +1721,9 @@ namespace TREX {
     // Update base domains on uncommitted slaves.
     const TokenSet slaves = token->slaves();
     for(TokenSet::const_iterator it = slaves.begin(); it != slaves.end(); ++it){
-      static unsigned int sl_counter(0);
-
       TokenId slave = *it;
 
-      TREX_INFO("DbCore:updateRelatedTokens", nameString() << "Evaluating slave " << slave->toString() << "[" << sl_counter++ << "]");
+      TREX_INFO("DbCore:updateRelatedTokens", nameString() << "Evaluating slave " << slave->toString() << "[" << m_slavesEvaluated++ << "]");
 
       // If the slave is merged onto an active token, we can restrict the bounds of the
       // active token accordingly to persist the impact of the merge
@@ -1514,20 +1809,20 @@ namespace TREX {
   }
 
   bool DbCore::hasEntity(const EntityId& entity){
-    return s_foreignKeyRelation.find(entity->getKey()) != s_foreignKeyRelation.end();
+    return m_foreignKeyRelation.find(entity->getKey()) != m_foreignKeyRelation.end();
   }
 
   void DbCore::addEntity(const EntityId& foreign, const EntityId& local){
-    s_foreignKeyRelation.insert(std::pair<int, EntityId>(foreign->getKey(), local));
+    m_foreignKeyRelation.insert(std::pair<int, EntityId>(foreign->getKey(), local));
   }
 
   void DbCore::removeEntity(const EntityId& foreign){
-    s_foreignKeyRelation.erase(foreign->getKey());
+    m_foreignKeyRelation.erase(foreign->getKey());
   }
 
   EntityId DbCore::getLocalEntity(const EntityId& foreign){
-    std::map<int, EntityId>::const_iterator it = s_foreignKeyRelation.find(foreign->getKey());
-    if(it != s_foreignKeyRelation.end()){
+    std::map<int, EntityId>::const_iterator it = m_foreignKeyRelation.find(foreign->getKey());
+    if(it != m_foreignKeyRelation.end()){
       EntityId e = it->second;
       checkError(e.isValid(), e << " is a stale id for " << foreign->toString());
       return e;
@@ -1537,7 +1832,7 @@ namespace TREX {
   }
 
   EntityId DbCore::getForeignEntity(const EntityId& local){
-    for(std::map<int, EntityId>::iterator it = s_foreignKeyRelation.begin(); it != s_foreignKeyRelation.end(); ++it){
+    for(std::map<int, EntityId>::iterator it = m_foreignKeyRelation.begin(); it != m_foreignKeyRelation.end(); ++it){
       if(it->second == local){
 	EntityId foreignEntity = Entity::getEntity(it->first);
 	return foreignEntity;
@@ -1548,11 +1843,11 @@ namespace TREX {
   }
 
   void DbCore::purgeOrphanedKeys(){
-    std::map<int, EntityId>::iterator it = s_foreignKeyRelation.begin();
-    while(it != s_foreignKeyRelation.end()){
+    std::map<int, EntityId>::iterator it = m_foreignKeyRelation.begin();
+    while(it != m_foreignKeyRelation.end()){
       int foreignKey = it->first;
       if(it->second->isDiscarded() || Entity::getEntity(foreignKey).isNoId())
-	s_foreignKeyRelation.erase(it++);
+	m_foreignKeyRelation.erase(it++);
       else
 	++it;
     }
@@ -1724,6 +2019,7 @@ namespace TREX {
 
       if(restrict(token) && updateRelatedTokens(token)){
 	TREX_INFO("DbCore:archive", nameString() << tokenToString(token) << " is a candidate for termination.");
+	TREX_TRACE(TRACE_DBCORE, TRACE_DBCORE_ARCHIVE, getCurrentTick(), getTraceId(), token->getKey(), 0);
 
 	disconnectConstraints(token);
 
@@ -1746,13 +2042,69 @@ namespace TREX {
     purgeOrphanedKeys();
     Entity::garbageCollect();
 
+    // Whatever ended before the oldest token still committed has now been archived. The frontier never moves back.
+    TICK frontier = getCurrentTick();
+    TokenSet kept = m_committedTokens;
+    kept.insert(m_terminableTokens.begin(), m_terminableTokens.end());
+    for(TokenSet::const_iterator it = kept.begin(); it != kept.end() && frontier > m_archiveFrontier; ++it){
+      double start = (*it)->start()->lastDomain().getLowerBound();
+      if(start < frontier)
+	frontier = (start <= m_archiveFrontier ? m_archiveFrontier : (TICK) start);
+    }
+    m_archiveFrontier = frontier;
+
     condDebugMsg(m_db->getConstraintEngine()->isRelaxed(), "trex:error", nameString() << "Should be no relaxation in garbage collection");
   }
 
+  void DbCore::compact(){
+    // Archive skips the ticks the database is planning or inconsistent, and leaves its terminated tokens behind
+    Entity::discardAll(m_terminatedTokens);
+
+    // Notifications are only looked for on tokens that have not ended. Keys are never reused.
+    std::set<int>::iterator notification = m_notificationKeys.begin();
+    while(notification != m_notificationKeys.end()){
+      EntityId entity = Entity::getEntity(*notification);
+      if(entity.isNoId() || entity->isDiscarded() || ((TokenId) entity)->end()->baseDomain().getUpperBound() <= m_archiveFrontier)
+	m_notificationKeys.erase(notification++);
+      else
+	++notification;
+    }
+
+    std::map<int, bool>::iterator scope = m_tokenScope.begin();
+    while(scope != m_tokenScope.end()){
+      if(Entity::getEntity(scope->first).isNoId())
+	m_tokenScope.erase(scope++);
+      else
+	++scope;
+    }
+
+    purgeOrphanedKeys();
+    if(m_recallBuffer.empty())
+      std::vector<int>().swap(m_recallBuffer);
+    Entity::garbageCollect();
+    accountMemory();
+  }
+
+  void DbCore::accountMemory(){
+    m_nTokens = m_db->getTokens().size();
+    m_nVariables = m_db->getConstraintEngine()->getVariables().size();
+    m_nConstraints = m_db->getConstraintEngine()->getConstraints().size();
+    m_nKeys = m_notificationKeys.size() + m_tokenScope.size() + m_foreignKeyRelation.size() + m_terminatedTokens.size();
+  }
+
+  void DbCore::getMemoryUsage(unsigned long& nTokens, unsigned long& nVariables, unsigned long& nConstraints, unsigned long& nKeys) const {
+    nTokens = m_nTokens;
+    nVariables = m_nVariables;
+    nConstraints = m_nConstraints;
+    nKeys = m_nKeys;
+  }
+
   void DbCore::setHorizon(){
     TICK horizonStart, horizonEnd;
     getHorizon(horizonStart, horizonEnd);
-    DeliberationFilter::update(horizonStart, horizonEnd);
+    checkError(horizonStart >= getCurrentTick(), horizonStart << " < " << getCurrentTick());
+    checkError(horizonEnd <= Agent::instance()->getFinalTick(), horizonEnd << " > " << Agent::instance()->getFinalTick());
+    m_horizon = IntervalIntDomain((int) horizonStart, (int) horizonEnd);
   }
 
   void DbCore::getHorizon(TICK& horizonStart, TICK& horizonEnd) const {
@@ -1888,15 +2240,16 @@ namespace TREX {
   }
 
   DbCoreId DbCore::getInstance(const TokenId& token){
-    if(instancesByDb().empty())
-      return DbCoreId::noId();
+    return getInstance(token->getPlanDatabase());
+  }
 
-    PlanDatabaseId db = token->getPlanDatabase();
+  DbCoreId DbCore::getInstance(const PlanDatabaseId& db){
+    Guardian<Mutex> guard(instancesMutex());
     std::map<PlanDatabaseId, DbCoreId>::const_iterator it = instancesByDb().find(db);
-    checkError(it != instancesByDb().end(), "No db core for " << tokenToString(token));
-    DbCoreId dbCore = it->second;
-    checkError(dbCore.isValid(), dbCore);
-    return dbCore;
+    if(it == instancesByDb().end())
+      return DbCoreId::noId();
+    checkError(it->second.isValid(), it->second);
+    return it->second;
   }
 
   /**
@@ -1904,11 +2257,18 @@ namespace TREX {
    */
   bool DbCore::synchronize(){
 
-    processPendingTokens();
+    {
+      LatencyLap lap(m_pendingLatency);
+      processPendingTokens();
+    }
     
     bool solver_timed_out = isSolverTimedOut();
     bool external_timeline_complete_fail = !completeExternalTimelines();
-    bool resolve_fail = !m_synchronizer.resolve();
+    bool resolve_fail;
+    {
+      LatencyLap lap(m_resolveLatency);
+      resolve_fail = !m_synchronizer.resolve();
+    }
 
     if(solver_timed_out || external_timeline_complete_fail || resolve_fail){
       // Undo any impacts of solver. Reset this before making any deletions to avoid corrupting the stack
@@ -1923,19 +2283,26 @@ namespace TREX {
       // Revert to INACTIVE state
       m_state = DbCore::INACTIVE;
       
-      // First just try to relax and resolve. 
-      bool relax_fail = !m_synchronizer.relax(false);
-      bool resolve_fail = !m_synchronizer.resolve();
+      // First try to relax only the neighborhood of the conflict, leaving the rest of the plan in place.
+      bool local_repair = !discardCurrentValues && m_synchronizer.relaxLocal() && m_synchronizer.resolve();
 
-      // If this fails the first time, apply a stronger relaxation where we discard current values that are not persistent.
-      if(discardCurrentValues || relax_fail || resolve_fail){
-	// Cleare the state again
+      if(!local_repair){
 	m_state = DbCore::INACTIVE;
 
-	bool relax_fail = !m_synchronizer.relax(true);
+	// Then relax the whole database and resolve. 
+	bool relax_fail = !m_synchronizer.relax(false);
 	bool resolve_fail = !m_synchronizer.resolve();
-	if( relax_fail || resolve_fail) {
-	  return false;
+
+	// If this fails the first time, apply a stronger relaxation where we discard current values that are not persistent.
+	if(discardCurrentValues || relax_fail || resolve_fail){
+	  // Cleare the state again
+	  m_state = DbCore::INACTIVE;
+
+	  bool relax_fail = !m_synchronizer.relax(true);
+	  bool resolve_fail = !m_synchronizer.resolve();
+	  if( relax_fail || resolve_fail) {
+	    return false;
+	  }
 	}
       }
 
@@ -1947,16 +2314,32 @@ namespace TREX {
     // These final steps must succeed or synchronization will fail. If they do not succeed
     // the database will be marked invalid. Each operation below will be a NOP if attempted
     // on an invalid database
-    commit();
-    notifyObservers();
-    updateGoals();
-    archive();
+    {
+      LatencyLap lap(m_commitLatency);
+      commit();
+    }
+    {
+      LatencyLap lap(m_notifyLatency);
+      notifyObservers();
+    }
+    {
+      LatencyLap lap(m_updateGoalsLatency);
+      updateGoals();
+    }
+    {
+      LatencyLap lap(m_archiveLatency);
+      archive();
+    }
+    accountMemory();
 
     TREX_INFO("DbCore:synchronize", nameString() <<  "Synchronized Database Below" << std::endl << PlanDatabaseWriter::toString(m_db));
     
     // Write the nominal reactor state files (low bandwidth)
     TREX_INFO("trex:monitor:nominal", nameString() << dumpState(false));
 
+    if(m_state != DbCore::INVALID && Agent::instance()->getBus() != NULL)
+      publishPlan(*Agent::instance()->getBus());
+
     return m_state != DbCore::INVALID;
   }
 
@@ -2118,6 +2501,7 @@ namespace TREX {
    */
   void DbCore::commitAndRestrict(const TokenId& token){
     TREX_INFO("trex:debug:synchronization:commitAndRestrict", "Committing " << tokenToString(token));
+    TREX_TRACE(TRACE_DBCORE, TRACE_DBCORE_COMMIT, getCurrentTick(), getTraceId(), token->getKey(), 0);
 
     // Commit the token and touch the state variable to trigger commit event based propagation
     token->commit();
@@ -2215,6 +2599,23 @@ namespace TREX {
       logToken(*tokit);
   }
 
+  void DbCore::publishPlan(ObservationBus& bus) {
+    bus.beginPlan(getCurrentTick(), getName(), m_internalTimelineTable.size());
+    for(std::vector< std::pair<TimelineId, TICK> >::const_iterator it = m_internalTimelineTable.begin(); it != m_internalTimelineTable.end(); ++it){
+      const std::list<TokenId>& tokens = it->first->getTokenSequence();
+
+      // Skip the values that are over
+      std::list<TokenId>::const_iterator first = tokens.begin();
+      while(first != tokens.end() && (*first)->end()->lastDomain().getUpperBound() <= getCurrentTick())
+	++first;
+
+      bus.addTimeline(it->first->getName(), std::distance(first, tokens.end()));
+      for( ; first != tokens.end(); ++first)
+	bus.addToken(*first);
+    }
+    bus.endPlan();
+  }
+
   std::string DbCore::logPlan(const std::string& msg) {
     m_planLog <<'['<<getCurrentTick()<<"] " << msg << " :\n";
 
@@ -2431,6 +2832,7 @@ namespace TREX {
 
     // Output log line
     TREX_INFO("trex:warning", nameString() << " is marked invalid. Hint:" << comment);
+    TREX_TRACE(TRACE_DBCORE, TRACE_DBCORE_INVALID, getCurrentTick(), getTraceId(), 0, 0);
     if(dump_state) {
       TREX_INFO("trex:monitor:conflicts:nominal", nameString() << "Dumping conflict: " << writeConflict(comment, analysis)); 
     }
@@ -2649,15 +3051,20 @@ namespace TREX {
   }
 
   void DbCore::addToTokenAgenda(const TokenId& token){
-    if(!token->isDiscarded())
+    if(!token->isDiscarded()){
       m_tokenAgenda.insert(token);
+      m_synchronizer.handleAgendaAddition(token);
+    }
 
     TREX_INFO("trex:debug:tokenAgenda:addToTokenAgenda", tokenToString(token));
+    TREX_TRACE(TRACE_TOKEN_AGENDA, TRACE_AGENDA_ADD, getCurrentTick(), getTraceId(), token->getKey(), 0);
   }
 
   void DbCore::removeFromTokenAgenda(const TokenId& token){
     m_tokenAgenda.erase(token);
+    m_synchronizer.handleAgendaRemoval(token);
     TREX_INFO("trex:debug:tokenAgenda:removeFromTokenAgenda", tokenToString(token));
+    TREX_TRACE(TRACE_TOKEN_AGENDA, TRACE_AGENDA_REMOVE, getCurrentTick(), getTraceId(), token->getKey(), 0);
   }
 
   /**
@@ -51,6 +51,8 @@ using namespace EUROPA::SOLVERS;
 
 namespace TREX {
 
+  class ObservationBus;
+
   /**
    * @brief Specialized filter to enforce deliberation horizon and other standardized policies that arise for the
    * planner.
@@ -63,13 +65,16 @@ namespace TREX {
 
     std::ostream& getStream();
 
-    static void update(TICK start, TICK end);
-
-    static const IntervalIntDomain& getHorizon();
+    /**
+     * @brief The deliberation horizon of the reactor owning the given database.
+     * @return The horizon set by that reactor, or HorizonFilter::getHorizon() if no reactor owns it.
+     */
+    static const IntervalIntDomain& getHorizon(const PlanDatabaseId& db);
 
   private:
     DbCoreId m_core;
-    static IntervalIntDomain& horizon();
+    unsigned int m_evaluations; /*!< Debugging aid */
+    const IntervalIntDomain& horizon() const;
     static TICK currentTick();
   };
 
@@ -245,6 +250,23 @@ namespace TREX {
      */
     static DbCoreId getInstance(const TokenId& token);
 
+    /**
+     * @brief Accessor to retrieve the dbcore owning the given plan database.
+     * @return noId() if there is none.
+     */
+    static DbCoreId getInstance(const PlanDatabaseId& db);
+
+    /**
+     * @brief The EUROPA database of this reactor
+     */
+    const PlanDatabaseId& getPlanDatabase() const { return m_db; }
+
+    /**
+     * @brief The horizon used by the deliberation filter, as last set by setHorizon.
+     * Each reactor has its own so that reactors can deliberate independently.
+     */
+    const IntervalIntDomain& getPlanningHorizon() const { return m_horizon; }
+
     /**
      * @brief Test if the given toke is on a timeline that is in scope
      */
@@ -262,6 +284,13 @@ namespace TREX {
 
     void notify(const Observation& observations);
 
+    /**
+     * @brief An observation on an external timeline has to name a predicate of the timeline's type in the schema,
+     * and parameters of that predicate with values of their type. Values outside the base domain declared by the
+     * predicate are dropped later by notify.
+     */
+    bool isValidObservation(const Observation& observation) const;
+
     bool handleRequest(const TokenId& goal);
 
     void handleRecall(const TokenId& goal);
@@ -283,6 +312,43 @@ namespace TREX {
      */
     std::string dumpState(bool export_assembly = false);
 
+    /**
+     * @brief Add the execution state to a checkpoint: current values and observations, the plan ahead of them
+     * with the tokens dispatched from it, the goals still to plan and the requests of other DbCore reactors
+     * these goals were posted for.
+     * @pre Called right after synchronization, for the tick of @e out.
+     * @see Agent::writeCheckpoint
+     */
+    void checkpoint(Checkpoint& out);
+
+    /**
+     * @brief Replace the initial state of the model with the state recorded in a checkpoint.
+     * @param state The state of this reactor in the checkpoint
+     * @param restored Filled with the restored tokens, by their key in the checkpoint
+     * @pre The agent is at the tick following the checkpoint.
+     * @return false if the recorded values could not be inserted, in which case the database is invalid.
+     * @see Synchronizer::restore, restoreLinks
+     */
+    bool restore(const Checkpoint::Reactor& state, std::map<uint32_t, TokenId>& restored);
+
+    /**
+     * @brief Link the restored goals to the restored requests of other reactors, as handleRequest did.
+     * @param state The state of this reactor in the checkpoint
+     * @param restored The tokens restored by each reactor, by reactor name
+     * @param linked Filled with the requests linked to a goal of this reactor
+     * @pre All the DbCore reactors of the agent are restored.
+     */
+    void restoreLinks(const Checkpoint::Reactor& state, const std::map<std::string, std::map<uint32_t, TokenId> >& restored,
+		      TokenSet& linked);
+
+    /**
+     * @brief Clear the dispatch of restored tokens that no server linked to a goal, so that they are dispatched again.
+     * Adapters keep no goals across a restart, so everything dispatched to them is sent again.
+     * @param linked The requests linked by all the reactors
+     * @see restoreLinks
+     */
+    void releaseDispatches(const TokenSet& linked);
+
     /**
      * @brief Add a PlanDatabaseListener to the internal EUROPA PlanDatabase
      */
@@ -320,6 +386,28 @@ namespace TREX {
      */
     virtual void resume();
 
+    /**
+     * @brief Discard the terminated tokens, forget the notifications and scopes of tokens archived or ended
+     * before the archive frontier, and release unused buffers.
+     */
+    virtual void compact();
+
+    /**
+     * @brief The start of the oldest token still committed. Everything that ended before it is archived.
+     */
+    virtual TICK getArchiveFrontier() const {return m_archiveFrontier;}
+
+    /**
+     * @brief The memory accounting reported in the tick log. Updated after every archive and compaction.
+     */
+    void getMemoryUsage(unsigned long& nTokens, unsigned long& nVariables, unsigned long& nConstraints, unsigned long& nKeys) const;
+
+    /**
+     * @brief While a deliberation cycle is active, the plan for its horizon is due
+     * latency ticks after the tick the cycle started.
+     */
+    TICK getPlanningDeadline() const;
+
     enum State {
       INACTIVE = 0,
       ACTIVE,
@@ -350,6 +438,11 @@ namespace TREX {
      */
     Assembly& getAssembly(){return m_assembly;}
 
+    /**
+     * @brief Observations of the current tick that only confirmed the current value, and made no token
+     */
+    unsigned int getUnchangedObservationCount() const {return m_unchangedObservations;}
+
   private:
     /**
      * @brief Apply inertial value assumption to external timelines
@@ -425,24 +518,29 @@ namespace TREX {
      */
     void removeFromTokenAgenda(const TokenId& token);
 
-    /** Handle foreign/local keys. Can be static as there should only be one server per timeline **/
-    static bool hasEntity(const EntityId& foreign);
+    /** Handle foreign/local keys of the goals posted to this reactor **/
+    bool hasEntity(const EntityId& foreign);
+
+    void addEntity(const EntityId& foreign, const EntityId& local);
 
-    static void addEntity(const EntityId& foreign, const EntityId& local);
+    void removeEntity(const EntityId& foreign);
 
-    static void removeEntity(const EntityId& foreign);
+    EntityId getLocalEntity(const EntityId& foreign);
 
-    static EntityId getLocalEntity(const EntityId& foreign);
+    EntityId getForeignEntity(const EntityId& local);
 
-    static EntityId getForeignEntity(const EntityId& local);
+    /**
+     * @brief Record that @e localGoal, its object, timepoints and parameters stand for those of the request @e goal.
+     */
+    void linkRequest(const TokenId& goal, const TokenId& localGoal);
 
     /**
      * @brief To prevent memory growth due to lost entries we provide a way to purge
      * entries whose keys no longer map to entities.
      */
-    static void purgeOrphanedKeys();
+    void purgeOrphanedKeys();
 
-    static std::map<int, EntityId> s_foreignKeyRelation; /*!< Link by key for copied token when dispatching goals */
+    std::map<int, EntityId> m_foreignKeyRelation; /*!< Link by key for copied token when dispatching goals */
 
     /**
      * @brief Utility to dactive the main solver when done with it.
@@ -647,6 +745,30 @@ namespace TREX {
     std::map< int, TimelineContainer > m_externalTimelineTable; /*!< Logs arrival of observations per external timeline. 
 								  Should be garbage collected when we archive */
 
+    /**
+     * @brief What notify needs to turn observations of an external timeline into tokens, resolved once.
+     */
+    struct ObservationBinding {
+      ObjectId object;
+      TimelineContainer* container;
+      /** Per predicate, the name and parameter slot of each observation parameter, in the order they were observed */
+      std::map<double, std::vector< std::pair<double, unsigned int> > > slots;
+    };
+
+    std::map<double, ObservationBinding> m_observationBindings; /*!< By external timeline name. Built with m_externalTimelineTable */
+
+    /**
+     * @brief The token parameter for the index-th parameter of an observation, resolved by name the first time.
+     */
+    ConstrainedVariableId getObservedParameter(ObservationBinding& binding, const TokenId& token, const LabelStr& predicate,
+					       unsigned int index, const LabelStr& varName);
+
+    /**
+     * @brief True if the observation only confirms the value the timeline had at the previous tick, which can
+     * then be extended as if no observation was received.
+     */
+    bool isUnchangedObservation(const ObservationBinding& binding, const Observation& observation);
+
     TokenSet m_goals; /*!< Store all goals */
 
     TokenSet m_observations; /*!< Store received observations received */
@@ -676,8 +798,12 @@ namespace TREX {
 
     TokenSet m_terminableTokens; /*!< Buffer of committed tokens that are pending termination */
     TokenSet m_terminatedTokens; /*!< Buffer of terminated tokens ready to discard */
+    TICK m_archiveFrontier; /*!< Start of the oldest committed token after the last archive */
 
     unsigned int m_sync_stepCount; /* Number of steps for synchronisation */
+    unsigned int m_unchangedObservations; /* Observations that only confirmed the current value in this tick */
+    unsigned long m_nTokens, m_nVariables, m_nConstraints; /* Size of the database at the end of the tick */
+    unsigned long m_nKeys; /* Entries kept for notifications, token scopes, foreign keys and terminated tokens */
 
     unsigned int m_search_depth;
     unsigned int m_search_stepCount;
@@ -693,6 +819,16 @@ namespace TREX {
     void logTimeLine(TimelineId const &tl, std::string const &type);
     void logToken(TokenId const &tok);
 
+    /**
+     * @brief Publish the current and planned values of the internal timelines on the observation bus
+     */
+    void publishPlan(ObservationBus& bus);
+
+    /**
+     * @brief Update the memory accounting of the tick log from the size of the database and of the bookkeeping.
+     */
+    void accountMemory();
+
     void fillTimelineDescription(const TimelineId tl, PlanDescription::TimelineDescription &tlDesc) const;
 
     /**
@@ -708,6 +844,17 @@ namespace TREX {
     std::string m_conflictPath;
     std::ofstream m_planLog;
     unsigned int m_lastRecalled;
+    IntervalIntDomain m_horizon; /*!< Current deliberation horizon */
+    unsigned int m_terminated, m_slavesEvaluated; /*!< Debugging aids */
+
+    /** Latency of each synchronization step, and of dispatching */
+    LatencyHistogram& m_pendingLatency;
+    LatencyHistogram& m_resolveLatency;
+    LatencyHistogram& m_commitLatency;
+    LatencyHistogram& m_notifyLatency;
+    LatencyHistogram& m_updateGoalsLatency;
+    LatencyHistogram& m_archiveLatency;
+    LatencyHistogram& m_dispatchLatency;
   };
 }
 
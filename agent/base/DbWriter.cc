@@ -59,6 +59,7 @@
 #include "RuleInstance.hh"
 
 #include "Debug.hh"
+#include "Compression.hh"
 
 #include "tinyxml.h"
 
@@ -77,12 +78,13 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <strings.h>
-#include <sys/param.h>
 #include <sys/stat.h>
+#include <sys/param.h>
 #include <sys/time.h>
 #include <sys/types.h>
 #include <unistd.h>
 #include <sstream>
+#include <stdint.h>
 
 #define FatalError(cond, msg...){Error(cond, msg, __FILE__, __LINE__).handleAssert();}
 #define FatalErrno(){FatalError("Condition", strerror(errno))}
@@ -178,6 +180,31 @@ namespace TREX {
 
   const std::string configSections[] = {GENERAL_CONFIG_SECTION, RULE_CONFIG_SECTION};
 
+  /* Files of a step in the PlanWorks layout. This is also the order of the sections in a step log record */
+  const std::string SECTION_NAMES[] = {PARTIAL_PLAN, OBJECTS, TOKENS, RULE_INSTANCES, RULE_INSTANCE_SLAVE_MAP, 
+				       VARIABLES, CONSTRAINTS, CONSTRAINT_VAR_MAP, INSTANTS, DECISIONS};
+  enum sectionIds {S_PARTIAL_PLAN = 0, S_OBJECTS, S_TOKENS, S_RULE_INSTANCES, S_RULE_INSTANCE_SLAVE_MAP,
+		   S_VARIABLES, S_CONSTRAINTS, S_CONSTRAINT_VAR_MAP, S_INSTANTS, S_DECISIONS, SECTION_COUNT};
+
+  const std::string STEP_LOG("steps");
+  const char STEP_LOG_MAGIC[] = "TRXSTEPS";
+  const uint32_t STEP_LOG_VERSION = 2;
+
+  /* Precedes the compressed sections of a step in the step log */
+  struct StepHeader {
+    uint32_t size; // compressed bytes following the header
+    uint32_t rawSize;
+    int32_t tick;
+    uint32_t attempt;
+    int64_t ppId;
+    uint32_t flags;
+    uint32_t reserved;
+  };
+
+  /* A keyframe holds the whole database. Other steps only hold the entities changed since the 
+     previous step followed by the keys of the removed ones. */
+  const uint32_t STEP_KEYFRAME = 1;
+
 #ifdef __BEOS__
 #define NBBY 8
   static char *realpath(const char *path, char *resolved_path) {
@@ -212,7 +239,16 @@ namespace TREX {
       reId(re), 
       stepCount(0),
       destAlreadyInitialized(false), 
-      m_writing(false){
+      m_writing(false),
+      m_segmentSize(0),
+      m_segment(0),
+      m_segmentBytes(0),
+      m_keyframePeriod(0),
+      m_lastKeyframe(0),
+      m_keyframe(true),
+      m_dbChanges(NULL),
+      m_ceChanges(NULL),
+      m_discard(NULL){
     //add default directories to search for model files
     sourcePaths.push_back("");
     sourcePaths.push_back(".");
@@ -227,6 +263,8 @@ namespace TREX {
   }
 
   DbWriter::~DbWriter(void) {
+    delete m_dbChanges;
+    delete m_ceChanges;
     if(destAlreadyInitialized) {
       statsOut->close();
       delete statsOut;
@@ -258,16 +296,13 @@ namespace TREX {
      collected incrementally
   */
   void DbWriter::collectStats(void) {
-    TokenSet tokens(pdbId->getTokens());
-    numTokens = tokens.size();
-    ConstrainedVariableSet variables = ceId->getVariables();
-    numVariables = variables.size();
-    const ConstraintSet &constraints = ceId->getConstraints();
-    numConstraints = constraints.size();
+    numTokens = pdbId->getTokens().size();
+    numVariables = ceId->getVariables().size();
+    numConstraints = ceId->getConstraints().size();
   }
 
   void DbWriter::outputObject(const ObjectId &objId, const int type,
-			      std::ofstream &objOut, std::ofstream &varOut) {
+			      std::ostream &objOut, std::ostream &varOut) {
     int parentKey = -1;
     if(!objId->getParent().isNoId())
       parentKey = objId->getParent()->getKey();
@@ -317,8 +352,8 @@ namespace TREX {
 
   void DbWriter::outputToken(const TokenId &token, const int type, const int slotId, 
 			     const int slotIndex, const int slotOrder, 
-			     const ObjectId &tId, std::ofstream &tokOut, 
-			     std::ofstream &varOut) {
+			     const ObjectId &tId, std::ostream &tokOut, 
+			     std::ostream &varOut) {
     check_error(token.isValid());
     if(token->isIncomplete()) {
       std::cerr << "Token " << token->getKey() << " is incomplete.  Skipping. " << std::endl;
@@ -384,7 +419,8 @@ namespace TREX {
   
   void DbWriter::outputStateVar(const Id<TokenVariable<StateDomain> >& stateVar,
 				const int parentId, const int type,
-				std::ofstream &varOut) {
+				std::ostream &varStream) {
+    std::ostream &varOut = select(stateVar->getKey(), varStream);
 	
     varOut << stateVar->getKey() << TAB << ppId << TAB << parentId << TAB 
 	   << stateVar->getName().toString() << TAB;
@@ -405,7 +441,8 @@ namespace TREX {
 
   void DbWriter::outputEnumVar(const Id<TokenVariable<EnumeratedDomain> >& enumVar, 
 			       const int parentId, const int type,
-			       std::ofstream &varOut) {
+			       std::ostream &varStream) {
+    std::ostream &varOut = select(enumVar->getKey(), varStream);
 	
     varOut << enumVar->getKey() << TAB << ppId << TAB << parentId << TAB 
 	   << enumVar->getName().toString() << TAB;
@@ -420,7 +457,8 @@ namespace TREX {
   
   void DbWriter::outputIntVar(const Id<TokenVariable<IntervalDomain> >& intVar,
 			      const int parentId, const int type,
-			      std::ofstream &varOut) {
+			      std::ostream &varStream) {
+    std::ostream &varOut = select(intVar->getKey(), varStream);
 	
     varOut << intVar->getKey() << TAB << ppId << TAB << parentId << TAB 
 	   << intVar->getName().toString() << TAB;
@@ -434,7 +472,8 @@ namespace TREX {
   
   void DbWriter::outputIntIntVar(const Id<TokenVariable<IntervalIntDomain> >& intVar,
 				 const int parentId, const int type,
-				 std::ofstream &varOut) {
+				 std::ostream &varStream) {
+    std::ostream &varOut = select(intVar->getKey(), varStream);
 	
 
     varOut << intVar->getKey() << TAB << ppId << TAB << parentId << TAB 
@@ -449,7 +488,8 @@ namespace TREX {
 
   void DbWriter::outputObjVar(const ObjectVarId& objVar,
 			      const int parentId, const int type,
-			      std::ofstream &varOut) {
+			      std::ostream &varStream) {
+    std::ostream &varOut = select(objVar->getKey(), varStream);
 	
 
     varOut << objVar->getKey() << TAB << ppId << TAB << parentId << TAB 
@@ -470,7 +510,8 @@ namespace TREX {
   
   void DbWriter::outputConstrVar(const ConstrainedVariableId &otherVar, 
 				 const int parentId, const int type,
-				 std::ofstream &varOut) {
+				 std::ostream &varStream) {
+    std::ostream &varOut = select(otherVar->getKey(), varStream);
 	
 
     varOut << otherVar->getKey() << TAB << ppId << TAB << parentId << TAB 
@@ -492,8 +533,10 @@ namespace TREX {
     varOut << tokenVarTypes[type] << std::endl;
   }
 
-  void DbWriter::outputConstraint(const ConstraintId &constrId, std::ofstream &constrOut, 
-				  std::ofstream &cvmOut) {
+  void DbWriter::outputConstraint(const ConstraintId &constrId, std::ostream &constrStream, 
+				  std::ostream &cvmStream) {
+    std::ostream &constrOut = select(constrId->getKey(), constrStream);
+    std::ostream &cvmOut = select(constrId->getKey(), cvmStream);
     constrOut << constrId->getKey() << TAB << ppId << TAB << constrId->getName().toString() 
 	      << TAB << ATEMPORAL << std::endl;
     std::vector<ConstrainedVariableId>::const_iterator it =
@@ -504,9 +547,9 @@ namespace TREX {
   }
 
   void DbWriter::outputRuleInstance(const RuleInstanceId &ruleId,
-				    std::ofstream &ruleInstanceOut,
-				    std::ofstream &varOut,
-				    std::ofstream &rismOut) {
+				    std::ostream &ruleInstanceOut,
+				    std::ostream &varOut,
+				    std::ostream &rismOut) {
 
     ruleInstanceOut << ruleId->getKey() << TAB << ppId << TAB << seqId
 		    << TAB << ruleId->getRule()->getName().toString()
@@ -735,98 +778,58 @@ namespace TREX {
 
     numTokens = numVariables = numConstraints = 0;
 
-    // Generate step string
-    std::ostringstream oss;
-    oss<<tick<<"."<<attempt<<"."<<STEP;
-    
-    std::string stepnum = oss.str();
-
-    std::string ppDest = dest + SLASH + stepnum;
-    if(mkdir(ppDest.c_str(), 0777) && errno != EEXIST) {
-      std::cerr << "Failed to create " << ppDest << std::endl;
-      FatalErrno();
-    }
-
-    stepnum = "plan";
-
-    std::string ppPartialPlan = ppDest + SLASH + stepnum + PARTIAL_PLAN;
-    std::ofstream ppOut(ppPartialPlan.c_str());
-    if(!ppOut) {
-      FatalErrno();
-    }
-
-    ppOut << stepnum << TAB << ppId << TAB << pdbId->getSchema()->getName().toString()
+    // A segment of the step log always starts with a keyframe so that it can be read alone
+    m_keyframe = (m_keyframePeriod == 0 || stepCount == 0 || tick >= m_lastKeyframe + m_keyframePeriod ||
+		  !m_stepOut.is_open() || m_segmentBytes >= m_segmentSize);
+    if(m_keyframe)
+      m_lastKeyframe = tick;
+
+    // Each section is formatted in memory. It is then either written to its 
+    // own file (PlanWorks layout) or appended with the others to the step log.
+    std::ostringstream sections[SECTION_COUNT];
+    std::ostream &ppOut = sections[S_PARTIAL_PLAN];
+    std::ostream &objOut = sections[S_OBJECTS];
+    std::ostream &tokOut = sections[S_TOKENS];
+    std::ostream &ruleInstanceOut = sections[S_RULE_INSTANCES];
+    std::ostream &rismOut = sections[S_RULE_INSTANCE_SLAVE_MAP];
+    std::ostream &varOut = sections[S_VARIABLES];
+    std::ostream &constrOut = sections[S_CONSTRAINTS];
+    std::ostream &cvmOut = sections[S_CONSTRAINT_VAR_MAP];
+
+    ppOut << STEP << TAB << ppId << TAB << pdbId->getSchema()->getName().toString()
 	  << TAB << seqId << std::endl;
-    ppOut.close();
-
-    std::string ppObj = ppDest + SLASH + stepnum + OBJECTS;
-    std::ofstream objOut(ppObj.c_str());
-    if(!objOut) {
-      FatalErrno();
-    }
-
-    std::string ppTok = ppDest + SLASH + stepnum + TOKENS;
-    std::ofstream tokOut(ppTok.c_str());
-    if(!tokOut) {
-      FatalErrno();
-    }
-
-    std::string ppRuleInstances = ppDest + SLASH + stepnum + RULE_INSTANCES;
-    std::ofstream ruleInstanceOut(ppRuleInstances.c_str());
-    if(!ruleInstanceOut) {
-      FatalErrno();
-    }
-
-    std::string ppRISM = ppDest + SLASH + stepnum + RULE_INSTANCE_SLAVE_MAP;
-    std::ofstream rismOut(ppRISM.c_str());
-    if(!rismOut) {
-      FatalErrno();
-    }
-
-    std::string ppVars = ppDest + SLASH + stepnum + VARIABLES;
-    std::ofstream varOut(ppVars.c_str());
-    if(!varOut) {
-      FatalErrno();
-    }
-
-    std::string ppConstrs = ppDest + SLASH + stepnum + CONSTRAINTS;
-    std::ofstream constrOut(ppConstrs.c_str());
-    if(!constrOut) {
-      FatalErrno();
-    }
-
-    std::string ppCVM = ppDest + SLASH + stepnum + CONSTRAINT_VAR_MAP;
-    std::ofstream cvmOut(ppCVM.c_str());
-    if(!cvmOut) {
-      FatalErrno();
-    }
-
-    std::string ppInsts = ppDest + SLASH + stepnum + INSTANTS;
-    std::ofstream instsOut(ppInsts.c_str());
-    if(!instsOut) {
-      FatalErrno();
-    }
-
-    std::string ppDecs = ppDest + SLASH + stepnum + DECISIONS;
-    std::ofstream decsOut(ppDecs.c_str());
-    if(!decsOut) {
-      FatalErrno();
-    }
 
-    const ConstraintSet &constraints = ceId->getConstraints();
-    numConstraints = constraints.size();
-    for(ConstraintSet::const_iterator it = constraints.begin(); it != constraints.end(); ++it) {
-      outputConstraint(*it, constrOut, cvmOut);
+    // A delta only looks at the entities reported by the listeners, see writeChanges
+    if(m_keyframe) {
+      const ConstraintSet &constraints = ceId->getConstraints();
+      for(ConstraintSet::const_iterator it = constraints.begin(); it != constraints.end(); ++it) {
+	outputConstraint(*it, constrOut, cvmOut);
+      }
     }
 
-    ObjectSet objects(pdbId->getObjects());
-    TokenSet tokens(pdbId->getTokens());
+    // Objects are few : the slot ids of unchanged timelines are only counted
+    const ObjectSet &objects = pdbId->getObjects();
+    std::set<int> written;
     int slotId = 1000000;
-    for(ObjectSet::iterator objectIterator = objects.begin();
+    for(ObjectSet::const_iterator objectIterator = objects.begin();
 	objectIterator != objects.end(); ++objectIterator) {
       const ObjectId &objId = *objectIterator;
       if(TimelineId::convertable(objId)) {
-	outputObject(objId, O_TIMELINE, objOut, varOut);
+	// Slot ids run across timelines : rewrite the whole timeline when its slots moved
+	if(m_keyframePeriod > 0) {
+	  int &slotBase = m_slotBases[objId->getKey()];
+	  if(slotBase != slotId) {
+	    slotBase = slotId;
+	    m_changed.insert(objId->getKey());
+	  }
+	}
+	if(!changed(objId->getKey())) {
+	  slotId += m_slotCounts[objId->getKey()];
+	  continue;
+	}
+	int firstSlotId = slotId;
+	std::ostream &timelineOut = objOut;
+	outputObject(objId, O_TIMELINE, timelineOut, varOut);
 	TimelineId &tId = (TimelineId &) objId;
 	const std::list<TokenId>& orderedTokens = tId->getTokenSequence();
 	int slotIndex = 0;
@@ -835,16 +838,15 @@ namespace TREX {
 	    tokenIterator != orderedTokens.end(); ++tokenIterator) {
 	  int slotOrder = 0;
 	  const TokenId &token = *tokenIterator;
-	  outputToken(token, T_INTERVAL, slotId, slotIndex, slotOrder, (ObjectId) tId, tokOut,
-		      varOut);
-	  tokens.erase(token);
+	  outputToken(token, T_INTERVAL, slotId, slotIndex, slotOrder, (ObjectId) tId, tokOut, varOut);
+	  written.insert(token->getKey());
 	  TokenSet::const_iterator mergedTokenIterator = 
 	    token->getMergedTokens().begin();
 	  for(;mergedTokenIterator != token->getMergedTokens().end(); ++mergedTokenIterator) {
 	    slotOrder++;
 	    outputToken(*mergedTokenIterator, T_INTERVAL, slotId, slotIndex, slotOrder,
 			(ObjectId &) tId, tokOut, varOut);
-	    tokens.erase(*mergedTokenIterator);
+	    written.insert((*mergedTokenIterator)->getKey());
 	  }
 	  slotId++;
 	  slotIndex++;
@@ -853,7 +855,7 @@ namespace TREX {
 	  if(tokenIterator != orderedTokens.end()) {
 	    const TokenId &nextToken = *tokenIterator;
 	    if(token->end()->lastDomain() != nextToken->start()->lastDomain()) {
-	      objOut << slotId << COMMA << slotIndex << COLON;
+	      timelineOut << slotId << COMMA << slotIndex << COLON;
 	      emptySlots++;
 	      slotId++;
 	      slotIndex++;
@@ -862,8 +864,10 @@ namespace TREX {
 	  --tokenIterator;
 	}
 	if(!emptySlots)
-	  objOut << SNULL;
-	objOut << std::endl;
+	  timelineOut << SNULL;
+	timelineOut << std::endl;
+	if(m_keyframePeriod > 0)
+	  m_slotCounts[objId->getKey()] = slotId - firstSlotId;
       }
 #ifndef NO_RESOURCES
       /* TODO JRB: move this to resource module	  
@@ -898,26 +902,48 @@ namespace TREX {
 	 }
       */	  
 #endif
-      else {
+      else if(changed(objId->getKey())) {
 	outputObject(objId, O_OBJECT, objOut, varOut);
 	/*ExtraData: NULL*/
 	objOut << SNULL << std::endl;
       }
     }
-    for(TokenSet::iterator tokenIterator = tokens.begin(); 
-	tokenIterator != tokens.end(); ++tokenIterator) {
-      TokenId token = *tokenIterator;
-      check_error(token.isValid());
-      outputToken(token, T_INTERVAL, 0, 0, 0, ObjectId::noId(), tokOut, varOut);
-    }
-
 
+    std::set<int> changedRules;
+    if(m_keyframe) {
+      const TokenSet &tokens = pdbId->getTokens();
+      for(TokenSet::const_iterator tokenIterator = tokens.begin(); 
+	  tokenIterator != tokens.end(); ++tokenIterator) {
+	TokenId token = *tokenIterator;
+	check_error(token.isValid());
+	if(written.find(token->getKey()) == written.end())
+	  outputToken(token, T_INTERVAL, 0, 0, 0, ObjectId::noId(), tokOut, varOut);
+      }
+    }
+    else
+      writeChanges(written, changedRules, tokOut, varOut, constrOut, cvmOut);
 
-    std::set<RuleInstanceId> ruleInst = reId->getRuleInstances();
+    // Only the keys of the rule instances are compared between deltas
+    const std::set<RuleInstanceId> &ruleInst = reId->getRuleInstances();
+    std::set<int> ruleInstKeys;
     for(std::set<RuleInstanceId>::const_iterator it = ruleInst.begin();
 	it != ruleInst.end(); ++it) {
       RuleInstanceId ri = *it;
-      outputRuleInstance(ri, ruleInstanceOut, varOut, rismOut);
+      if(m_keyframePeriod > 0) {
+	// Rule instances do not change once fired : only the new ones are written
+	ruleInstKeys.insert(ri->getKey());
+	if(m_ruleInstances.find(ri->getKey()) == m_ruleInstances.end())
+	  m_changed.insert(ri->getKey());
+      }
+      // The local variables of the others may still have changed
+      if(changed(ri->getKey()) || changedRules.find(ri->getKey()) != changedRules.end())
+	outputRuleInstance(ri, select(ri->getKey(), ruleInstanceOut), varOut, 
+			   select(ri->getKey(), rismOut));
+    }
+    if(m_keyframePeriod > 0) {
+      std::set_difference(m_ruleInstances.begin(), m_ruleInstances.end(), ruleInstKeys.begin(), ruleInstKeys.end(),
+			  std::inserter(m_removed, m_removed.end()));
+      m_ruleInstances.swap(ruleInstKeys);
     }
 			
     collectStats(); // this call will overwrite incremental counters for tokens, variables, and constraints
@@ -925,19 +951,243 @@ namespace TREX {
 		<< TAB << numConstraints << std::endl;
     statsOut->flush();
 
-    objOut.close();
-    tokOut.close();
-    ruleInstanceOut.close();
-    rismOut.close();
-    varOut.close();
-    constrOut.close();
-    cvmOut.close();
-    instsOut.close();
-    decsOut.close();
+    if(m_segmentSize > 0)
+      appendStep(tick, attempt, sections);
+    else
+      writeStepFiles(tick, attempt, sections);
+    m_changed.clear();
+    m_removed.clear();
     m_writing = false;
     stepCount++;
   }
 
+  void DbWriter::writeStepFiles(TICK tick, unsigned int attempt, const std::ostringstream sections[]) {
+    // Generate step string
+    std::ostringstream oss;
+    oss<<tick<<"."<<attempt<<"."<<STEP;
+    
+    std::string ppDest = dest + SLASH + oss.str();
+    if(mkdir(ppDest.c_str(), 0777) && errno != EEXIST) {
+      std::cerr << "Failed to create " << ppDest << std::endl;
+      FatalErrno();
+    }
+
+    for(unsigned int i = 0; i < SECTION_COUNT; i++) {
+      std::string fileName = ppDest + SLASH + STEP + SECTION_NAMES[i];
+      std::ofstream out(fileName.c_str());
+      if(!out) {
+	FatalErrno();
+      }
+      out << sections[i].str();
+    }
+  }
+
+  void DbWriter::setBinary(size_t segmentSize) {
+    check_error(!destAlreadyInitialized, "The export format must be set before the first write.");
+    m_segmentSize = segmentSize;
+  }
+
+  void DbWriter::appendStep(TICK tick, unsigned int attempt, const std::ostringstream sections[]) {
+    std::string raw;
+    for(unsigned int i = 0; i < SECTION_COUNT; i++) {
+      std::string section = sections[i].str();
+      uint32_t len = section.length();
+      raw.append(reinterpret_cast<const char *>(&len), sizeof(len));
+      raw += section;
+    }
+    if(!m_keyframe) {
+      uint32_t count = m_removed.size();
+      raw.append(reinterpret_cast<const char *>(&count), sizeof(count));
+      for(std::set<int>::const_iterator it = m_removed.begin(); it != m_removed.end(); ++it) {
+	int32_t key = *it;
+	raw.append(reinterpret_cast<const char *>(&key), sizeof(key));
+      }
+    }
+    std::string block;
+    compress(raw.data(), raw.length(), block);
+
+    StepHeader header;
+    header.size = block.length();
+    header.rawSize = raw.length();
+    header.tick = tick;
+    header.attempt = attempt;
+    header.ppId = ppId;
+    header.flags = (m_keyframe ? STEP_KEYFRAME : 0);
+    header.reserved = 0;
+
+    // Deltas stay in the segment of their keyframe
+    if(!m_stepOut.is_open() || 
+       (m_keyframe && m_segmentBytes > 0 && m_segmentBytes + sizeof(header) + block.length() > m_segmentSize))
+      openSegment();
+
+    m_stepOut.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    m_stepOut.write(block.data(), block.length());
+    // Flush every step : the log has to be readable after a crash
+    m_stepOut.flush();
+    if(!m_stepOut) {
+      FatalErrno();
+    }
+    m_segmentBytes += sizeof(header) + block.length();
+  }
+
+  void DbWriter::setKeyframePeriod(TICK period) {
+    check_error(m_segmentSize > 0, "Deltas are only written to the step log.");
+    m_keyframePeriod = period;
+    if(period > 0 && m_dbChanges == NULL) {
+      m_dbChanges = new DbChanges(pdbId, *this);
+      m_ceChanges = new CeChanges(ceId, *this);
+    }
+  }
+
+  bool DbWriter::changed(int key) const {
+    return m_keyframe || m_changed.find(key) != m_changed.end();
+  }
+
+  std::ostream& DbWriter::select(int key, std::ostream& out) {
+    return changed(key) ? out : m_discard;
+  }
+
+  void DbWriter::writeChanges(const std::set<int>& written, std::set<int>& rules,
+			      std::ostream& tokOut, std::ostream& varOut,
+			      std::ostream& constrOut, std::ostream& cvmOut) {
+    std::set<TokenId> tokens;
+    std::set<ObjectId> objects;
+    for(std::set<int>::const_iterator it = m_changed.begin(); it != m_changed.end(); ++it) {
+      // Removed entities are listed apart, and keys are never reused
+      EntityId entity = Entity::getEntity(*it);
+      if(entity.isNoId() || written.find(*it) != written.end())
+	continue;
+
+      if(ConstraintId::convertable(entity))
+	outputConstraint((ConstraintId) entity, constrOut, cvmOut);
+      else if(TokenId::convertable(entity))
+	tokens.insert((TokenId) entity);
+      else if(ConstrainedVariableId::convertable(entity)) {
+	// A variable is written along with the entity it belongs to
+	EntityId parent = ((ConstrainedVariableId) entity)->parent();
+	if(parent.isNoId() || written.find(parent->getKey()) != written.end() || changed(parent->getKey()))
+	  continue;
+	if(TokenId::convertable(parent))
+	  tokens.insert((TokenId) parent);
+	else if(ObjectId::convertable(parent))
+	  objects.insert((ObjectId) parent);
+	else if(RuleInstanceId::convertable(parent))
+	  rules.insert(parent->getKey());
+      }
+    }
+
+    // Tokens placed on a timeline that did not change only have changed variables to write
+    for(std::set<TokenId>::const_iterator it = tokens.begin(); it != tokens.end(); ++it)
+      outputToken(*it, T_INTERVAL, 0, 0, 0, ObjectId::noId(), select((*it)->getKey(), tokOut), varOut);
+    for(std::set<ObjectId>::const_iterator it = objects.begin(); it != objects.end(); ++it)
+      outputObject(*it, O_OBJECT, m_discard, varOut);
+  }
+
+  void DbWriter::tokenChanged(const TokenId& token) {
+    m_changed.insert(token->getKey());
+    // Its slot or the empty slots of its timeline may have changed
+    const AbstractDomain& objects = token->getObject()->lastDomain();
+    if(objects.isSingleton())
+      m_changed.insert(((ObjectId) objects.getSingletonValue())->getKey());
+  }
+
+  DbWriter::DbChanges::DbChanges(const PlanDatabaseId& db, DbWriter& writer)
+    : PlanDatabaseListener(db), m_writer(writer){}
+
+  void DbWriter::DbChanges::notifyAdded(const ObjectId& object){ m_writer.m_changed.insert(object->getKey()); }
+
+  void DbWriter::DbChanges::notifyRemoved(const ObjectId& object){ m_writer.m_removed.insert(object->getKey()); }
+
+  void DbWriter::DbChanges::notifyAdded(const TokenId& token){ m_writer.tokenChanged(token); }
+
+  void DbWriter::DbChanges::notifyRemoved(const TokenId& token){ 
+    m_writer.tokenChanged(token); 
+    m_writer.m_removed.insert(token->getKey());
+  }
+
+  void DbWriter::DbChanges::notifyActivated(const TokenId& token){ m_writer.tokenChanged(token); }
+
+  void DbWriter::DbChanges::notifyDeactivated(const TokenId& token){ m_writer.tokenChanged(token); }
+
+  void DbWriter::DbChanges::notifyMerged(const TokenId& token){ m_writer.tokenChanged(token); }
+
+  void DbWriter::DbChanges::notifySplit(const TokenId& token){ m_writer.tokenChanged(token); }
+
+  void DbWriter::DbChanges::notifyRejected(const TokenId& token){ m_writer.tokenChanged(token); }
+
+  void DbWriter::DbChanges::notifyReinstated(const TokenId& token){ m_writer.tokenChanged(token); }
+
+  void DbWriter::DbChanges::notifyAdded(const ObjectId& object, const TokenId& token){
+    m_writer.m_changed.insert(object->getKey());
+    m_writer.m_changed.insert(token->getKey());
+  }
+
+  void DbWriter::DbChanges::notifyRemoved(const ObjectId& object, const TokenId& token){
+    m_writer.m_changed.insert(object->getKey());
+    m_writer.m_changed.insert(token->getKey());
+  }
+
+  DbWriter::CeChanges::CeChanges(const ConstraintEngineId& ce, DbWriter& writer)
+    : ConstraintEngineListener(ce), m_writer(writer){}
+
+  void DbWriter::CeChanges::notifyAdded(const ConstraintId& constraint){ m_writer.m_changed.insert(constraint->getKey()); }
+
+  void DbWriter::CeChanges::notifyRemoved(const ConstraintId& constraint){ m_writer.m_removed.insert(constraint->getKey()); }
+
+  void DbWriter::CeChanges::notifyAdded(const ConstrainedVariableId& variable){ m_writer.m_changed.insert(variable->getKey()); }
+
+  void DbWriter::CeChanges::notifyRemoved(const ConstrainedVariableId& variable){ m_writer.m_removed.insert(variable->getKey()); }
+
+  void DbWriter::CeChanges::notifyChanged(const ConstrainedVariableId& variable, const DomainListener::ChangeType& changeType){
+    m_writer.m_changed.insert(variable->getKey());
+
+    // The timing and placement of a token show in the slots of its timeline
+    EntityId parent = variable->parent();
+    if(parent.isNoId() || !TokenId::convertable(parent))
+      return;
+    TokenId token = (TokenId) parent;
+    int key = variable->getKey();
+    if(key == token->getObject()->getKey() || key == token->start()->getKey() || key == token->end()->getKey())
+      m_writer.tokenChanged(token);
+  }
+
+  void DbWriter::openSegment() {
+    if(m_stepOut.is_open())
+      m_stepOut.close();
+
+    // Skip the segments already there, e.g. written before a restart in the same directory
+    std::string name;
+    struct stat st;
+    do {
+      std::ostringstream oss;
+      oss << dest << SLASH << STEP_LOG << "." << m_segment++ << ".bin";
+      name = oss.str();
+    } while(stat(name.c_str(), &st) == 0);
+
+    m_stepOut.open(name.c_str(), std::ios::out | std::ios::binary);
+    if(!m_stepOut) {
+      std::cerr << "Failed to open " << name << std::endl;
+      FatalErrno();
+    }
+    debugMsg("DbWriter:openSegment", "Writing steps to " << name);
+
+    // The section names make the segment self describing for the converter
+    uint32_t val;
+    m_stepOut.write(STEP_LOG_MAGIC, 8);
+    val = STEP_LOG_VERSION;
+    m_stepOut.write(reinterpret_cast<const char *>(&val), sizeof(val));
+    val = sizeof(StepHeader);
+    m_stepOut.write(reinterpret_cast<const char *>(&val), sizeof(val));
+    val = SECTION_COUNT;
+    m_stepOut.write(reinterpret_cast<const char *>(&val), sizeof(val));
+    for(unsigned int i = 0; i < SECTION_COUNT; i++) {
+      val = SECTION_NAMES[i].length();
+      m_stepOut.write(reinterpret_cast<const char *>(&val), sizeof(val));
+      m_stepOut.write(SECTION_NAMES[i].data(), val);
+    }
+    m_segmentBytes = 0;
+  }
+
   void DbWriter::initOutputDestination() {
     debugMsg("DbWriter:initOutputDestination", "Running...");
 
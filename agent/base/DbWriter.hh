@@ -45,12 +45,16 @@
 #include "PlanDatabaseDefs.hh"
 #include "ConstraintEngineDefs.hh"
 #include "RulesEngineDefs.hh"
+#include "PlanDatabaseListener.hh"
+#include "ConstraintEngine.hh"
 #include "XMLUtils.hh"
 
 #include "Agent.hh"
 
+#include <fstream>
 #include <set>
 #include <map>
+#include <sstream>
 #include <vector>
 
 #ifdef ERROR
@@ -73,6 +77,23 @@ namespace TREX {
 
     void addSourcePath(const char* path);
 
+    /**
+     * @brief Append each step as one compressed record of a segmented step log (plans/steps.N.bin)
+     * instead of writing a directory of PlanWorks files. Use the trexplans script to convert it back.
+     * @param segmentSize Size in bytes after which a new segment is started. 0 restores the PlanWorks layout.
+     * @pre No step was written yet.
+     */
+    void setBinary(size_t segmentSize);
+
+    /**
+     * @brief Only record in the step log what changed since the previous step, with a full
+     * keyframe every @e period ticks. Changes are tracked by listening to the database and
+     * the constraint engine.
+     * @param period Ticks between two keyframes. 0 makes every step a keyframe.
+     * @pre setBinary was called with a non zero segment size.
+     */
+    void setKeyframePeriod(TICK period);
+
   protected:
     inline long long int getPPId(void){return ppId;}
     long long int ppId;
@@ -95,28 +116,105 @@ namespace TREX {
     std::ofstream *statsOut, *ruleInstanceOut;
     std::list<std::string> sourcePaths;
 
+    size_t m_segmentSize; /*!< 0 unless writing the step log */
+    unsigned int m_segment; /*!< Index of the next step log segment */
+    size_t m_segmentBytes; /*!< Bytes written in the current segment */
+    std::ofstream m_stepOut;
+
+    /**
+     * @brief Records the keys of tokens and objects changed between two steps
+     */
+    class DbChanges: public PlanDatabaseListener {
+    public:
+      DbChanges(const PlanDatabaseId& db, DbWriter& writer);
+      void notifyAdded(const ObjectId& object);
+      void notifyRemoved(const ObjectId& object);
+      void notifyAdded(const TokenId& token);
+      void notifyRemoved(const TokenId& token);
+      void notifyActivated(const TokenId& token);
+      void notifyDeactivated(const TokenId& token);
+      void notifyMerged(const TokenId& token);
+      void notifySplit(const TokenId& token);
+      void notifyRejected(const TokenId& token);
+      void notifyReinstated(const TokenId& token);
+      void notifyAdded(const ObjectId& object, const TokenId& token);
+      void notifyRemoved(const ObjectId& object, const TokenId& token);
+    private:
+      DbWriter& m_writer;
+    };
+
+    /**
+     * @brief Records the keys of variables and constraints changed between two steps
+     */
+    class CeChanges: public ConstraintEngineListener {
+    public:
+      CeChanges(const ConstraintEngineId& ce, DbWriter& writer);
+      void notifyAdded(const ConstraintId& constraint);
+      void notifyRemoved(const ConstraintId& constraint);
+      void notifyAdded(const ConstrainedVariableId& variable);
+      void notifyRemoved(const ConstrainedVariableId& variable);
+      void notifyChanged(const ConstrainedVariableId& variable, const DomainListener::ChangeType& changeType);
+    private:
+      DbWriter& m_writer;
+    };
+
+    friend class DbChanges;
+    friend class CeChanges;
+
+    TICK m_keyframePeriod; /*!< 0 unless writing deltas */
+    TICK m_lastKeyframe;
+    bool m_keyframe; /*!< True while writing a full step */
+    DbChanges* m_dbChanges;
+    CeChanges* m_ceChanges;
+    std::set<int> m_changed; /*!< Keys of entities added or changed since the last step */
+    std::set<int> m_removed; /*!< Keys of entities removed since the last step */
+    std::set<int> m_ruleInstances; /*!< Keys of the rule instances of the last step */
+    std::map<int, int> m_slotBases; /*!< First slot id of each timeline in the last step */
+    std::map<int, int> m_slotCounts; /*!< Number of slot ids of each timeline in the last step */
+    std::ostream m_discard; /*!< Swallows the output of unchanged entities */
+
+    /**
+     * @brief Where to write an entity.
+     * @return @e out if the current step is a keyframe or the entity changed, m_discard otherwise.
+     */
+    bool changed(int key) const;
+    std::ostream& select(int key, std::ostream& out);
+    void tokenChanged(const TokenId& token);
+    /**
+     * @brief Write the entities changed since the last step, except the timelines and their tokens
+     * which are written as a whole.
+     * @param written Keys of the tokens written with their timeline
+     * @param rules Where the keys of the rule instances with changed variables are added
+     */
+    void writeChanges(const std::set<int>& written, std::set<int>& rules,
+		      std::ostream& tokOut, std::ostream& varOut,
+		      std::ostream& constrOut, std::ostream& cvmOut);
+
     void initOutputDestination();
-    void outputObject(const ObjectId &, const int, std::ofstream &, std::ofstream &);
+    void writeStepFiles(TICK tick, unsigned int attempt, const std::ostringstream sections[]);
+    void appendStep(TICK tick, unsigned int attempt, const std::ostringstream sections[]);
+    void openSegment();
+    void outputObject(const ObjectId &, const int, std::ostream &, std::ostream &);
     void outputToken(const TokenId &, const int, const int, const int, const int, 
-		     const ObjectId &, std::ofstream &, std::ofstream &);
+		     const ObjectId &, std::ostream &, std::ostream &);
     void outputStateVar(const Id<TokenVariable<StateDomain> >&, const int, const int,
-			std::ofstream &varOut);
+			std::ostream &varOut);
     void outputEnumVar(const Id< TokenVariable<EnumeratedDomain> > &, const int,
-		       const int, std::ofstream &);
+		       const int, std::ostream &);
     void outputIntVar(const Id< TokenVariable<IntervalDomain> > &, const int,
-		      const int, std::ofstream &);
+		      const int, std::ostream &);
     void outputIntIntVar(const Id< TokenVariable<IntervalIntDomain> >&, const int,
-			 const int, std::ofstream &);
+			 const int, std::ostream &);
     void outputObjVar(const ObjectVarId &, const int, const int,
-		      std::ofstream &);
+		      std::ostream &);
     void outputConstrVar(const ConstrainedVariableId &, const int, const int, 
-			 std::ofstream &);
-    void outputConstraint(const ConstraintId &, std::ofstream &, std::ofstream &);
+			 std::ostream &);
+    void outputConstraint(const ConstraintId &, std::ostream &, std::ostream &);
 #ifndef NO_RESOURCES
     // TODO JRB: Move this to Resource module 
-    //void outputInstant(const InstantId &, const int, std::ofstream &);
+    //void outputInstant(const InstantId &, const int, std::ostream &);
 #endif
-    void outputRuleInstance(const RuleInstanceId &, std::ofstream &, std::ofstream & , std::ofstream &);
+    void outputRuleInstance(const RuleInstanceId &, std::ostream &, std::ostream & , std::ostream &);
     void buildSlaveAndVarSets(std::set<TokenId> &, std::set<ConstrainedVariableId> &, 
 			      const RuleInstanceId &);
     void writeStats(void);
@@ -0,0 +1,108 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+* 
+*  Copyright (c) 2007. MBARI.
+*  All rights reserved.
+* 
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+* 
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the TREX Project nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+* 
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*/
+/* -*- C++ -*-
+ * $Id$
+ */
+/** @file "DebugStream.cc"
+ * @brief DebugStream implementation
+ */
+#include "DebugStream.hh"
+
+#include "Debug.hh"
+
+#include <streambuf>
+
+using namespace TREX;
+
+/*
+ * class TREX::DebugStream::Router
+ */
+
+class DebugStream::Router: public std::streambuf {
+protected:
+  int overflow(int c) {
+    if( traits_type::eq_int_type(c, traits_type::eof()) )
+      return traits_type::not_eof(c);
+    return target()->sputc(traits_type::to_char_type(c));
+  }
+  std::streamsize xsputn(char const *s, std::streamsize n) {
+    return target()->sputn(s, n);
+  }
+  int sync() {
+    return target()->pubsync();
+  }
+
+private:
+  std::streambuf *target() const {
+    return current().rdbuf();
+  }
+}; // TREX::DebugStream::Router
+
+/*
+ * class TREX::DebugStream
+ */
+
+// statics
+
+std::ostream *DebugStream::s_default = NULL;
+__thread std::ostream *DebugStream::s_selected = NULL;
+
+std::ostream &DebugStream::router() {
+  static Router sl_buf;
+  static struct Install {
+    std::ostream stream;
+
+    Install():stream(&sl_buf) {
+      s_default = &EUROPA::DebugMessage::getStream();
+      EUROPA::DebugMessage::setStream(stream);
+    }
+  } sl_install;
+
+  return sl_install.stream;
+}
+
+void DebugStream::select(std::ostream &out) {
+  // Selecting the router itself would loop: fall back to the default
+  s_selected = (&out==&router() ? NULL : &out);
+}
+
+void DebugStream::setDefault(std::ostream &out) {
+  if( &out!=&router() )
+    s_default = &out;
+}
+
+std::ostream &DebugStream::current() {
+  router();
+  return NULL==s_selected ? *s_default : *s_selected;
+}
@@ -0,0 +1,84 @@
+/* -*- C++ -*-
+ * $Id$
+ */
+/** @file "DebugStream.hh"
+ * @brief Per thread redirection of the EUROPA debug output
+ */
+#ifndef _DEBUGSTREAM_HH
+#define _DEBUGSTREAM_HH
+
+/*********************************************************************
+* Software License Agreement (BSD License)
+* 
+*  Copyright (c) 2007. MBARI.
+*  All rights reserved.
+* 
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+* 
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the TREX Project nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+* 
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <ostream>
+
+namespace TREX {
+
+  /** @brief Debug output router
+   *
+   * EUROPA writes its debug messages to a single process wide stream
+   * (DebugMessage::getStream). Reactors used to swap this stream for
+   * their own on every call, which is a race as soon as two reactors
+   * run on different threads.
+   *
+   * Instead, this class installs once a stream that forwards every
+   * character to the stream selected by the calling thread. Selecting a
+   * stream is then a thread local store and does not change any shared
+   * state.
+   *
+   * @note The installed stream itself is shared: its formatting flags
+   * are not protected, so concurrent reactors should not enable
+   * EUROPA debug messages that rely on them.
+   */
+  class DebugStream {
+  public:
+    /** @brief Send the debug output of the calling thread to @e out */
+    static void select(std::ostream &out);
+    /** @brief Output of the threads that did not select a stream */
+    static void setDefault(std::ostream &out);
+    /** @brief The stream currently used by the calling thread */
+    static std::ostream &current();
+
+  private:
+    class Router;
+
+    static std::ostream &router();
+
+    static std::ostream *s_default;
+    static __thread std::ostream *s_selected;
+  }; // TREX::DebugStream
+
+} // TREX
+
+#endif // _DEBUGSTREAM_HH
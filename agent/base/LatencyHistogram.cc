@@ -0,0 +1,174 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+* 
+*  Copyright (c) 2007. MBARI.
+*  All rights reserved.
+* 
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+* 
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the TREX Project nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+* 
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* -*- C++ -*-
+ * $Id$
+ */
+/** @file "LatencyHistogram.cc"
+ */
+#include <algorithm>
+#include <iomanip>
+
+#include "LatencyHistogram.hh"
+
+using namespace TREX;
+
+namespace {
+  // Values below SUB_BUCKETS are exact. Above, each power of 2 is split
+  // into HALF_SUB_BUCKETS buckets.
+  unsigned const SUB_BITS = 7;
+  uint64_t const SUB_BUCKETS = 1ull<<SUB_BITS;
+  uint64_t const HALF_SUB_BUCKETS = SUB_BUCKETS>>1;
+  unsigned const MAX_BITS = 40;
+  uint64_t const MAX_VALUE = (1ull<<MAX_BITS)-1;
+  size_t const N_BUCKETS = (MAX_BITS-SUB_BITS)*HALF_SUB_BUCKETS+SUB_BUCKETS;
+}
+
+/*
+ * class LatencyHistogram
+ */
+
+// statics :
+
+uint64_t LatencyHistogram::now() {
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<uint64_t>(ts.tv_sec)*1000000000ull+ts.tv_nsec;
+}
+
+size_t LatencyHistogram::index(uint64_t nsec) {
+  if( nsec<SUB_BUCKETS )
+    return nsec;
+  if( nsec>MAX_VALUE )
+    nsec = MAX_VALUE;
+
+  unsigned shift = 0;
+  for(uint64_t v=nsec>>SUB_BITS; v!=0; v >>= 1)
+    ++shift;
+  // nsec>>shift is in [HALF_SUB_BUCKETS, SUB_BUCKETS)
+  return shift*HALF_SUB_BUCKETS+(nsec>>shift);
+}
+
+uint64_t LatencyHistogram::highestEquivalent(size_t index) {
+  if( index<SUB_BUCKETS )
+    return index;
+  unsigned shift = index/HALF_SUB_BUCKETS-1;
+  uint64_t sub = index-shift*HALF_SUB_BUCKETS;
+  return ((sub+1)<<shift)-1;
+}
+
+void LatencyHistogram::printHeader(std::ostream &out) {
+  out<<"count\tmin\tp50\tp90\tp99\tp99.9\tmax";
+}
+
+// structors :
+
+LatencyHistogram::LatencyHistogram(std::string const &name)
+  :m_name(name), m_buckets(N_BUCKETS, 0) {
+  reset();
+}
+
+// Manipulators :
+
+void LatencyHistogram::record(uint64_t nsec) {
+  ++m_buckets[index(nsec)];
+  ++m_count;
+  if( nsec<m_min )
+    m_min = nsec;
+  if( nsec>m_max )
+    m_max = nsec;
+}
+
+void LatencyHistogram::add(LatencyHistogram const &other) {
+  if( 0==other.m_count )
+    return;
+  for(size_t i=0; i<N_BUCKETS; ++i)
+    m_buckets[i] += other.m_buckets[i];
+  m_count += other.m_count;
+  if( other.m_min<m_min )
+    m_min = other.m_min;
+  if( other.m_max>m_max )
+    m_max = other.m_max;
+}
+
+void LatencyHistogram::reset() {
+  std::fill(m_buckets.begin(), m_buckets.end(), 0);
+  m_count = 0;
+  m_min = MAX_VALUE;
+  m_max = 0;
+}
+
+// Observers :
+
+uint64_t LatencyHistogram::min() const {
+  return 0==m_count ? 0 : m_min;
+}
+
+uint64_t LatencyHistogram::percentile(double q) const {
+  if( 0==m_count )
+    return 0;
+
+  uint64_t target = static_cast<uint64_t>(q*m_count+0.5);
+  if( target<1 )
+    target = 1;
+  if( target>m_count )
+    target = m_count;
+
+  uint64_t seen = 0;
+  for(size_t i=0; i<N_BUCKETS; ++i) {
+    seen += m_buckets[i];
+    if( seen>=target ) {
+      uint64_t val = highestEquivalent(i);
+      return val>m_max ? m_max : val;
+    }
+  }
+  return m_max;
+}
+
+void LatencyHistogram::print(std::ostream &out) const {
+  double const usec = 1e-3;
+  std::ios_base::fmtflags flags = out.flags();
+  std::streamsize precision = out.precision();
+  
+  out<<m_count<<std::fixed<<std::setprecision(1)
+     <<'\t'<<min()*usec
+     <<'\t'<<percentile(0.5)*usec
+     <<'\t'<<percentile(0.9)*usec
+     <<'\t'<<percentile(0.99)*usec
+     <<'\t'<<percentile(0.999)*usec
+     <<'\t'<<max()*usec;
+  // Leave the format of the log as it was
+  out.flags(flags);
+  out.precision(precision);
+}
@@ -0,0 +1,136 @@
+/* -*- C++ -*-
+ * $Id$
+ */
+/** @file "LatencyHistogram.hh"
+ * @brief Log-linear latency histograms for reactor phases
+ */
+#ifndef _LATENCYHISTOGRAM_HH
+#define _LATENCYHISTOGRAM_HH
+
+
+/*********************************************************************
+* Software License Agreement (BSD License)
+* 
+*  Copyright (c) 2007. MBARI.
+*  All rights reserved.
+* 
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+* 
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the TREX Project nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+* 
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <string>
+#include <vector>
+#include <ostream>
+
+#include <stdint.h>
+#include <time.h>
+
+namespace TREX {
+
+  /** @brief Latency histogram.
+   *
+   * This class records durations in nanoseconds in buckets whose width
+   * grows with the value, in the manner of an HDR histogram: values are
+   * exact below 128ns and kept with 7 significant bits (less than 1%
+   * error) above. Recording is a few shifts and an increment, and the
+   * memory used is fixed whatever the number of samples.
+   *
+   * Values above about 18 minutes are clamped.
+   */
+  class LatencyHistogram {
+  public:
+    /** @brief Constructor
+     * @param name Name of the measured phase
+     */
+    explicit LatencyHistogram(std::string const &name);
+    ~LatencyHistogram() {}
+
+    std::string const &name() const {
+      return m_name;
+    }
+
+    void record(uint64_t nsec);
+    /** @brief Add all the samples of @e other */
+    void add(LatencyHistogram const &other);
+    void reset();
+
+    uint64_t count() const {
+      return m_count;
+    }
+    uint64_t min() const;
+    uint64_t max() const {
+      return m_max;
+    }
+    /** @brief Percentile
+     *
+     * @param q The quantile in [0, 1]
+     *
+     * @return The smallest value such that at least @e q of the samples
+     * are not greater, rounded up to the bucket bound. 0 if empty.
+     */
+    uint64_t percentile(double q) const;
+
+    /** @brief Columns written by print */
+    static void printHeader(std::ostream &out);
+    /** @brief Print count, min, p50, p90, p99, p99.9 and max in microseconds */
+    void print(std::ostream &out) const;
+
+    /** @brief Current CLOCK_MONOTONIC date in nanoseconds */
+    static uint64_t now();
+
+  private:
+    static size_t index(uint64_t nsec);
+    static uint64_t highestEquivalent(size_t index);
+
+    std::string m_name;
+    std::vector<uint64_t> m_buckets;
+    uint64_t m_count;
+    uint64_t m_min, m_max;
+  }; // TREX::LatencyHistogram
+
+  /** @brief Latency measurement
+   *
+   * Records in the histogram given at construction the time elapsed
+   * between construction and destruction of this instance.
+   *
+   * @sa RStatLap
+   */
+  class LatencyLap {
+  public:
+    LatencyLap(LatencyHistogram &out)
+      :m_out(out), m_start(LatencyHistogram::now()) {}
+    ~LatencyLap() {
+      m_out.record(LatencyHistogram::now()-m_start);
+    }
+  private:
+    LatencyHistogram &m_out;
+    uint64_t const m_start;
+  }; // TREX::LatencyLap
+
+} // TREX
+
+#endif // _LATENCYHISTOGRAM_HH
@@ -51,6 +51,7 @@
 
 #include "TREXDefs.hh"
 #include "LogManager.hh"
+#include "DebugStream.hh"
 
 #include "MutexWrapper.hh"
 #include "Guardian.hh"
@@ -63,6 +64,7 @@ using namespace TREX;
 // statics :
 
 std::auto_ptr<LogManager> LogManager::s_instance(0);
+__thread LogManager *LogManager::s_current = NULL;
 
 std::string LogManager::short_name(std::string const &file_name) {
   size_t slash = file_name.find_last_of('/');
@@ -75,17 +77,21 @@ std::string LogManager::short_name(std::string const &file_name) {
 LogManager &LogManager::instance() {
   static Mutex sl_mutex;
 
+  if( NULL!=s_current )
+    return *s_current;
   if( 0==s_instance.get() ) {
     Guardian<Mutex> guard(sl_mutex);
-    if( 0==s_instance.get() ) // double check in case another process did create it
+    if( 0==s_instance.get() ) { // double check in case another process did create it
       s_instance.reset(new LogManager);
+      DebugStream::setDefault(s_instance->m_debug);
+    }
   }
   return *s_instance;
 }
 
 // structors :
 
-LogManager::LogManager() {
+LogManager::LogManager(bool linkLatest) {
   char *base_dir = getenv("TREX_LOG_DIR");
   char dated_dir[17];
 
@@ -124,8 +130,10 @@ LogManager::LogManager() {
       iss>>last;
     }
 
-    debugMsg("LogManager", "Unlinking latest directory");
-    unlink(latest.c_str());
+    if( linkLatest ) {
+      debugMsg("LogManager", "Unlinking latest directory");
+      unlink(latest.c_str());
+    }
   }
 
   delete[] buf;
@@ -141,13 +149,12 @@ LogManager::LogManager() {
     // Create the "latest" symbolic link. As it is not  "critical" I am not checking it. 
     // Normally the unlink as already been done 
     //       unlink(latest.c_str());
-    symlink(m_path.c_str(), latest.c_str());
+    if( linkLatest )
+      symlink(m_path.c_str(), latest.c_str());
 
     m_syslog.open(file_name(TREX_LOG_FILE).c_str());
     m_debug.open(file_name(TREX_DBG_FILE).c_str());
 
-    DebugMessage::setStream(m_debug);
-
     debugMsg("LogManager", " logging directory is \""<<m_path<<'\"');
     return;
   }
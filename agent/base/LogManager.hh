@@ -81,7 +81,8 @@ namespace TREX {
      *
      * This method manages the creation of the singleton.
      *
-     * @return The singleton instance.
+     * @return The log manager of the current agent of the calling
+     * thread if it has its own, the singleton instance otherwise.
      *
      * @note This method offers :
      * @li Thread safety in the sense that we ensure
@@ -90,6 +91,12 @@ namespace TREX {
      * ensuring its destruction at the send of the program.
      */
     static LogManager &instance();
+    /** @brief Log manager of the current agent of the calling thread
+     *
+     * Set by Agent for the agents created after the first one, which
+     * log to their own directory. NULL refers to the singleton.
+     */
+    static __thread LogManager *s_current;
 
     /** @brief Log path.
      *
@@ -181,8 +188,12 @@ namespace TREX {
     std::string m_path;
     
     /** @brief Constructor.
+     *
+     * @param linkLatest Whether the "latest" link should point to the new
+     * directory. Only the singleton does it, so that the link keeps
+     * pointing to the logs of the first agent.
      */
-    LogManager();
+    explicit LogManager(bool linkLatest = true);
     /** @brief Destructor.
      */
     ~LogManager();
@@ -205,6 +216,7 @@ namespace TREX {
     TextLog m_syslog;
 
     friend class std::auto_ptr<LogManager>;
+    friend class Agent;
     
     /** @brief Singleton
      */
@@ -222,11 +234,17 @@ namespace TREX {
 /** @brief System logginf macro.
  *
  * This macro is an helper to put a system log message.
- *
- * @param id An identifer which will be put at the start of the entry.
+ * The operands of the entry are not evaluated at all when the syslog is
+ * disabled. It must be used as a full statement :
+ * @code
+ * TREXLog() << "text" << value << std::endl;
+ * @endcode
+ * It expands to a loop run at most once rather than an if, so that it can be the
+ * unbraced body of an if statement followed by an else.
  *
  * @sa TREX::LogManager::syslog()
+ * @sa TREX::TextLog::isEnabled()
  */
-# define TREXLog() TREX::LogManager::instance().syslog()
+# define TREXLog() for(bool trex_log_pending = TREX::LogManager::instance().syslog().isEnabled(); trex_log_pending; trex_log_pending = false) TREX::LogManager::instance().syslog()
 
 #endif // _LOGMANAGER_HH
@@ -0,0 +1,435 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+* 
+*  Copyright (c) 2007. MBARI.
+*  All rights reserved.
+* 
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+* 
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the TREX Project nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+* 
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* -*- C++ -*-
+ * $Id$
+ */
+/** @file "ObservationBus.cc"
+ */
+#include <cstring>
+
+#include <cerrno>
+#include <csignal>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "Token.hh"
+#include "TokenVariable.hh"
+#include "Object.hh"
+
+#include "ErrnoExcept.hh"
+#include "LogManager.hh"
+#include "ObservationBus.hh"
+#include "ObservationCodec.hh"
+
+using namespace TREX;
+
+namespace {
+
+  char const BUS_MAGIC[8] = {'T', 'R', 'X', 'B', 'U', 'S', 0, 0};
+  uint32_t const BUS_VERSION = 2;
+  size_t const HEADER_SIZE = 64;
+  /** @brief Size of the size and kind of a record. A PAD record has nothing else */
+  uint64_t const PAD_HEADER = 8;
+  uint64_t const RECORD_HEADER = 12;
+  uint64_t const MIN_CAPACITY = 4096;
+  uint64_t const MAX_CAPACITY = uint64_t(1)<<31;
+
+  struct BusHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t capacity;
+    uint64_t volatile head;
+    uint64_t volatile tail;
+    int32_t writer; //!< Process id of the agent publishing
+  };
+
+  inline uint64_t align(uint64_t size) {
+    return (size+7)&~uint64_t(7);
+  }
+
+  template<typename Ty>
+  void put(std::string &out, Ty val) {
+    out.append(reinterpret_cast<char const *>(&val), sizeof(val));
+  }
+
+  void putStr(std::string &out, std::string const &str) {
+    uint16_t const len = str.length()>0xffff ? 0xffff : str.length();
+
+    put(out, len);
+    out.append(str.data(), len);
+  }
+
+  void putValue(std::string &out, AbstractDomain const &dom) {
+    if( !dom.isEmpty() && !dom.isEntity() ) {
+      if( dom.getDataType()->isBool() ) {
+	put<uint8_t>(out, ObservationEncoder::BOOL);
+	put<uint8_t>(out, dom.isSingleton() ? (0.0!=dom.getSingletonValue()) : 2);
+	return;
+      } else if( dom.getDataType()->isNumeric() ) {
+	if( dom.isInterval() || dom.isSingleton() ) {
+	  put<uint8_t>(out, dom.getDataType()->minDelta()<1.0 ? ObservationEncoder::FLOAT : ObservationEncoder::INT);
+	  put<double>(out, dom.getLowerBound());
+	  put<double>(out, dom.getUpperBound());
+	  return;
+	}
+      } else if( dom.isSingleton() ) {
+	put<uint8_t>(out, dom.getDataType()->isString() ? ObservationEncoder::STRING : ObservationEncoder::SYMBOL);
+	putStr(out, LabelStr(dom.getSingletonValue()).toString());
+	return;
+      }
+    }
+    // Whatever has no binary form is given as text
+    put<uint8_t>(out, ObservationEncoder::STRING);
+    putStr(out, dom.toString());
+  }
+
+  /** @brief Whether the bus @e name exists and the agent that publishes it is still running */
+  bool isLive(std::string const &name) {
+    int fd = shm_open(name.c_str(), O_RDONLY, 0);
+
+    if( fd<0 )
+      return false;
+    BusHeader header;
+    bool const live = pread(fd, &header, sizeof(header), 0)==static_cast<ssize_t>(sizeof(header))
+      && 0==memcmp(header.magic, BUS_MAGIC, sizeof(BUS_MAGIC)) && header.writer>0
+      && (0==kill(header.writer, 0) || EPERM==errno);
+    close(fd);
+    return live;
+  }
+
+  void putBounds(std::string &out, TokenId const &token) {
+    put<double>(out, token->start()->lastDomain().getLowerBound());
+    put<double>(out, token->start()->lastDomain().getUpperBound());
+    put<double>(out, token->end()->lastDomain().getLowerBound());
+    put<double>(out, token->end()->lastDomain().getUpperBound());
+  }
+
+}
+
+/*
+ * class TREX::ObservationBus
+ */
+
+// structors :
+
+ObservationBus::ObservationBus(std::string const &name, size_t capacity)
+  :m_name(name), m_size(0), m_base(NULL), m_capacity(MIN_CAPACITY), 
+   m_planTick(0), m_dropped(0) {
+  while( m_capacity<capacity && m_capacity<MAX_CAPACITY )
+    m_capacity <<= 1;
+  m_size = HEADER_SIZE+m_capacity;
+
+  // Start from a new object : readers of a previous run keep the old one.
+  // The bus of an agent still running is left to it.
+  if( isLive(m_name) )
+    throw ErrnoExcept("ObservationBus "+m_name, "already published by a running agent");
+  shm_unlink(m_name.c_str());
+  int fd = shm_open(m_name.c_str(), O_CREAT|O_EXCL|O_RDWR, 0644);
+  if( fd<0 )
+    throw ErrnoExcept("ObservationBus "+m_name);
+  void *addr = MAP_FAILED;
+  if( ftruncate(fd, m_size)==0 )
+    addr = mmap(NULL, m_size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+  if( MAP_FAILED==addr ) {
+    ErrnoExcept error("ObservationBus "+m_name);
+    close(fd);
+    shm_unlink(m_name.c_str());
+    throw error;
+  }
+  close(fd);
+  m_base = static_cast<char *>(addr);
+
+  BusHeader *header = reinterpret_cast<BusHeader *>(m_base);
+  header->version = BUS_VERSION;
+  header->capacity = m_capacity;
+  header->head = 0;
+  header->tail = 0;
+  header->writer = getpid();
+  // The magic comes last so that readers never see a partial header
+  __sync_synchronize();
+  memcpy(header->magic, BUS_MAGIC, sizeof(BUS_MAGIC));
+}
+
+ObservationBus::~ObservationBus() {
+  munmap(m_base, m_size);
+  shm_unlink(m_name.c_str());
+}
+
+// Manipulators :
+
+void ObservationBus::reclaim(uint64_t end) {
+  BusHeader *header = reinterpret_cast<BusHeader *>(m_base);
+  char const *ring = m_base+HEADER_SIZE;
+  uint64_t tail = header->tail;
+
+  if( tail+m_capacity>=end )
+    return;
+  while( tail+m_capacity<end ) {
+    uint32_t size;
+    memcpy(&size, ring+(tail&(m_capacity-1)), sizeof(size));
+    tail += size;
+  }
+  // Readers have to know that these records are lost before they are overwritten
+  header->tail = tail;
+  __sync_synchronize();
+}
+
+void ObservationBus::write(RecordKind kind, TICK tick, std::string const &payload) {
+  uint64_t const size = align(RECORD_HEADER+payload.size());
+
+  if( size>m_capacity/2 ) {
+    if( 0==m_dropped++ )
+      TREXLog()<<"[bus] Dropped a record of "<<size<<" bytes from "<<m_name
+	       <<": records are limited to half the capacity of "<<m_capacity<<" bytes."
+	       <<" Later drops are counted in bus.dropped"<<std::endl;
+    return;
+  }
+
+  BusHeader *header = reinterpret_cast<BusHeader *>(m_base);
+  char *ring = m_base+HEADER_SIZE;
+  uint64_t pos = header->head, offset = pos&(m_capacity-1);
+  uint32_t const size32 = size;
+  uint16_t const kind16 = kind, zero = 0;
+  int32_t const tick32 = tick;
+
+  if( offset+size>m_capacity ) {
+    // Records do not wrap : fill the end of the ring
+    uint32_t const pad = m_capacity-offset;
+    uint16_t const padKind = PAD;
+
+    reclaim(pos+pad);
+    memcpy(ring+offset, &pad, sizeof(pad));
+    memcpy(ring+offset+4, &padKind, sizeof(padKind));
+    memcpy(ring+offset+6, &zero, sizeof(zero));
+    pos += pad;
+    offset = 0;
+  }
+  reclaim(pos+size);
+  memcpy(ring+offset, &size32, sizeof(size32));
+  memcpy(ring+offset+4, &kind16, sizeof(kind16));
+  memcpy(ring+offset+6, &zero, sizeof(zero));
+  memcpy(ring+offset+8, &tick32, sizeof(tick32));
+  memcpy(ring+offset+RECORD_HEADER, payload.data(), payload.size());
+  __sync_synchronize();
+  header->head = pos+size;
+}
+
+void ObservationBus::publish(TICK tick, Observation const &obs) {
+  unsigned int const count = obs.countParameters();
+
+  m_payload.clear();
+  putStr(m_payload, obs.getObjectName().toString());
+  putStr(m_payload, obs.getPredicate().toString());
+  put<uint16_t>(m_payload, count);
+  for(unsigned int i=0; i<count; ++i) {
+    std::pair<LabelStr, AbstractDomain const *> const param = obs[i];
+
+    putStr(m_payload, param.first.toString());
+    putValue(m_payload, *(param.second));
+  }
+  write(OBSERVATION, tick, m_payload);
+}
+
+void ObservationBus::publish(TICK tick, RecordKind kind, TokenId const &goal) {
+  AbstractDomain const &objects = goal->getObject()->lastDomain();
+
+  m_payload.clear();
+  if( objects.isSingleton() ) {
+    ObjectId object = (ObjectId) objects.getSingletonValue();
+    putStr(m_payload, object->getName().toString());
+  } else
+    putStr(m_payload, std::string());
+  putStr(m_payload, goal->getPredicateName().toString());
+  putBounds(m_payload, goal);
+  write(kind, tick, m_payload);
+}
+
+void ObservationBus::beginPlan(TICK tick, LabelStr const &reactor, unsigned int nTimelines) {
+  m_payload.clear();
+  m_planTick = tick;
+  putStr(m_payload, reactor.toString());
+  put<uint32_t>(m_payload, nTimelines);
+}
+
+void ObservationBus::addTimeline(LabelStr const &timeline, unsigned int nTokens) {
+  putStr(m_payload, timeline.toString());
+  put<uint32_t>(m_payload, nTokens);
+}
+
+void ObservationBus::addToken(TokenId const &token) {
+  putStr(m_payload, token->getPredicateName().toString());
+  putBounds(m_payload, token);
+}
+
+void ObservationBus::endPlan() {
+  write(PLAN, m_planTick, m_payload);
+}
+
+/*
+ * class TREX::BusRecord::Cursor
+ */
+
+void BusRecord::Cursor::get(void *val, size_t size) {
+  if( static_cast<size_t>(m_end-m_data)<size )
+    throw ErrnoExcept("BusRecord", "truncated payload");
+  memcpy(val, m_data, size);
+  m_data += size;
+}
+
+uint8_t BusRecord::Cursor::u8() {
+  uint8_t val;
+  get(&val, sizeof(val));
+  return val;
+}
+
+uint16_t BusRecord::Cursor::u16() {
+  uint16_t val;
+  get(&val, sizeof(val));
+  return val;
+}
+
+uint32_t BusRecord::Cursor::u32() {
+  uint32_t val;
+  get(&val, sizeof(val));
+  return val;
+}
+
+double BusRecord::Cursor::f64() {
+  double val;
+  get(&val, sizeof(val));
+  return val;
+}
+
+std::string BusRecord::Cursor::str() {
+  uint16_t const len = u16();
+  if( static_cast<size_t>(m_end-m_data)<len )
+    throw ErrnoExcept("BusRecord", "truncated payload");
+  std::string ret(m_data, len);
+  m_data += len;
+  return ret;
+}
+
+/*
+ * class TREX::ObservationBusReader
+ */
+
+// structors :
+
+ObservationBusReader::ObservationBusReader(std::string const &name, bool fromStart)
+  :m_size(0), m_base(NULL), m_capacity(0), m_pos(0), m_lost(0) {
+  int fd = shm_open(name.c_str(), O_RDONLY, 0);
+  if( fd<0 )
+    throw ErrnoExcept("ObservationBusReader "+name);
+
+  struct stat st;
+  void *addr = MAP_FAILED;
+  if( fstat(fd, &st)==0 && static_cast<size_t>(st.st_size)>=HEADER_SIZE ) {
+    m_size = st.st_size;
+    addr = mmap(NULL, m_size, PROT_READ, MAP_SHARED, fd, 0);
+  }
+  if( MAP_FAILED==addr ) {
+    ErrnoExcept error("ObservationBusReader "+name);
+    close(fd);
+    throw error;
+  }
+  close(fd);
+  m_base = static_cast<char const *>(addr);
+
+  BusHeader const *header = reinterpret_cast<BusHeader const *>(m_base);
+  if( memcmp(header->magic, BUS_MAGIC, sizeof(BUS_MAGIC))!=0 || BUS_VERSION!=header->version
+      || HEADER_SIZE+header->capacity>m_size ) {
+    munmap(const_cast<char *>(m_base), m_size);
+    throw ErrnoExcept("ObservationBusReader "+name, "not an observation bus");
+  }
+  __sync_synchronize();
+  m_capacity = header->capacity;
+  m_pos = fromStart ? header->tail : header->head;
+}
+
+ObservationBusReader::~ObservationBusReader() {
+  munmap(const_cast<char *>(m_base), m_size);
+}
+
+// Manipulators :
+
+bool ObservationBusReader::next(BusRecord &record) {
+  BusHeader const *header = reinterpret_cast<BusHeader const *>(m_base);
+  char const *ring = m_base+HEADER_SIZE;
+
+  while( true ) {
+    uint64_t const head = header->head;
+    __sync_synchronize();
+    if( m_pos>=head )
+      return false;
+
+    uint64_t tail = header->tail;
+    if( m_pos<tail ) {
+      m_lost += tail-m_pos;
+      m_pos = tail;
+      continue;
+    }
+
+    uint64_t const offset = m_pos&(m_capacity-1);
+    uint32_t size;
+    uint16_t kind;
+    int32_t tick = 0;
+
+    memcpy(&size, ring+offset, sizeof(size));
+    memcpy(&kind, ring+offset+4, sizeof(kind));
+    bool const valid = size>=PAD_HEADER && 0==(size&7) && offset+size<=m_capacity
+      && (ObservationBus::PAD==kind || size>=RECORD_HEADER);
+    if( valid && ObservationBus::PAD!=kind ) {
+      memcpy(&tick, ring+offset+8, sizeof(tick));
+      record.payload.assign(ring+offset+RECORD_HEADER, size-RECORD_HEADER);
+    }
+    // Check that the producer did not overwrite what was just copied
+    __sync_synchronize();
+    tail = header->tail;
+    if( m_pos<tail )
+      continue;
+    if( !valid )
+      throw ErrnoExcept("ObservationBusReader", "corrupted record");
+
+    m_pos += size;
+    if( ObservationBus::PAD!=kind ) {
+      record.kind = static_cast<ObservationBus::RecordKind>(kind);
+      record.tick = tick;
+      return true;
+    }
+  }
+}
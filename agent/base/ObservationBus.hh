@@ -0,0 +1,240 @@
+/* -*- C++ -*-
+ * $Id$
+ */
+/** @file "ObservationBus.hh"
+ * @brief Publication of the agent activity in shared memory.
+ */
+#ifndef _OBSERVATIONBUS_HH
+#define _OBSERVATIONBUS_HH
+
+/*********************************************************************
+* Software License Agreement (BSD License)
+* 
+*  Copyright (c) 2007. MBARI.
+*  All rights reserved.
+* 
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+* 
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the TREX Project nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+* 
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <string>
+
+#include <stdint.h>
+
+#include "TREXDefs.hh"
+#include "Observer.hh"
+
+namespace TREX {
+
+  /** @brief Observation bus
+   *
+   * The bus is a ring buffer in POSIX shared memory where the agent
+   * publishes observations, dispatched goals and a summary of the plan of
+   * each deliberative reactor at every tick. Any number of monitors can
+   * read it with ObservationBusReader or the python TREX.io.bus_reader,
+   * without locks and without the agent touching the disk. The agent
+   * never waits for readers : a reader too slow to keep up loses the
+   * oldest records.
+   *
+   * The shared memory object starts with a 64 bytes header
+   * @code
+   * offset 0  char[8] magic "TRXBUS\0\0"
+   * offset 8  u32     version
+   * offset 12 u32     capacity of the ring in bytes, a power of 2
+   * offset 16 u64     head : end of the last record published
+   * offset 24 u64     tail : start of the oldest record not overwritten
+   * offset 32 i32     process id of the agent publishing
+   * @endcode
+   * followed by the ring. @e head and @e tail only grow, a position
+   * @e p is at offset 64+(p%capacity) in the object. Records are 8 bytes
+   * aligned and never wrap around the end of the ring :
+   * @code
+   * record      : u32 size u16 kind u16 0 i32 tick payload  (size includes the 12 bytes header and padding)
+   * PAD         : no payload, fills the end of the ring
+   * OBSERVATION : str timeline str predicate u16 count (str name value)[count]
+   * REQUEST     : str timeline str predicate f64 start_lb f64 start_ub f64 end_lb f64 end_ub
+   * RECALL      : same as REQUEST
+   * PLAN        : str reactor u32 count timeline[count]
+   * timeline    : str name u32 count (str predicate f64 start_lb f64 start_ub f64 end_lb f64 end_ub)[count]
+   * str         : u16 length char[length]
+   * value       : u8 type then u8 for BOOL, f64 lb f64 ub for INT and FLOAT, str for STRING and SYMBOL
+   * @endcode
+   * The value types are the ones of ObservationEncoder. Numbers are in the
+   * byte order of the host.
+   *
+   * The producer advances @e tail before overwriting a record and
+   * @e head once a record is complete. A reader copies a record between
+   * its position and @e head, then checks that @e tail did not move
+   * past it meanwhile.
+   *
+   * There is a single producer : the methods of this class have to be
+   * called from the thread of the agent.
+   *
+   * @sa ObservationBusReader
+   */
+  class ObservationBus {
+  public:
+    enum RecordKind { PAD = 0, OBSERVATION, REQUEST, RECALL, PLAN };
+
+    /** @brief Constructor
+     *
+     * @param name Name of the shared memory object, such as "/trex.agent"
+     * @param capacity Size of the ring in bytes, rounded up to a power of 2
+     *
+     * Creates the shared memory object @e name, or replaces the one left
+     * by an agent that is no longer running.
+     *
+     * @throw ErrnoExcept if the object could not be created, or is
+     * published by an agent still running
+     */
+    ObservationBus(std::string const &name, size_t capacity);
+    /** @brief Destructor
+     *
+     * Removes the shared memory object. Readers still attached keep
+     * their mapping.
+     */
+    ~ObservationBus();
+
+    void publish(TICK tick, Observation const &obs);
+    /** @brief Publish a goal dispatched or recalled
+     * @param kind REQUEST or RECALL
+     */
+    void publish(TICK tick, RecordKind kind, TokenId const &goal);
+
+    /** @brief Start a PLAN record
+     *
+     * The plan is given with addTimeline and addToken and is published by
+     * endPlan.
+     */
+    void beginPlan(TICK tick, LabelStr const &reactor, unsigned int nTimelines);
+    void addTimeline(LabelStr const &timeline, unsigned int nTokens);
+    void addToken(TokenId const &token);
+    void endPlan();
+
+    std::string const &name() const {
+      return m_name;
+    }
+    /** @brief Records dropped because they did not fit in the ring
+     *
+     * The reference stays valid for the life of the bus, for the tick log.
+     */
+    unsigned long const &dropped() const {
+      return m_dropped;
+    }
+
+  private:
+    void write(RecordKind kind, TICK tick, std::string const &payload);
+    void reclaim(uint64_t end);
+
+    ObservationBus(ObservationBus const &);
+    void operator= (ObservationBus const &);
+
+    std::string const m_name;
+    size_t m_size; //!< Size of the mapping
+    char *m_base;
+    uint64_t m_capacity;
+    std::string m_payload; //!< Record being built, kept to reuse its storage
+    TICK m_planTick;
+    unsigned long m_dropped;
+  }; // TREX::ObservationBus
+
+  /** @brief A record read from an ObservationBus */
+  struct BusRecord {
+    ObservationBus::RecordKind kind;
+    TICK tick;
+    std::string payload;
+
+    /** @brief Read the payload in order */
+    class Cursor {
+    public:
+      explicit Cursor(BusRecord const &record)
+	:m_data(record.payload.data()), m_end(m_data+record.payload.size()) {}
+
+      uint8_t u8();
+      uint16_t u16();
+      uint32_t u32();
+      double f64();
+      std::string str();
+      bool done() const {
+	return m_data>=m_end;
+      }
+
+    private:
+      void get(void *val, size_t size);
+
+      char const *m_data, *m_end;
+    };
+  }; // TREX::BusRecord
+
+  /** @brief Observation bus reader
+   *
+   * Reads the records published on an ObservationBus. The bus does not
+   * know its readers : each one keeps its own position.
+   *
+   * @sa ObservationBus
+   */
+  class ObservationBusReader {
+  public:
+    /** @brief Constructor
+     *
+     * @param name Name of the shared memory object of the bus
+     * @param fromStart If true, start with the oldest record still in the
+     * ring, otherwise with the next one published
+     *
+     * @throw ErrnoExcept if the bus could not be opened
+     */
+    explicit ObservationBusReader(std::string const &name, bool fromStart =false);
+    ~ObservationBusReader();
+
+    /** @brief Next record
+     *
+     * @param record Set to the next record if any
+     *
+     * @retval true @e record was set
+     * @retval false no new record was published
+     */
+    bool next(BusRecord &record);
+
+    /** @brief Bytes of records overwritten before this reader could read them */
+    uint64_t lost() const {
+      return m_lost;
+    }
+
+  private:
+    ObservationBusReader(ObservationBusReader const &);
+    void operator= (ObservationBusReader const &);
+
+    size_t m_size;
+    char const *m_base;
+    uint64_t m_capacity;
+    uint64_t m_pos;
+    uint64_t m_lost;
+  }; // TREX::ObservationBusReader
+
+} // TREX
+
+#endif // _OBSERVATIONBUS_HH
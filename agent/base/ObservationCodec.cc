@@ -0,0 +1,295 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+* 
+*  Copyright (c) 2007. MBARI.
+*  All rights reserved.
+* 
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+* 
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the TREX Project nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+* 
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* -*- C++ -*-
+ * $Id$
+ */
+/** @file "ObservationCodec.cc"
+ */
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+
+#include <unistd.h>
+
+#include "Domains.hh"
+#include "DataTypes.hh"
+
+#include "ErrnoExcept.hh"
+#include "ObservationCodec.hh"
+
+using namespace TREX;
+
+namespace {
+
+  /** @brief Largest frame accepted, to detect a corrupted stream early */
+  uint32_t const MAX_FRAME = 1<<20;
+
+  template<typename Ty>
+  void put(std::string &out, Ty val) {
+    out.append(reinterpret_cast<char const *>(&val), sizeof(val));
+  }
+
+  template<typename Ty>
+  bool get(char const *&data, char const *end, Ty &val) {
+    if( static_cast<size_t>(end-data)<sizeof(val) )
+      return false;
+    memcpy(&val, data, sizeof(val));
+    data += sizeof(val);
+    return true;
+  }
+
+  void corrupted(char const *what) {
+    throw ErrnoExcept("ObservationDecoder", what);
+  }
+
+  void unsupported(Observation const &obs, LabelStr const &name) {
+    throw ErrnoExcept("ObservationEncoder", "cannot encode parameter "+name.toString()
+		      +" of "+obs.getPredicate().toString());
+  }
+
+}
+
+/*
+ * class TREX::ObservationEncoder
+ */
+
+// structors :
+
+ObservationEncoder::ObservationEncoder() {}
+
+// Manipulators :
+
+void ObservationEncoder::reset() {
+  m_ids.clear();
+}
+
+uint32_t ObservationEncoder::intern(LabelStr const &label, std::string &out) {
+  double const key = label;
+  std::map<double, uint32_t>::iterator i = m_ids.lower_bound(key);
+
+  if( m_ids.end()!=i && key==i->first )
+    return i->second;
+
+  uint32_t const id = m_ids.size();
+  std::string const &text = label.toString();
+
+  m_ids.insert(i, std::make_pair(key, id));
+  put<uint32_t>(out, sizeof(uint8_t)+sizeof(id)+text.length());
+  put<uint8_t>(out, INTERN);
+  put(out, id);
+  out.append(text);
+  return id;
+}
+
+void ObservationEncoder::encode(Observation const &obs, std::string &out) {
+  unsigned int const count = obs.countParameters();
+  // The labels are interned as the body is built, so that their
+  // frames come before the one of the observation
+  std::string &body = m_body;
+
+  body.clear();
+  checkError(count<=0xffff, "Too many parameters in "<<obs.getPredicate().toString());
+  put(body, intern(obs.getObjectName(), out));
+  put(body, intern(obs.getPredicate(), out));
+  put<uint16_t>(body, count);
+  for(unsigned int i=0; i<count; ++i) {
+    std::pair<LabelStr, AbstractDomain const *> const param = obs[i];
+    AbstractDomain const &dom = *(param.second);
+
+    if( dom.isEmpty() || dom.isEntity() )
+      unsupported(obs, param.first);
+    put(body, intern(param.first, out));
+    if( dom.getDataType()->isBool() ) {
+      put<uint8_t>(body, BOOL);
+      put<uint8_t>(body, dom.isSingleton() ? (0.0!=dom.getSingletonValue()) : 2);
+    } else if( dom.getDataType()->isNumeric() ) {
+      if( !dom.isInterval() && !dom.isSingleton() )
+	unsupported(obs, param.first);
+      put<uint8_t>(body, dom.getDataType()->minDelta()<1.0 ? FLOAT : INT);
+      put<double>(body, dom.getLowerBound());
+      put<double>(body, dom.getUpperBound());
+    } else {
+      if( !dom.isSingleton() )
+	unsupported(obs, param.first);
+      put<uint8_t>(body, dom.getDataType()->isString() ? STRING : SYMBOL);
+      put(body, intern(LabelStr(dom.getSingletonValue()), out));
+    }
+  }
+  put<uint32_t>(out, sizeof(uint8_t)+body.length());
+  put<uint8_t>(out, OBSERVE);
+  out.append(body);
+}
+
+/*
+ * class TREX::ObservationDecoder
+ */
+
+// structors :
+
+ObservationDecoder::ObservationDecoder()
+  :m_pos(0) {}
+
+// Observers :
+
+LabelStr const &ObservationDecoder::label(uint32_t id) const {
+  if( id>=m_labels.size() )
+    corrupted("unknown label");
+  return m_labels[id];
+}
+
+AbstractDomain *ObservationDecoder::value(uint8_t type, char const *&data, 
+					  char const *end) const {
+  uint8_t flag;
+  double lb, ub;
+  uint32_t id;
+
+  switch( type ) {
+  case ObservationEncoder::BOOL:
+    if( !get(data, end, flag) || flag>2 )
+      corrupted("invalid bool");
+    if( 2==flag )
+      return new BoolDomain();
+    return new BoolDomain(1==flag);
+  case ObservationEncoder::INT:
+  case ObservationEncoder::FLOAT:
+    // Written so that NaN, which fails every comparison, is rejected too
+    if( !get(data, end, lb) || !get(data, end, ub) 
+	|| !(MINUS_INFINITY<=lb && lb<=ub && ub<=PLUS_INFINITY) )
+      corrupted("invalid interval");
+    if( ObservationEncoder::INT==type ) {
+      if( std::floor(lb)!=lb || std::floor(ub)!=ub )
+	corrupted("invalid integer interval");
+      return new IntervalIntDomain((int)lb, (int)ub);
+    }
+    return new IntervalDomain(lb, ub);
+  case ObservationEncoder::STRING:
+    if( !get(data, end, id) )
+      corrupted("truncated string");
+    return new StringDomain(label(id).c_str(), StringDT::instance());
+  case ObservationEncoder::SYMBOL:
+    if( !get(data, end, id) )
+      corrupted("truncated symbol");
+    return new SymbolDomain(label(id), SymbolDT::instance());
+  default:
+    corrupted("unknown value type");
+    return NULL;
+  }
+}
+
+// Manipulators :
+
+void ObservationDecoder::reset() {
+  m_buffer.clear();
+  m_pos = 0;
+  m_labels.clear();
+}
+
+void ObservationDecoder::append(char const *data, size_t size) {
+  // Drop the decoded frames once they are the larger part of the buffer
+  if( m_pos>0 && 2*m_pos>=m_buffer.size() ) {
+    m_buffer.erase(0, m_pos);
+    m_pos = 0;
+  }
+  m_buffer.append(data, size);
+}
+
+bool ObservationDecoder::read(int fd) {
+  char chunk[4096];
+
+  while( true ) {
+    ssize_t ret = ::read(fd, chunk, sizeof(chunk));
+
+    if( ret>0 )
+      append(chunk, ret);
+    else if( 0==ret )
+      return false;
+    else if( EAGAIN==errno || EWOULDBLOCK==errno )
+      return true;
+    else if( EINTR!=errno )
+      throw ErrnoExcept("ObservationDecoder::read");
+  }
+}
+
+ObservationByValue *ObservationDecoder::next() {
+  while( true ) {
+    char const *data = m_buffer.data()+m_pos, *end = m_buffer.data()+m_buffer.size();
+    uint32_t size;
+    uint8_t kind;
+
+    if( !get(data, end, size) )
+      return NULL;
+    if( size<sizeof(kind) || size>MAX_FRAME )
+      corrupted("invalid frame size");
+    if( static_cast<size_t>(end-data)<size )
+      return NULL;
+    end = data+size;
+    m_pos = end-m_buffer.data();
+    get(data, end, kind);
+
+    if( ObservationEncoder::INTERN==kind ) {
+      uint32_t id;
+
+      if( !get(data, end, id) || id>m_labels.size() )
+	corrupted("invalid label");
+      LabelStr text(std::string(data, end));
+      if( id==m_labels.size() )
+	m_labels.push_back(text);
+      else
+	m_labels[id] = text;
+    } else if( ObservationEncoder::OBSERVE==kind ) {
+      uint32_t timeline, predicate, name;
+      uint16_t count;
+      uint8_t type;
+
+      if( !get(data, end, timeline) || !get(data, end, predicate) || !get(data, end, count) )
+	corrupted("truncated observation");
+      ObservationByValue *obs = ObservationPool::acquire(label(timeline), label(predicate));
+      try {
+	for(uint16_t i=0; i<count; ++i) {
+	  if( !get(data, end, name) || !get(data, end, type) )
+	    corrupted("truncated parameter");
+	  obs->push_back(label(name), value(type, data, end));
+	}
+	if( data!=end )
+	  corrupted("trailing bytes after observation");
+      } catch(...) {
+	ObservationPool::release(obs);
+	throw;
+      }
+      return obs;
+    } else 
+      corrupted("unknown frame kind");
+  }
+}
@@ -0,0 +1,163 @@
+/* -*- C++ -*-
+ * $Id$
+ */
+/** @file "ObservationCodec.hh"
+ * @brief Binary encoding of observations for external processes.
+ */
+#ifndef _OBSERVATIONCODEC_HH
+#define _OBSERVATIONCODEC_HH
+
+/*********************************************************************
+* Software License Agreement (BSD License)
+* 
+*  Copyright (c) 2007. MBARI.
+*  All rights reserved.
+* 
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+* 
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the TREX Project nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+* 
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+
+#include "Observer.hh"
+
+namespace TREX {
+
+  /** @brief Observation encoder
+   *
+   * This class writes observations in the compact binary format read by
+   * ObservationDecoder. It lets a process other than the agent, such as a
+   * hardware driver, produce observations without building XML.
+   *
+   * The stream is a sequence of frames
+   * @code
+   * frame       : u32 size u8 kind body      (size counts kind and body)
+   * INTERN body : u32 id char[size-5]        (defines a label)
+   * OBSERVE body: u32 timeline u32 predicate u16 count param[count]
+   * param       : u32 name u8 type value
+   * @endcode
+   * Timelines, predicates, parameter names, strings and symbols are
+   * sent once as an INTERN frame and then referred to by their id. The
+   * value of a parameter depends on its type :
+   * @li BOOL : u8 0 for false, 1 for true and 2 for {false, true}
+   * @li INT and FLOAT : f64 lower bound and f64 upper bound, within
+   *     [MINUS_INFINITY, PLUS_INFINITY] and integral for INT
+   * @li STRING and SYMBOL : u32 id of the value
+   *
+   * Numbers are in the byte order of the host as the peers are expected
+   * to run on the same machine. Objects and enumerations other than
+   * singletons are not supported.
+   *
+   * @sa ObservationDecoder
+   */
+  class ObservationEncoder {
+  public:
+    enum FrameKind { INTERN = 1, OBSERVE = 2 };
+    enum ValueType { BOOL = 1, INT, FLOAT, STRING, SYMBOL };
+
+    ObservationEncoder();
+    ~ObservationEncoder() {}
+
+    /** @brief Encode an observation
+     *
+     * @param obs The observation
+     * @param out Where the frames are appended
+     *
+     * Appends to @e out the INTERN frames of the labels of @e obs that
+     * were not sent yet, followed by its OBSERVE frame.
+     *
+     * @throw ErrnoExcept if a parameter cannot be encoded
+     */
+    void encode(Observation const &obs, std::string &out);
+
+    /** @brief Forget the labels already sent
+     *
+     * Has to be called when the peer is replaced by a new one.
+     */
+    void reset();
+
+  private:
+    uint32_t intern(LabelStr const &label, std::string &out);
+
+    std::map<double, uint32_t> m_ids;
+    std::string m_body; //!< OBSERVE frame being built, kept to reuse its storage
+  }; // TREX::ObservationEncoder
+
+  /** @brief Observation decoder
+   *
+   * This class rebuilds the observations written by an
+   * ObservationEncoder. Bytes can be given in chunks of any size : an
+   * observation is only produced once its frame is complete.
+   *
+   * @sa ObservationEncoder
+   */
+  class ObservationDecoder {
+  public:
+    ObservationDecoder();
+    ~ObservationDecoder() {}
+
+    /** @brief Add bytes to decode */
+    void append(char const *data, size_t size);
+    /** @brief Add the bytes available on a file descriptor
+     *
+     * @param fd A non blocking file descriptor
+     *
+     * @retval true the peer may send more
+     * @retval false end of stream
+     *
+     * @throw ErrnoExcept if the read failed
+     */
+    bool read(int fd);
+
+    /** @brief Next observation
+     *
+     * @return The next complete observation, taken from ObservationPool and to be
+     * given back with ObservationPool::release, or NULL if none is complete yet.
+     *
+     * @throw ErrnoExcept if the stream is corrupted
+     */
+    ObservationByValue *next();
+
+    /** @brief Forget the pending bytes and the labels received */
+    void reset();
+
+  private:
+    LabelStr const &label(uint32_t id) const;
+    AbstractDomain *value(uint8_t type, char const *&data, char const *end) const;
+
+    std::string m_buffer;
+    size_t m_pos; //!< Start of the first frame not decoded in m_buffer
+    std::vector<LabelStr> m_labels;
+  }; // TREX::ObservationDecoder
+
+} // TREX
+
+#endif // _OBSERVATIONCODEC_HH
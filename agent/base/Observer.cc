@@ -43,6 +43,8 @@
 #include "Object.hh"
 #include "TokenVariable.hh"
 #include "Timeline.hh"
+#include "MutexWrapper.hh"
+#include "Guardian.hh"
 
 #include <sstream>
 
@@ -60,23 +62,32 @@ namespace TREX {
 
   const LabelStr& Observation::getPredicate() const {return m_predicateName;}
 
+  void Observation::rename(const LabelStr& objectName, const LabelStr& predicateName){
+    m_objectName = objectName;
+    m_predicateName = predicateName;
+  }
+
   unsigned int Observation::countParameters() const{ return m_parameterCount; }
 
   std::string Observation::toString() const{
     std::stringstream sstr;
-    sstr << "[" << Agent::instance()->getCurrentTick() << "]ON " << getObjectName().toString() << " ASSERT " << getPredicate().toString();
+    print(sstr);
+    return sstr.str();
+  }
+
+  void Observation::print(std::ostream& out) const{
+    out << "[" << Agent::instance()->getCurrentTick() << "]ON " << getObjectName().toString() << " ASSERT " << getPredicate().toString();
     if(countParameters() == 0)
-      sstr << "{}";
+      out << "{}";
     else {
-      sstr << "{ " << std::endl;
+      out << "{ " << std::endl;
       for (unsigned int i = 0; i < countParameters(); i++){
 	const std::pair<LabelStr, const AbstractDomain*> nameValuePair = operator[](i);
-	sstr << "  " << nameValuePair.first.toString() << "==" << nameValuePair.second->toString() << std::endl;
+	out << "  " << nameValuePair.first.toString() << "==" << nameValuePair.second->toString() << std::endl;
       }
 
-      sstr << "}";
+      out << "}";
     }
-    return sstr.str();
   }
 
   /*
@@ -138,20 +149,136 @@ namespace TREX {
   ObservationByValue::ObservationByValue(const LabelStr& objectName, const LabelStr& predicateName)
     : Observation(objectName, predicateName, 0) {}
 
-  ObservationByValue::~ObservationByValue(){
-    for(unsigned int i = 0; i<m_parameters.size(); i++){
-      AbstractDomain* dom = m_parameters[i].second;
-      delete dom;
+  ObservationByValue::ObservationByValue(const Observation& observation)
+    : Observation(observation.getObjectName(), observation.getPredicate(), 0) {
+    for(unsigned int i = 0; i<observation.countParameters(); i++){
+      const std::pair<LabelStr, const AbstractDomain*> param = observation[i];
+      push_back(param.first, param.second->copy());
     }
   }
 
+  ObservationByValue::~ObservationByValue(){
+    clear();
+  }
+
   const std::pair<LabelStr, const AbstractDomain*> ObservationByValue::operator[](unsigned int index) const {
-    checkError(countParameters() == m_parameters.size(), "Count: " << countParameters() << ", Size: " << m_parameters.size());
-    return std::pair<LabelStr, const AbstractDomain*>(m_parameters[index]);
+    checkError(index < countParameters(), "Index: " << index << ", Count: " << countParameters());
+    if(index < INLINE_PARAMETERS)
+      return std::pair<LabelStr, const AbstractDomain*>(m_inline[index]);
+    return std::pair<LabelStr, const AbstractDomain*>(m_overflow[index - INLINE_PARAMETERS]);
   }
 
   void ObservationByValue::push_back(const LabelStr& name, AbstractDomain* dom){
-    m_parameters.push_back(std::pair<LabelStr, AbstractDomain*>(name, dom));
+    if(m_parameterCount < INLINE_PARAMETERS)
+      m_inline[m_parameterCount] = std::pair<LabelStr, AbstractDomain*>(name, dom);
+    else
+      m_overflow.push_back(std::pair<LabelStr, AbstractDomain*>(name, dom));
     m_parameterCount++;
   }
+
+  void ObservationByValue::clear(){
+    for(unsigned int i = 0; i<m_parameterCount && i<INLINE_PARAMETERS; i++){
+      delete m_inline[i].second;
+      m_inline[i].second = NULL;
+    }
+    for(unsigned int i = 0; i<m_overflow.size(); i++)
+      delete m_overflow[i].second;
+    m_overflow.clear();
+    m_parameterCount = 0;
+  }
+
+
+  /* IMPLEMENTATION FOR ObservationPool */
+
+  namespace {
+    Mutex& poolMutex(){
+      static Mutex sl_mutex;
+      return sl_mutex;
+    }
+  }
+
+  std::vector<ObservationByValue*>& ObservationPool::freeList(){
+    static std::vector<ObservationByValue*> sl_free;
+    return sl_free;
+  }
+
+  ObservationByValue* ObservationPool::acquire(const LabelStr& objectName, const LabelStr& predicateName){
+    ObservationByValue* observation = NULL;
+    {
+      Guardian<Mutex> guard(poolMutex());
+      if(!freeList().empty()){
+	observation = freeList().back();
+	freeList().pop_back();
+      }
+    }
+
+    if(observation == NULL)
+      return new ObservationByValue(objectName, predicateName);
+
+    observation->rename(objectName, predicateName);
+    return observation;
+  }
+
+  ObservationByValue* ObservationPool::copy(const Observation& observation){
+    ObservationByValue* result = acquire(observation.getObjectName(), observation.getPredicate());
+    for(unsigned int i = 0; i<observation.countParameters(); i++){
+      const std::pair<LabelStr, const AbstractDomain*> param = observation[i];
+      result->push_back(param.first, param.second->copy());
+    }
+    return result;
+  }
+
+  void ObservationPool::release(ObservationByValue* observation){
+    if(observation == NULL)
+      return;
+
+    observation->clear();
+    {
+      Guardian<Mutex> guard(poolMutex());
+      if(freeList().size() < MAX_FREE){
+	freeList().push_back(observation);
+	return;
+      }
+    }
+    delete observation;
+  }
+
+
+  /* IMPLEMENTATION FOR ObservationBuffer */
+
+  ObservationBuffer::ObservationBuffer(): m_coalesced(0) {}
+
+  ObservationBuffer::~ObservationBuffer(){
+    for(unsigned int i = 0; i<m_pending.size(); i++)
+      ObservationPool::release(m_pending[i]);
+  }
+
+  void ObservationBuffer::push(const Observation& observation, bool coalesce){
+    ObservationByValue* copy = ObservationPool::copy(observation);
+
+    if(coalesce){
+      std::map<double, unsigned int>::const_iterator it = m_latest.find(observation.getObjectName());
+      if(it != m_latest.end()){
+	ObservationPool::release(m_pending[it->second]);
+	m_pending[it->second] = copy;
+	m_coalesced++;
+	return;
+      }
+      m_latest.insert(std::make_pair((double) observation.getObjectName(), m_pending.size()));
+    }
+
+    m_pending.push_back(copy);
+  }
+
+  void ObservationBuffer::flush(Observer& observer){
+    // Swap first as the observer may post observations in turn
+    std::vector<ObservationByValue*> pending;
+    pending.swap(m_pending);
+    m_latest.clear();
+
+    for(unsigned int i = 0; i<pending.size(); i++){
+      observer.notify(*pending[i]);
+      ObservationPool::release(pending[i]);
+    }
+  }
 }
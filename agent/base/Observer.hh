@@ -45,6 +45,10 @@
 
 #include "EuropaXML.hh"
 
+#include <map>
+#include <ostream>
+#include <vector>
+
 namespace TREX {
 
   /**
@@ -76,6 +80,11 @@ namespace TREX {
      * @brief Utility to help tracing
      */
     std::string toString() const;
+
+    /**
+     * @brief Write the same text as toString directly to @e out
+     */
+    void print(std::ostream& out) const;
   
     /** @brief Utility to serialize data in XML format
      *
@@ -96,11 +105,25 @@ namespace TREX {
     Observation(const LabelStr& objectName, const LabelStr& predicateName, unsigned int parameterCount = 0);
     unsigned int m_parameterCount;
 
+    /**
+     * @brief Give the observation another timeline and predicate. Used to recycle pooled observations.
+     */
+    void rename(const LabelStr& objectName, const LabelStr& predicateName);
+
   private:
-    const LabelStr m_objectName;
-    const LabelStr m_predicateName;
+    LabelStr m_objectName;
+    LabelStr m_predicateName;
   };
 
+  /**
+   * @brief Formats the observation only when the stream is written to, so that a disabled
+   * log entry or debug message costs nothing.
+   */
+  inline std::ostream& operator<<(std::ostream& out, const Observation& observation){
+    observation.print(out);
+    return out;
+  }
+
   class ObservationByReference : public Observation {
   public:
     ObservationByReference(const TokenId& token);
@@ -110,10 +133,20 @@ namespace TREX {
     const TokenId m_token;
   };
 
+  /**
+   * @brief An observation owning a copy of its parameter values. The first few parameters are stored
+   * inline, so that small observations only allocate their domains.
+   * @see ObservationPool
+   */
   class ObservationByValue: public Observation {
   public:
     ObservationByValue(const LabelStr& objectName, const LabelStr& predicateName);
 
+    /**
+     * @brief Copy the values of any observation. The domains are copied.
+     */
+    explicit ObservationByValue(const Observation& observation);
+
     ~ObservationByValue();
 
     const std::pair<LabelStr, const AbstractDomain*> operator[](unsigned int) const;
@@ -121,7 +154,43 @@ namespace TREX {
     void push_back(const LabelStr&, AbstractDomain* dom);
 
   private:
-    std::vector< std::pair<LabelStr, AbstractDomain*> > m_parameters;
+    friend class ObservationPool;
+
+    /**
+     * @brief Delete the parameters, keeping the storage for reuse.
+     */
+    void clear();
+
+    static const unsigned int INLINE_PARAMETERS = 4;
+    std::pair<LabelStr, AbstractDomain*> m_inline[INLINE_PARAMETERS]; /*!< The first parameters */
+    std::vector< std::pair<LabelStr, AbstractDomain*> > m_overflow; /*!< The parameters past INLINE_PARAMETERS */
+  };
+
+  /**
+   * @brief Recycles ObservationByValue instances for adapters posting observations at a high rate.
+   * An observation obtained with acquire is returned with release once notified, instead of being deleted.
+   * Thread safe.
+   */
+  class ObservationPool {
+  public:
+    /**
+     * @brief An observation without parameters, recycled if possible.
+     */
+    static ObservationByValue* acquire(const LabelStr& objectName, const LabelStr& predicateName);
+
+    /**
+     * @brief A copy of any observation, recycled if possible. The domains are copied.
+     */
+    static ObservationByValue* copy(const Observation& observation);
+
+    /**
+     * @brief Give back an observation. Its parameters are deleted. NULL is ignored.
+     */
+    static void release(ObservationByValue* observation);
+
+  private:
+    static const unsigned int MAX_FREE = 256; /*!< Observations kept for reuse. Beyond that they are deleted */
+    static std::vector<ObservationByValue*>& freeList();
   };
 
   class Observer {
@@ -130,6 +199,43 @@ namespace TREX {
 
     virtual ~Observer(){}
   };
+
+  /**
+   * @brief Observations held for an observer until it is ready for them.
+   * By default a new observation of a timeline replaces the one pending for it: only the latest value is delivered.
+   */
+  class ObservationBuffer {
+  public:
+    ObservationBuffer();
+
+    ~ObservationBuffer();
+
+    /**
+     * @brief Keep a copy of the observation until the next flush
+     * @param coalesce If true, replace the observation pending for the same timeline, if any.
+     */
+    void push(const Observation& observation, bool coalesce = true);
+
+    /**
+     * @brief Deliver the pending observations in the order they were first pushed, and forget them.
+     */
+    void flush(Observer& observer);
+
+    bool empty() const {return m_pending.empty();}
+
+    /**
+     * @brief Number of observations replaced before being delivered
+     */
+    unsigned long coalesced() const {return m_coalesced;}
+
+  private:
+    ObservationBuffer(const ObservationBuffer&);
+    ObservationBuffer& operator=(const ObservationBuffer&);
+
+    std::vector<ObservationByValue*> m_pending; /*!< Taken from ObservationPool */
+    std::map<double, unsigned int> m_latest; /*!< Position in m_pending of the last coalescable observation of each timeline */
+    unsigned long m_coalesced;
+  };
 }
 
 #endif
@@ -38,14 +38,29 @@
  */
 #include <vector>
 
+#include "RStat.hh"
+
 namespace TREX {
 
   class PerformanceMonitor {
   public:
+    PerformanceMonitor(): m_capacity(0) {}
+
     virtual ~PerformanceMonitor(){}
 
     virtual void addTickData(const timeval& synchTime, const timeval& deliberationTime){
       m_tickData.push_back(std::pair<timeval, timeval>(synchTime, deliberationTime));
+      trim(m_tickData);
+    }
+
+    /**
+     * @brief Record the full usage of a tick, including wall clock time, thread CPU time and context switches.
+     * The user times are also passed to addTickData(const timeval&, const timeval&).
+     */
+    virtual void addTickData(const RStat& synchUsage, const RStat& deliberationUsage){
+      m_tickStats.push_back(std::pair<RStat, RStat>(synchUsage, deliberationUsage));
+      trim(m_tickStats);
+      addTickData(synchUsage.user_time(), deliberationUsage.user_time());
     }
 
     static PerformanceMonitor& defaultMonitor(){
@@ -55,15 +70,34 @@ namespace TREX {
 
     const std::vector< std::pair<timeval, timeval> >& getData() const {return m_tickData;}
 
+    const std::vector< std::pair<RStat, RStat> >& getStats() const {return m_tickStats;}
+
+    /**
+     * @brief Only keep the most recent ticks, for agents that run for long. The data then holds at least
+     * the last @e ticks ticks and at most twice as many, as the oldest ones are dropped in bulk.
+     * @param ticks 0 to keep every tick
+     */
+    void setCapacity(size_t ticks) {m_capacity = ticks;}
+
   protected:
+    template<class T>
+    void trim(std::vector<T>& data) const {
+      if(m_capacity > 0 && data.size() >= 2 * m_capacity)
+	data.erase(data.begin(), data.end() - m_capacity);
+    }
+
+    size_t m_capacity; /*!< Ticks kept. 0 for all of them */
     std::vector< std::pair<timeval, timeval> > m_tickData;
+    std::vector< std::pair<RStat, RStat> > m_tickStats; /*!< Synchronization and deliberation usage per tick */
   };
 
 
   class StatisticsCollector: public PerformanceMonitor {
   public:
+    using PerformanceMonitor::addTickData;
     void addTickData(const timeval& synchTime, const timeval& deliberationTime){
       m_tickData.push_back(std::pair<timeval, timeval>(synchTime, deliberationTime));
+      trim(m_tickData);
     }
   };
 }
@@ -55,6 +55,15 @@ namespace {
       out.put(*iter);
     return out.put(unit);
   }
+
+  void clock_read(clockid_t id, timeval &out) {
+    timespec ts;
+    
+    if( clock_gettime(id, &ts)<0 )
+      throw TREX::ErrnoExcept("RStat");
+    out.tv_sec = ts.tv_sec;
+    out.tv_usec = ts.tv_nsec/1000;
+  }
   
 } // unnamed 
 
@@ -80,10 +89,14 @@ void RStat::reset(RStat::who_type wt) {
   case zeroed:
   case unknown:
     memset(&_snapshot, 0, sizeof(rusage));
+    memset(&_wall, 0, sizeof(timeval));
+    memset(&_thread_cpu, 0, sizeof(timeval));
     break;
   default:
     if( getrusage(_kind, &_snapshot)<0 )
       throw ErrnoExcept("RStat");
+    clock_read(CLOCK_MONOTONIC, _wall);
+    clock_read(CLOCK_THREAD_CPUTIME_ID, _thread_cpu);
   }
 }
 
@@ -115,6 +128,9 @@ RStat RStat::operator- (RStat const &other) const {
   result._snapshot.ru_nvcsw = _snapshot.ru_nvcsw-other._snapshot.ru_nvcsw;
   result._snapshot.ru_nivcsw = _snapshot.ru_nivcsw-other._snapshot.ru_nivcsw;
 
+  result._wall = _wall-other._wall;
+  result._thread_cpu = _thread_cpu-other._thread_cpu;
+
   return result;
 }
 
@@ -144,6 +160,9 @@ RStat RStat::operator+ (RStat const &other) const {
   result._snapshot.ru_nvcsw = _snapshot.ru_nvcsw+other._snapshot.ru_nvcsw;
   result._snapshot.ru_nivcsw = _snapshot.ru_nivcsw+other._snapshot.ru_nivcsw;
 
+  result._wall = _wall+other._wall;
+  result._thread_cpu = _thread_cpu+other._thread_cpu;
+
   return result;
 }
 
@@ -173,6 +192,9 @@ RStat RStat::operator* (long n) const {
   result._snapshot.ru_nvcsw = _snapshot.ru_nvcsw*n;
   result._snapshot.ru_nivcsw = _snapshot.ru_nivcsw*n;
 
+  result._wall = _wall*n;
+  result._thread_cpu = _thread_cpu*n;
+
   return result;
 }
 
@@ -202,6 +224,9 @@ RStat RStat::operator/ (long n) const {
   result._snapshot.ru_nvcsw = _snapshot.ru_nvcsw/n;
   result._snapshot.ru_nivcsw = _snapshot.ru_nivcsw/n;
 
+  result._wall = _wall/n;
+  result._thread_cpu = _thread_cpu/n;
+
   return result;
 }
 
@@ -209,6 +234,13 @@ RStat RStat::operator/ (long n) const {
 
 // Observers :
 
+timeval RStat::off_cpu_time() const {
+  if( _thread_cpu<_wall )
+    return _wall-_thread_cpu;
+  timeval zero = {0, 0};
+  return zero;
+}
+
 std::ostream &RStat::long_desc(std::ostream &out) const {
   out<<"Resource Stats ("<<_kind<<"):\n"
     "\t- user time        : "<<_snapshot.ru_utime<<" s\n"
@@ -230,13 +262,16 @@ std::ostream &RStat::long_desc(std::ostream &out) const {
     "\t- Messages recvd   : "<<_snapshot.ru_msgrcv<<"\n"
     "\t- Signals received : "<<_snapshot.ru_nsignals<<"\n"
     "\t- Voluntary ctxt switches : "<<_snapshot.ru_nvcsw<<"\n"
-    "\t- Unvol. context switches : "<<_snapshot.ru_nivcsw<<std::endl;
+    "\t- Unvol. context switches : "<<_snapshot.ru_nivcsw<<"\n"
+    "\t- wall clock time  : "<<_wall<<" s\n"
+    "\t- thread CPU time  : "<<_thread_cpu<<" s"<<std::endl;
   return out;
 }
 
 std::string RStat::compact_header() {
   return "UserTime\tSystemTime\tMaxRSS\tSharedTxtMem\t"
-    "UnsharedData\tUnsharedStack\tPageReclaim\tPageFaults";
+    "UnsharedData\tUnsharedStack\tPageReclaim\tPageFaults\t"
+    "VolCtxSwitch\tInvolCtxSwitch\tWallTime\tThreadTime";
 }
 
 
@@ -244,6 +279,8 @@ std::ostream &RStat::compact_desc(std::ostream &out) const {
   out<<_snapshot.ru_utime<<"\t"<<_snapshot.ru_stime<<"\t"
      << _snapshot.ru_maxrss<<"\t"<<_snapshot.ru_ixrss<<"\t"
      << _snapshot.ru_idrss<<"\t"<<_snapshot.ru_isrss<<"\t"
-     <<_snapshot.ru_minflt<<"\t"<<_snapshot.ru_majflt;
+     <<_snapshot.ru_minflt<<"\t"<<_snapshot.ru_majflt<<"\t"
+     <<_snapshot.ru_nvcsw<<"\t"<<_snapshot.ru_nivcsw<<"\t"
+     <<_wall<<"\t"<<_thread_cpu;
   return out;
 }
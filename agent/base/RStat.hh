@@ -44,6 +44,7 @@
 */
 
 #include <sys/resource.h>
+#include <time.h>
 
 #include "ErrnoExcept.hh"
 #include "TimeUtils.hh"
@@ -59,7 +60,10 @@ namespace TREX {
    *
    * @note This class is based on POSIX C function @c getrusage. It does
    * not yet offer all the interfaces to access data given by this
-   * function.
+   * function. Each snapshot also reads the @c CLOCK_MONOTONIC and
+   * @c CLOCK_THREAD_CPUTIME_ID clocks so that a difference of two
+   * snapshots gives the elapsed time and the CPU time of the calling
+   * thread.
    */  
   class RStat {
   public:
@@ -79,13 +83,21 @@ namespace TREX {
        * a child process that has not yet terminated."</em>
        */
       children = RUSAGE_CHILDREN,
+#ifdef RUSAGE_THREAD
+      /** @brief calling thread statistics.
+       *
+       * Only available on Linux. Use it to measure a reactor that runs
+       * in its own thread.
+       */
+      thread = RUSAGE_THREAD,
+#endif
       /** @brief Unknown statisitics.
        *
        * This occur when you make operation with RStat
        * instances having different @c who_type.
        */
-      zeroed = 1,
-      unknown = 2
+      zeroed = 2,
+      unknown = 3
     }; // RStat::who_type
     
     /** @brief Constructor.
@@ -107,7 +119,9 @@ namespace TREX {
     /** 
      * @brief Copy constructor
      */
-    RStat(const RStat& org): _kind(org._kind), _snapshot(org._snapshot){}
+    RStat(const RStat& org)
+      :_kind(org._kind), _snapshot(org._snapshot), 
+       _wall(org._wall), _thread_cpu(org._thread_cpu) {}
 
     /** @brief Destructor */
     ~RStat() {}
@@ -160,6 +174,38 @@ namespace TREX {
     timeval const &system_time() const {
       return _snapshot.ru_stime;
     }
+
+    /** @brief Wall clock time
+     *
+     * @return The @c CLOCK_MONOTONIC date of the snapshot. It only
+     * makes sense as a difference between two snapshots, where it
+     * gives the real time elapsed including the time spent blocked
+     * or preempted.
+     *
+     * @sa thread_time() const
+     */
+    timeval const &wall_time() const {
+      return _wall;
+    }
+
+    /** @brief Thread CPU time
+     *
+     * @return The CPU time (user and system) consumed by the thread
+     * that took the snapshot. Unlike user_time() it does not include
+     * the other threads of the process.
+     *
+     * @sa wall_time() const
+     */
+    timeval const &thread_time() const {
+      return _thread_cpu;
+    }
+
+    /** @brief Off CPU time
+     *
+     * @return The part of wall_time() the calling thread did not run :
+     * blocked on I/O, sleeping or preempted.
+     */
+    timeval off_cpu_time() const;
     
     /** @brief Maximum resident set size.
      *
@@ -205,6 +251,22 @@ namespace TREX {
     long const &n_page_faults() const {
       return _snapshot.ru_majflt;
     }
+    /** @brief Number of voluntary context switches
+     *
+     * @return The number of times the CPU was given up before the
+     * end of the time slice, typically to wait for a resource.
+     */
+    long const &n_voluntary_switches() const {
+      return _snapshot.ru_nvcsw;
+    }
+    /** @brief Number of involuntary context switches
+     *
+     * @return The number of times the process was preempted by
+     * another one.
+     */
+    long const &n_involuntary_switches() const {
+      return _snapshot.ru_nivcsw;
+    }
     
     /** @brief Difference between stats.
      *
@@ -278,7 +340,9 @@ namespace TREX {
      * by this instance into @e out. The format of the string written
      * is as follow :
      * @code
-     * user_time, system_time, max_resident, n_page_reclaims, n_page_faults
+     * user_time, system_time, max_resident, shared_text, unshared_data, 
+     * unshared_stack, n_page_reclaims, n_page_faults, n_voluntary_switches, 
+     * n_involuntary_switches, wall_time, thread_time
      * @endcode
      *
      * @return @e out after the operation
@@ -295,6 +359,10 @@ namespace TREX {
     who_type _kind;
     /** @brief Stats snapshot */
     rusage   _snapshot;
+    /** @brief CLOCK_MONOTONIC date */
+    timeval  _wall;
+    /** @brief CLOCK_THREAD_CPUTIME_ID date */
+    timeval  _thread_cpu;
     
     /** @brief Constructor
      *
@@ -337,6 +405,10 @@ namespace TREX {
       return out<<"self";
     case RStat::children:
       return out<<"children";
+#ifdef RUSAGE_THREAD
+    case RStat::thread:
+      return out<<"thread";
+#endif
     default:
       return out<<"???";
     }
@@ -240,14 +240,14 @@ AbstractDomain *SimAdapter::xmlAsAbstractDomain(TiXmlElement const &elem) {
   return NULL;
 } // SimAdapter::xmlAsAbstractDomain(TiXmlElement const &)
 
-Observation *SimAdapter::xmlAsObservation(TiXmlElement const &elem) {
+ObservationByValue *SimAdapter::xmlAsObservation(TiXmlElement const &elem) {
   char const *name = elem.Attribute("on");
   checkError(NULL!=name, 
 	     "SimAdapter:xmlAsObservation : missing \"on\" attribute");
   char const *pred = elem.Attribute("predicate");
   checkError(NULL!=pred, 
 	     "SimAdapter:xmlAsObservation : missing \"predicate\" attribute");
-  ObservationByValue *obs = new ObservationByValue(name, pred);
+  ObservationByValue *obs = ObservationPool::acquire(name, pred);
   
   for(TiXmlElement const *i=elem.FirstChildElement(); NULL!=i;
       i = i->NextSiblingElement()) {
@@ -286,7 +286,11 @@ SimAdapter::SimAdapter(LabelStr const&agentName,
   
 } // SimAdapter::SimAdapter
 
-SimAdapter::~SimAdapter() {}
+SimAdapter::~SimAdapter() {
+  // Give back the observations not played
+  for(std::multimap<TICK, ObservationByValue *>::iterator i=m_log.begin(); m_log.end()!=i; ++i)
+    ObservationPool::release(i->second);
+}
 
 // Modifiers :
 
@@ -298,7 +302,7 @@ void SimAdapter::loadObservations(TiXmlDocument const &file) {
   for(TiXmlElement const *tick=firstPath(&file, "Log/Tick")->ToElement();
       NULL!=tick; tick=tick->NextSiblingElement()) 
     if( 0==strcmp(tick->Value(), "Tick") ) {
-      std::pair<TICK, Observation *> entry;
+      std::pair<TICK, ObservationByValue *> entry;
 
       entry.first = strtol(tick->Attribute("value"), NULL, 0);
 
@@ -336,14 +340,14 @@ bool SimAdapter::synchronize() {
 	       "SimAdapter:synchronize : playable tick ("<<m_nextObs->first<<") is in the past."); 
 
     for( ; m_log.end()!=m_nextObs && curTick>=m_nextObs->first; ++m_nextObs ) {
-      Observation *obs = m_nextObs->second;
+      ObservationByValue *obs = m_nextObs->second;
       m_nextObs->second = NULL;
       
       debugMsg("SimAdapter", "["<<getName().toString()<<"]["<<curTick<<"] observation on < "
 	       <<obs->getObjectName().toString()<<" >");
    
       m_observer->notify(*obs);
-      delete obs;
+      ObservationPool::release(obs);
     }
   }
   else {
@@ -99,8 +99,8 @@ namespace TREX {
   private:
     ObserverId m_observer; //!< Observer connect to the Agent
     std::set<LabelStr> m_internals; /*!< The timelines it will accept goals on and issue observations */
-    std::multimap<TICK, Observation *> m_log; //!< Observations extracted from log file
-    std::multimap<TICK, Observation *>::iterator m_nextObs; //!< next observation to play
+    std::multimap<TICK, ObservationByValue *> m_log; //!< Observations extracted from log file
+    std::multimap<TICK, ObservationByValue *>::iterator m_nextObs; //!< next observation to play
     int m_lastBacktracked;
     DataTypeId m_floatDT;
     DataTypeId m_intDT;
@@ -151,7 +151,7 @@ namespace TREX {
      *
      * @return The result of parsing
      */
-    Observation *xmlAsObservation(TiXmlElement const &elem);
+    ObservationByValue *xmlAsObservation(TiXmlElement const &elem);
 
     /** Utilities for type conversion **/
     DataTypeId getFactory(SimAdapter::DomainType t);
@@ -0,0 +1,165 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+* 
+*  Copyright (c) 2007. MBARI.
+*  All rights reserved.
+* 
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+* 
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the TREX Project nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+* 
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* -*- C++ -*-
+ * $Id$
+ */
+/** @file "SocketAdapter.cc"
+ */
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "Agent.hh"
+#include "Assembly.hh"
+#include "ErrnoExcept.hh"
+#include "SocketAdapter.hh"
+#include "Utilities.hh"
+
+using namespace TREX;
+
+namespace {
+
+  void setNonBlocking(int fd) {
+    int flags = fcntl(fd, F_GETFL);
+
+    if( flags<0 || fcntl(fd, F_SETFL, flags|O_NONBLOCK)<0 )
+      throw ErrnoExcept("SocketAdapter");
+  }
+
+}
+
+/*
+ * class TREX::SocketAdapter
+ */
+
+// structors :
+
+SocketAdapter::SocketAdapter(LabelStr const &agentName, 
+			     TiXmlElement const &configData)
+  :Adapter(agentName, configData), 
+   m_path(extractData(configData, "socket").toString()), m_listen(-1), m_peer(-1) {
+  struct sockaddr_un addr;
+
+  ConfigurationException::configurationCheckError(m_path.length()<sizeof(addr.sun_path),
+						  nameString()+"Socket path \""+m_path+"\" is too long");
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strncpy(addr.sun_path, m_path.c_str(), sizeof(addr.sun_path)-1);
+
+  // A socket file left by a previous run would make bind fail. Anything
+  // else at that path is most likely a mistake in the configuration.
+  struct stat info;
+  if( 0==lstat(m_path.c_str(), &info) ) {
+    ConfigurationException::configurationCheckError(S_ISSOCK(info.st_mode),
+						    nameString()+"\""+m_path+"\" exists and is not a socket");
+    unlink(m_path.c_str());
+  }
+
+  m_listen = socket(AF_UNIX, SOCK_STREAM, 0);
+  if( m_listen<0 )
+    throw ErrnoExcept("SocketAdapter");
+  if( bind(m_listen, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr))<0 ||
+      listen(m_listen, 1)<0 ) {
+    ErrnoExcept error("SocketAdapter "+m_path);
+    close(m_listen);
+    throw error;
+  }
+  setNonBlocking(m_listen);
+  TREX_INFO("trex:info", nameString()<<"Listening on \""<<m_path<<'\"');
+}
+
+SocketAdapter::~SocketAdapter() {
+  disconnect();
+  close(m_listen);
+  unlink(m_path.c_str());
+}
+
+// Manipulators :
+
+void SocketAdapter::accept() {
+  m_peer = ::accept(m_listen, NULL, NULL);
+  if( m_peer<0 ) {
+    if( EAGAIN!=errno && EWOULDBLOCK!=errno && EINTR!=errno )
+      throw ErrnoExcept("SocketAdapter::accept");
+    return;
+  }
+  setNonBlocking(m_peer);
+  TREXLog()<<nameString()<<"Connected on \""<<m_path<<'\"'<<std::endl;
+}
+
+void SocketAdapter::disconnect() {
+  if( m_peer>=0 ) {
+    close(m_peer);
+    m_peer = -1;
+  }
+  // The labels are interned per connection
+  m_decoder.reset();
+}
+
+bool SocketAdapter::synchronize() {
+  if( m_peer<0 )
+    accept();
+  if( m_peer>=0 ) {
+    try {
+      bool const open = m_decoder.read(m_peer);
+
+      for(ObservationByValue *obs=m_decoder.next(); NULL!=obs; obs=m_decoder.next()) {
+	// A frame that does not match the model would fail in the reactors observing it
+	if( !Agent::instance()->isValidObservation(*obs) )
+	  TREXLog()<<nameString()<<"Dropping invalid observation "<<obs->getPredicate().toString()
+		   <<" on "<<obs->getObjectName().toString()<<std::endl;
+	else if( !sendNotify(*obs) )
+	  TREX_INFO("trex:warning", nameString()<<"Ignoring observation on "<<obs->getObjectName().toString());
+	ObservationPool::release(obs);
+      }
+      if( !open ) {
+	TREXLog()<<nameString()<<"Connection closed on \""<<m_path<<'\"'<<std::endl;
+	disconnect();
+      }
+    } catch(ErrnoExcept const &e) {
+      // A faulty process should not stop the agent
+      TREXLog()<<nameString()<<"Dropping connection on \""<<m_path<<"\": "<<e.what()<<std::endl;
+      disconnect();
+    }
+  }
+  return true;
+}
+
+TREX_REGISTER_REACTOR(SocketAdapter, SocketAdapter);
@@ -0,0 +1,111 @@
+/* -*- C++ -*-
+ * $Id$
+ */
+/** @file "SocketAdapter.hh"
+ * @brief Declaration of SocketAdapter
+ */
+#ifndef _SOCKETADAPTER_HH
+#define _SOCKETADAPTER_HH
+
+/*********************************************************************
+* Software License Agreement (BSD License)
+* 
+*  Copyright (c) 2007. MBARI.
+*  All rights reserved.
+* 
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+* 
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the TREX Project nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+* 
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <string>
+
+#include "Adapter.hh"
+#include "ObservationCodec.hh"
+
+namespace TREX {
+
+  /** @brief Observations from another process
+   *
+   * This adapter listens on a Unix domain socket for a process, such as a
+   * hardware driver, that sends observations in the format written by
+   * ObservationEncoder. The observations received are posted at each
+   * synchronization on the timelines of the adapter. Observations on other
+   * timelines are ignored. One process is connected at a time and another
+   * one can connect once it closed its connection.
+   *
+   * It is configured as
+   * @code
+   * <TeleoReactor name="driver" component="SocketAdapter" lookAhead="1" latency="0" socket="/tmp/driver.sock">
+   *   <Timeline name="position"/>
+   * </TeleoReactor>
+   * @endcode
+   *
+   * @sa ObservationEncoder
+   */
+  class SocketAdapter :public Adapter {
+  public:
+    /** @brief Constructor
+     *
+     * @param agentName name of the agent
+     * @param configData Configuration data for this instance
+     *
+     * @throw ErrnoExcept if the socket could not be created
+     * @throw ConfigurationException if something other than a socket
+     * exists at the path
+     */
+    SocketAdapter(LabelStr const &agentName, TiXmlElement const &configData);
+    /** @brief Destructor
+     *
+     * Closes the connection and removes the socket file.
+     */
+    ~SocketAdapter();
+
+    /** @brief Synchronization
+     *
+     * Accepts a new connection if none is open and posts all the
+     * observations received since the last tick.
+     */
+    bool synchronize();
+
+    /** @brief Path of the socket */
+    std::string const &path() const {
+      return m_path;
+    }
+
+  private:
+    void accept();
+    void disconnect();
+
+    std::string const m_path;
+    int m_listen; //!< Listening socket
+    int m_peer; //!< Connected process, -1 if none
+    ObservationDecoder m_decoder;
+  }; // TREX::SocketAdapter
+
+} // TREX
+
+#endif // _SOCKETADAPTER_HH
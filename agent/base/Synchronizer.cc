@@ -41,6 +41,7 @@
 #include "Timeline.hh"
 #include "Agent.hh"
 #include "Utilities.hh"
+#include "TraceLog.hh"
 
 
 namespace TREX {
@@ -52,7 +53,107 @@ namespace TREX {
       m_goals(m_core->m_goals), 
       m_observations(m_core->m_observations), 
       m_tokenAgenda(m_core->m_tokenAgenda),
-      m_committedTokens(m_core->m_committedTokens){}
+      m_committedTokens(m_core->m_committedTokens),
+      m_ceListener(m_db->getConstraintEngine(), *this),
+      m_resolveCount(0), m_resetCount(0), m_tokenCount(0){}
+
+  Synchronizer::CeListener::CeListener(const ConstraintEngineId& ce, Synchronizer& synchronizer)
+    : ConstraintEngineListener(ce), m_synchronizer(synchronizer){}
+
+  void Synchronizer::CeListener::notifyChanged(const ConstrainedVariableId& variable, const DomainListener::ChangeType& changeType){
+    m_synchronizer.handleChange(variable);
+  }
+
+  void Synchronizer::handleAgendaAddition(const TokenId& token){
+    int key = token->getKey();
+    m_agendaIndex[key] = token;
+    schedule(key, token);
+  }
+
+  void Synchronizer::handleAgendaRemoval(const TokenId& token){
+    int key = token->getKey();
+    m_agendaIndex.erase(key);
+    unschedule(key);
+  }
+
+  /**
+   * Scope of a token for synchronization is determined by its object, start and end. Any other change is ignored.
+   */
+  void Synchronizer::handleChange(const ConstrainedVariableId& variable){
+    EntityId parent = variable->parent();
+    if(parent.isNoId() || !TokenId::convertable(parent))
+      return;
+
+    std::map<int, TokenId>::const_iterator it = m_agendaIndex.find(parent->getKey());
+    if(it == m_agendaIndex.end())
+      return;
+
+    const TokenId& token = it->second;
+    int key = variable->getKey();
+    if(key == token->getObject()->getKey() || key == token->start()->getKey() || key == token->end()->getKey())
+      schedule(it->first, token);
+  }
+
+  void Synchronizer::schedule(int key, const TokenId& token){
+    double priority = token->start()->lastDomain().getLowerBound();
+    std::map<int, double>::iterator it = m_queuedAt.find(key);
+    if(it != m_queuedAt.end()){
+      if(it->second == priority)
+	return;
+
+      m_queue.erase(std::make_pair(it->second, key));
+      it->second = priority;
+    }
+    else
+      m_queuedAt.insert(std::make_pair(key, priority));
+
+    m_queue.insert(std::make_pair(priority, key));
+  }
+
+  void Synchronizer::unschedule(int key){
+    std::map<int, double>::iterator it = m_queuedAt.find(key);
+    if(it != m_queuedAt.end()){
+      m_queue.erase(std::make_pair(it->second, key));
+      m_queuedAt.erase(it);
+    }
+  }
+
+  void Synchronizer::park(const TokenId& token){
+    ObjectId object = token->getObject()->lastDomain().getSingletonValue();
+    m_parked[object->getKey()].insert(token->getKey());
+  }
+
+  /**
+   * Resolving a token changes the merge and ordering options of every other token on its timeline, without necessarily
+   * touching their domains, so tokens previously found out of scope there must be evaluated again.
+   */
+  void Synchronizer::releaseParked(const TokenId& token){
+    if(!token->getObject()->lastDomain().isSingleton())
+      return;
+
+    ObjectId object = token->getObject()->lastDomain().getSingletonValue();
+    std::map<int, std::set<int> >::iterator it = m_parked.find(object->getKey());
+    if(it == m_parked.end())
+      return;
+
+    std::set<int> parked;
+    parked.swap(it->second);
+    m_parked.erase(it);
+
+    for(std::set<int>::const_iterator k_it = parked.begin(); k_it != parked.end(); ++k_it){
+      std::map<int, TokenId>::const_iterator a_it = m_agendaIndex.find(*k_it);
+      if(a_it != m_agendaIndex.end())
+	schedule(a_it->first, a_it->second);
+    }
+  }
+
+  void Synchronizer::resetQueue(){
+    m_queue.clear();
+    m_queuedAt.clear();
+    m_parked.clear();
+    for(std::map<int, TokenId>::const_iterator it = m_agendaIndex.begin(); it != m_agendaIndex.end(); ++it)
+      schedule(it->first, it->second);
+  }
 
   /**
    * Will be in the horizon if start.ub <= (tao) && end.lb >= tao
@@ -148,14 +249,16 @@ namespace TREX {
    */
   bool Synchronizer::resolve(){
     // Use a counter to aid with settng debug breakpoints
-    static unsigned int sl_counter(0);
-    sl_counter++;
+    m_resolveCount++;
+
+    m_conflictKeys.clear();
 
     if(!m_core->propagate()){
 
       TREX_INFO("trex:debug:synchronization", m_core->nameString() << 
 		"Constraint network inconsistent after propagation. Cannot output database.");
 
+      recordPropagationConflict();
       return false;
     }
 
@@ -165,14 +268,23 @@ namespace TREX {
     checkError(m_core->isValidDb(), "Invalid database before synchronization.");
 
     m_stepCount = 0; // Reset step counter for stats
+
+    // The tick has moved on since the last call, so every token on the agenda must be evaluated again
+    resetQueue();
+
+    TREX_TRACE(TRACE_SYNCHRONIZATION, TRACE_SYNCH_RESOLVE, m_core->getCurrentTick(), m_core->getTraceId(), 0, m_agendaIndex.size());
+
     if(resolveTokens(m_stepCount) &&
        completeInternalTimelines(m_stepCount) &&
        resolveTokens(m_stepCount)){
       TREX_INFO("trex:debug:synchronization", m_core->nameString() << 
 		"Database after successful synchronization:\n" << PlanDatabaseWriter::toString(m_db));
+      TREX_TRACE(TRACE_SYNCHRONIZATION, TRACE_SYNCH_RESOLVED, m_core->getCurrentTick(), m_core->getTraceId(), 0, m_stepCount);
       return true;
     }
 
+    TREX_TRACE(TRACE_SYNCHRONIZATION, TRACE_SYNCH_FAILED, m_core->getCurrentTick(), m_core->getTraceId(), 0, m_stepCount);
+    recordPropagationConflict();
     return false;
   }
 
@@ -184,6 +296,7 @@ namespace TREX {
     TREXLog() << m_core->nameString() << "Beginning database relax." << std::endl;
 
     TREX_INFO("trex:debug:synchronization:relax", m_core->nameString() << "START");
+    TREX_TRACE(TRACE_RELAX, TRACE_RELAX_START, m_core->getCurrentTick(), m_core->getTraceId(), 0, discardCurrentValues);
 
     // Reset observations to base values. It is important that we do this before processing
     // other tokens as we want to recover the current observation and the easiest way to
@@ -210,14 +323,117 @@ namespace TREX {
     // Final step before trying again to resolve
     if(insertCopiedValues()){
       TREX_INFO("trex:debug:synchronization:relax", m_core->nameString() << "Relaxed Database Below" << std::endl << PlanDatabaseWriter::toString(m_db));
+      TREX_TRACE(TRACE_RELAX, TRACE_RELAX_END, m_core->getCurrentTick(), m_core->getTraceId(), 0, true);
       return true;
     }
 
+    TREX_TRACE(TRACE_RELAX, TRACE_RELAX_END, m_core->getCurrentTick(), m_core->getTraceId(), 0, false);
+
     TREXLog() << m_core->nameString() << "Relax failed." << std::endl;
 
     return false;
   }
 
+  /**
+   * @brief Cancel what was planned around the conflict and leave the rest of the plan alone. Slaves cannot be cancelled
+   * on their own, so we walk up to the highest uncommitted master and cancel that, which removes the slaves it implies.
+   */
+  bool Synchronizer::relaxLocal(){
+    if(m_conflictKeys.empty())
+      return false;
+
+    TREXLog() << m_core->nameString() << "Beginning local relax of " << m_conflictKeys.size() << " tokens." << std::endl;
+
+    std::set<int> roots;
+    for(std::set<int>::const_iterator it = m_conflictKeys.begin(); it != m_conflictKeys.end(); ++it){
+      EntityId entity = Entity::getEntity(*it);
+      if(entity.isNoId())
+	continue;
+
+      TokenId token = (TokenId) entity;
+      while(token->master().isId() && !token->master()->isCommitted())
+	token = token->master();
+
+      // Commitments at the execution frontier and observations can only be relaxed globally
+      if(token->isCommitted() || m_core->isObservation(token) || token->isInactive() || token->isRejected())
+	continue;
+
+      roots.insert(token->getKey());
+    }
+
+    m_conflictKeys.clear();
+
+    if(roots.empty()){
+      TREXLog() << m_core->nameString() << "Nothing to relax locally." << std::endl;
+      return false;
+    }
+
+    // Cancelling one root can remove another, so look them up again as we go
+    for(std::set<int>::const_iterator it = roots.begin(); it != roots.end(); ++it){
+      EntityId entity = Entity::getEntity(*it);
+      if(entity.isNoId())
+	continue;
+
+      TokenId token = (TokenId) entity;
+      TREX_INFO("trex:debug:synchronization:relaxLocal", m_core->nameString() << "Cancelling " << token->toString());
+      TREX_TRACE(TRACE_RELAX, TRACE_RELAX_CANCEL, m_core->getCurrentTick(), m_core->getTraceId(), token->getKey(), 0);
+      token->cancel();
+
+      // As in resetGoals, a cancelled goal must be fixed in the future
+      if(m_core->isGoal(token))
+	token->start()->restrictBaseDomain(IntervalIntDomain(m_core->getCurrentTick(), PLUS_INFINITY));
+    }
+
+    if(m_core->propagate())
+      return true;
+
+    TREXLog() << m_core->nameString() << "Local relax failed." << std::endl;
+
+    return false;
+  }
+
+  void Synchronizer::recordConflict(const TokenId& token){
+    m_conflictKeys.insert(token->getKey());
+
+    const std::vector<ConstrainedVariableId>& vars = token->getVariables();
+    for(std::vector<ConstrainedVariableId>::const_iterator it = vars.begin(); it != vars.end(); ++it)
+      recordNeighborhood(*it);
+  }
+
+  void Synchronizer::recordPropagationConflict(){
+    ConstraintEngineId ce = m_db->getConstraintEngine();
+
+    if(ce->constraintConsistent())
+      return;
+
+    const ConstrainedVariableSet& variables = ce->getVariables();
+    for(ConstrainedVariableSet::const_iterator it = variables.begin(); it != variables.end(); ++it){
+      ConstrainedVariableId var = *it;
+      if(var->lastDomain().isEmpty() && var->lastDomain().isClosed())
+	recordNeighborhood(var);
+    }
+  }
+
+  /**
+   * @see localContextForConstrainedVariable
+   */
+  void Synchronizer::recordNeighborhood(const ConstrainedVariableId& var){
+    TokenId token = getParentToken(var);
+    if(token.isId())
+      m_conflictKeys.insert(token->getKey());
+
+    ConstraintSet constraints;
+    var->constraints(constraints);
+    for(ConstraintSet::const_iterator c_it = constraints.begin(); c_it != constraints.end(); ++c_it){
+      const std::vector<ConstrainedVariableId>& scope = (*c_it)->getScope();
+      for(unsigned int i=0; i<scope.size(); i++){
+	TokenId parent = getParentToken(scope[i]);
+	if(parent.isId())
+	  m_conflictKeys.insert(parent->getKey());
+      }
+    }
+  }
+
   /**
    * @brief Relaxes goal commitments and removes those goals that are no longer achievable
    * @see relax
@@ -322,10 +538,9 @@ namespace TREX {
    * occurred yet. So must precede goal reset.
    */
   void Synchronizer::resetObservations(){
-    static int sl_counter(0);
-    sl_counter++;
+    m_resetCount++;
 
-    TREX_INFO("trex:debug:synchronization:resetObservations", m_core->nameString() << "[" << sl_counter << "]START");
+    TREX_INFO("trex:debug:synchronization:resetObservations", m_core->nameString() << "[" << m_resetCount << "]START");
 
     TokenSet observations = m_observations;
     for(TokenSet::iterator it = observations.begin(); it != observations.end(); ++it){
@@ -432,6 +647,104 @@ namespace TREX {
     return result;
   }
 
+  bool Synchronizer::restore(const Checkpoint::Reactor& state, std::map<uint32_t, TokenId>& restored){
+    TREXLog() << m_core->nameString() << "Restoring " << state.tokens.size() << " tokens from a checkpoint." << std::endl;
+
+    TICK tick = m_core->getCurrentTick();
+    std::vector< std::pair<TokenId, uint8_t> > plan;
+    for(std::vector<Checkpoint::Token>::const_iterator it = state.tokens.begin(); it != state.tokens.end(); ++it){
+      const Checkpoint::Token& record = *it;
+      bool isValue = (record.kind == Checkpoint::VALUE || record.kind == Checkpoint::OBSERVED_VALUE || record.kind == Checkpoint::GOAL_VALUE);
+      bool isPlanned = (record.kind == Checkpoint::PLANNED || record.kind == Checkpoint::PLANNED_GOAL || record.kind == Checkpoint::DISPATCHED);
+      bool isGoal = (record.kind == Checkpoint::GOAL || record.kind == Checkpoint::PLANNED_GOAL);
+
+      TokenId token = m_db->getClient()->createToken(record.predicate.c_str(), isGoal ? DbCore::REJECTABLE : DbCore::NOT_REJECTABLE);
+      if(isValue || isPlanned)
+	token->activate();
+
+      // Pin the recorded base domains. As in copyValue, the end of a current value is relaxed, unless it is a goal.
+      bool consistent = true;
+      for(std::vector< std::pair<std::string, Checkpoint::Domain> >::const_iterator v = record.variables.begin(); v != record.variables.end(); ++v){
+	ConstrainedVariableId var = token->getVariable(LabelStr(v->first));
+	if(var.isNoId() || (isValue && var == token->duration()) ||
+	   (var == token->end() && (isValue || record.kind == Checkpoint::OBSERVATION) && record.kind != Checkpoint::GOAL_VALUE))
+	  continue;
+	consistent = consistent && Checkpoint::restrict(var, v->second, m_db);
+      }
+
+      if(isGoal || isPlanned){
+	IntervalIntDomain start(tick, PLUS_INFINITY);
+	start.intersect(token->start()->baseDomain());
+	consistent = consistent && !start.isEmpty();
+	if(consistent)
+	  token->start()->restrictBaseDomain(start);
+      }
+
+      if(!consistent || (record.kind != Checkpoint::GOAL && !token->getObject()->baseDomain().isSingleton())){
+	TREXLog() << m_core->nameString() << "Dropping " << record.predicate << " from the checkpoint: it does not fit the model." << std::endl;
+	token->discard();
+	continue;
+      }
+
+      restored[record.key] = token;
+      if(isGoal)
+	m_goals.insert(token);
+
+      if(record.kind == Checkpoint::GOAL)
+	continue;
+
+      // The decisions of the planner, and the dispatch time of a dispatched token
+      if(isPlanned){
+	for(std::vector< std::pair<std::string, Checkpoint::Domain> >::const_iterator v = record.specified.begin(); v != record.specified.end(); ++v){
+	  ConstrainedVariableId var = token->getVariable(LabelStr(v->first));
+	  if(var.isId())
+	    Checkpoint::specify(var, v->second, m_db);
+	}
+	plan.push_back(std::make_pair(token, record.kind));
+	continue;
+      }
+
+      token->end()->restrictBaseDomain(IntervalIntDomain(tick, PLUS_INFINITY));
+
+      if(record.kind == Checkpoint::OBSERVED_VALUE || record.kind == Checkpoint::OBSERVATION){
+	token->end()->restrictBaseDomain(IntervalIntDomain(tick + 1, PLUS_INFINITY));
+	m_core->bufferObservation(token);
+	ObjectId object = token->getObject()->baseDomain().getSingletonValue();
+	std::map<int, TimelineContainer>::iterator tc = m_core->m_externalTimelineTable.find(object->getKey());
+	if(tc != m_core->m_externalTimelineTable.end())
+	  tc->second.updateLastObserved((TICK) token->start()->baseDomain().getUpperBound());
+      }
+      else if(record.kind == Checkpoint::GOAL_VALUE)
+	m_goals.insert(token);
+
+      if(!isValue)
+	continue;
+
+      int durationMin = std::max((int) (token->end()->baseDomain().getLowerBound() - token->start()->baseDomain().getUpperBound()), 0);
+      token->duration()->restrictBaseDomain(IntervalIntDomain(durationMin, PLUS_INFINITY));
+      token->commit();
+    }
+
+    // Lay out the plan in its recorded order, each token following the last one placed on its timeline. The current
+    // values go before it when inserted, and the slaves they imply within the tick can merge with the plan.
+    for(std::vector< std::pair<TokenId, uint8_t> >::const_iterator it = plan.begin(); it != plan.end(); ++it){
+      TokenId token = it->first;
+      ObjectId object = token->getObject()->baseDomain().getSingletonValue();
+      if(TimelineId::convertable(object)){
+	const std::list<TokenId>& sequence = TimelineId(object)->getTokenSequence();
+	object->constrain(sequence.empty() ? token : sequence.back(), token);
+      }
+
+      if(it->second == Checkpoint::DISPATCHED){
+	std::map<int, TimelineContainer>::iterator tc = m_core->m_externalTimelineTable.find(object->getKey());
+	if(tc != m_core->m_externalTimelineTable.end())
+	  tc->second.markDispatched(token);
+      }
+    }
+
+    return (plan.empty() || m_core->propagate()) && insertCopiedValues();
+  }
+
   /**
    * @brief Copies a current value to a new token which is also active and committed. We relax the new token
    * in its end time and in the set of applicable constraints
@@ -472,57 +785,65 @@ namespace TREX {
     token->commit();
 
     TREX_INFO("trex:debug:synchronization:copyValue",m_core->nameString() << "Replaced " << source->toString() << " with " << token->toString());
+    TREX_TRACE(TRACE_RELAX, TRACE_RELAX_COPY, m_core->getCurrentTick(), m_core->getTraceId(), source->getKey(), token->getKey());
   }
 
   /**
-   * Processes the token agenda and makes insertion or merge choices
+   * Processes the token agenda and makes insertion or merge choices. Tokens are taken from the work queue in order of
+   * earliest start. A token that cannot be resolved yet is dropped from the queue and only comes back when its object, start or
+   * end domain changes, or when another token is resolved on the same timeline.
    */
   bool Synchronizer::resolveTokens(unsigned int& stepCount){
-    static unsigned int sl_counter;
+    if(!m_core->propagate())
+      return false;
 
-    unsigned int lastCount = PLUS_INFINITY;
-    while(lastCount != m_stepCount){
-      lastCount = m_stepCount; // Update this to track changes on this iteration
+    while(!m_queue.empty()){
+      // Debugging Aid
+      m_tokenCount++;
 
-      // Process tokens on the agenda that are in scope
-      const TokenSet agenda = m_core->m_tokenAgenda;
+      int key = m_queue.begin()->second;
+      m_queue.erase(m_queue.begin());
+      m_queuedAt.erase(key);
 
-      if(!m_core->propagate())
-	return false;
+      std::map<int, TokenId>::const_iterator it = m_agendaIndex.find(key);
+      if(it == m_agendaIndex.end())
+	continue;
 
-      for(TokenSet::const_iterator it = agenda.begin(); it != agenda.end(); ++it){
-	// Debugging Aid
-	sl_counter++;
+      TokenId token = it->second;
 
-	TokenId token = *it;
+      TREX_INFO("trex:debug:synchronization:resolveTokens", 
+		m_core->nameString() << "[" << m_tokenCount << "] Evaluating " << token->toString() <<
+		" Start = " << token->start()->toString() << " End = " << token->end()->toString());
+      TREX_TRACE(TRACE_SYNCHRONIZATION, TRACE_SYNCH_EVALUATE, m_core->getCurrentTick(), m_core->getTraceId(), key, 0);
 
-	TREX_INFO("trex:debug:synchronization:resolveTokens", 
-		  m_core->nameString() << "[" << sl_counter << "] Evaluating " << token->toString() <<
-		 " Start = " << token->start()->toString() << " End = " << token->end()->toString());
+      // Tokens that are unbound are ignored since they are not unit decisions. They come back once the object is bound.
+      if(!token->getObject()->lastDomain().isSingleton())
+	continue;
 
-	// Tokens that are unbound are ignored since they are not unit decisions
-	if(!token->getObject()->lastDomain().isSingleton())
-	  continue;
+      // If not inactive, then it must have been resolved already
+      if(!token->isInactive())
+	continue;
 
-	// If not inactive, then it must have been resolved already
-	if(!token->isInactive())
-	  continue;
+      // If outside the horizon or out of scope, hold it until something on its timeline changes
+      TokenId merge_candidate;
+      if(!inSynchScope(token, merge_candidate)){
+	TREX_TRACE(TRACE_SYNCHRONIZATION, TRACE_SYNCH_PARK, m_core->getCurrentTick(), m_core->getTraceId(), key, 0);
+	park(token);
+	continue;
+      }
 
-	// If outside the horizon or out of scope, skip it
-	TokenId merge_candidate;
-	if(!inSynchScope(token, merge_candidate))
-	  continue;
+      stepCount++;
 
-	stepCount++;
+      TREX_INFO("trex:debug:synchronization:resolveTokens", 
+		m_core->nameString() << "Resolving " << token->toString() << " IN " << 
+		std::endl << PlanDatabaseWriter::toString(m_db));
+      TREX_TRACE(TRACE_SYNCHRONIZATION, TRACE_SYNCH_RESOLVE_TOKEN, m_core->getCurrentTick(), m_core->getTraceId(), key, 0);
 
-	TREX_INFO("trex:debug:synchronization:resolveTokens", 
-		 m_core->nameString() << "Resolving " << token->toString() << " IN " << 
-		 std::endl << PlanDatabaseWriter::toString(m_db));
+      // Resolve the token and ensure consistency in order to continue.
+      if(!resolveToken(token, stepCount, merge_candidate) || !m_core->propagate())
+	return false;
 
-	// Resolve the token and ensure consistency in order to continue.
-	if(!resolveToken(token, stepCount, merge_candidate) || !m_core->propagate())
-	  return false;
-      }
+      releaseParked(token);
     }
 
     return true;
@@ -532,6 +853,12 @@ namespace TREX {
     if(mergeToken(token, merge_candidate) || insertToken(token, stepCount))
       return true;
 
+    TREX_TRACE(TRACE_SYNCHRONIZATION, TRACE_SYNCH_CONFLICT, m_core->getCurrentTick(), m_core->getTraceId(), token->getKey(), 0);
+
+    recordConflict(token);
+    if(merge_candidate.isId())
+      recordConflict(merge_candidate);
+
     std::string explanation_str;
     TREX_INFO("trex:monitor:conflicts", m_core->nameString() << (explanation_str = tokenResolutionFailure(token, merge_candidate)));
 
@@ -586,6 +913,7 @@ namespace TREX {
 
     TREX_INFO("trex:debug:synchronization:mergeToken", 
 	     m_core->nameString() << "Merging " << token->toString() << " onto " << merge_candidate->toString());
+    TREX_TRACE(TRACE_SYNCHRONIZATION, TRACE_SYNCH_MERGE, m_core->getCurrentTick(), m_core->getTraceId(), token->getKey(), merge_candidate->getKey());
 
     m_core->propagate();
 
@@ -601,8 +929,9 @@ namespace TREX {
 
     // If the token is in the past, we will not insert it. Just remove it from the agenda and return OK
     if(token->end()->lastDomain().getUpperBound() == Agent::instance()->getCurrentTick()){
-      m_core->m_tokenAgenda.erase(token);
+      m_core->removeFromTokenAgenda(token);
       TREX_INFO("trex:debug:synchronization:insertToken", m_core->nameString() << "Skipping insertion of " << token->toString() << " which is in the past.");
+      TREX_TRACE(TRACE_SYNCHRONIZATION, TRACE_SYNCH_SKIP_PAST, m_core->getCurrentTick(), m_core->getTraceId(), token->getKey(), 0);
       return true;
     }
 
@@ -634,6 +963,7 @@ namespace TREX {
     TokenId s = choice.second.second;
 
     TREX_INFO("trex:debug:synchronization:insertToken", m_core->nameString() << "Inserting " << token->toString());
+    TREX_TRACE(TRACE_SYNCHRONIZATION, TRACE_SYNCH_INSERT, m_core->getCurrentTick(), m_core->getTraceId(), token->getKey(), 0);
 
     object->constrain(p, s);
 
@@ -745,8 +1075,9 @@ namespace TREX {
     predicate += predLabel.toString();
 
     TREX_INFO("trex:debug:synchronization:insertDefaultValue", m_core->nameString() << "Insert " << predicate << " On " << timeline->toString());
- 
+
     TokenId token = m_db->getClient()->createToken(predicate.c_str(), DbCore::NOT_REJECTABLE);
+    TREX_TRACE(TRACE_SYNCHRONIZATION, TRACE_SYNCH_INSERT_DEFAULT, m_core->getCurrentTick(), m_core->getTraceId(), token->getKey(), timeline->getKey());
     token->activate();
     token->start()->restrictBaseDomain(IntervalIntDomain(m_core->getCurrentTick(), m_core->getCurrentTick()));
     token->end()->restrictBaseDomain(IntervalIntDomain(m_core->getCurrentTick() + 1, PLUS_INFINITY));
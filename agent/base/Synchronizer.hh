@@ -38,6 +38,10 @@
 #include "TREXDefs.hh"
 #include "PlanDatabaseDefs.hh"
 #include "RuleInstance.hh"
+#include "ConstraintEngine.hh"
+#include "Checkpoint.hh"
+#include <set>
+#include <map>
 
 namespace TREX {
 
@@ -62,6 +66,36 @@ namespace TREX {
      */
     bool relax(bool discardCurrentValues);
 
+    /**
+     * @brief Relax only the neighborhood of the conflict found by the last failed call to resolve. Active tokens in that
+     * neighborhood are cancelled at the root of their uncommitted master chain. Committed values and observations are left alone.
+     * @return true if something was relaxed and the database is consistent, otherwise false, in which case a global relax is required.
+     * @see relax
+     */
+    bool relaxLocal();
+
+    /**
+     * @brief Rebuild the database from a checkpoint. Current values are copied and inserted, current observations
+     * buffered, the plan is laid out again after the current values in its recorded order, with its dispatched
+     * tokens marked as such, and open goals are posted again for planning.
+     * @param state The tokens written by DbCore::checkpoint
+     * @param restored Filled with the restored tokens, by their key in the checkpoint
+     * @pre The database holds no token and the current tick is the one following the checkpoint.
+     * @return true if the current values and the plan could be inserted, otherwise false
+     * @see relax, copyValue
+     */
+    bool restore(const Checkpoint::Reactor& state, std::map<uint32_t, TokenId>& restored);
+
+    /**
+     * @brief Called by the DbCore when a token enters the token agenda. Schedules it for evaluation.
+     */
+    void handleAgendaAddition(const TokenId& token);
+
+    /**
+     * @brief Called by the DbCore when a token leaves the token agenda.
+     */
+    void handleAgendaRemoval(const TokenId& token);
+
 
     /** UTILITIES FOR ANALYSIS OF FAILURES **/
     std::string tokenResolutionFailure(const TokenId& tokenToResolve, const TokenId& merge_candidate) const;
@@ -71,6 +105,68 @@ namespace TREX {
     std::string analysisOfBlockingToken(const TokenId& tokenToResolve) const;
   private:
 
+    /**
+     * @brief Re-schedules agenda tokens when the domains defining their synchronization scope change.
+     */
+    class CeListener: public ConstraintEngineListener {
+    public:
+      CeListener(const ConstraintEngineId& ce, Synchronizer& synchronizer);
+
+      void notifyChanged(const ConstrainedVariableId& variable, const DomainListener::ChangeType& changeType);
+
+    private:
+      Synchronizer& m_synchronizer;
+    };
+
+    friend class Synchronizer::CeListener;
+
+    /**
+     * @brief Handle a change on a token variable. Only object, start and end variables of agenda tokens matter.
+     */
+    void handleChange(const ConstrainedVariableId& variable);
+
+    /**
+     * @brief Place a token on the work queue, ordered by earliest start. A queued token is moved if its start changed.
+     */
+    void schedule(int key, const TokenId& token);
+
+    /**
+     * @brief Remove a token from the work queue if it is there.
+     */
+    void unschedule(int key);
+
+    /**
+     * @brief Hold a token that was not in synchronization scope until its timeline changes.
+     */
+    void park(const TokenId& token);
+
+    /**
+     * @brief Re-schedule tokens parked on the timeline of a token just resolved.
+     */
+    void releaseParked(const TokenId& token);
+
+    /**
+     * @brief Record the given token and the tokens it shares constraints with as the neighborhood of a conflict.
+     * @see relaxLocal
+     */
+    void recordConflict(const TokenId& token);
+
+    /**
+     * @brief Record the neighborhood of every empty variable if the constraint network is inconsistent.
+     * @see relaxLocal
+     */
+    void recordPropagationConflict();
+
+    /**
+     * @brief Record the tokens connected to the given variable through its constraints.
+     */
+    void recordNeighborhood(const ConstrainedVariableId& var);
+
+    /**
+     * @brief Reset the work queue to contain the whole token agenda. Used when the tick, and hence the scope, changes.
+     */
+    void resetQueue();
+
     /**
      * @brief Resolve all tokens at the execution frontier.
      */
@@ -172,6 +268,14 @@ namespace TREX {
     TokenSet& m_observations; /*!< Store received observations received */
     TokenSet& m_tokenAgenda; /*!< Buffer of tokens available for synchronization */
     TokenSet& m_committedTokens; /*!< Buffer of committed tokens */
+
+    CeListener m_ceListener; /*!< Feeds domain changes into the work queue */
+    std::map<int, TokenId> m_agendaIndex; /*!< Tokens on the agenda, by key */
+    std::set< std::pair<double, int> > m_queue; /*!< Work queue of (earliest start, token key) */
+    std::map<int, double> m_queuedAt; /*!< Priority each queued token was scheduled with */
+    std::map<int, std::set<int> > m_parked; /*!< Out of scope token keys, by timeline key */
+    std::set<int> m_conflictKeys; /*!< Keys of tokens in the neighborhood of the last synchronization failure */
+    unsigned int m_resolveCount, m_resetCount, m_tokenCount; /*!< Counters to aid with setting debug breakpoints */
   };
 
 }
@@ -48,8 +48,10 @@
 #include "Token.hh"
 #include "Utils.hh"
 #include "Utilities.hh"
+#include "DebugStream.hh"
 
 #include <time.h>
+#include <cmath>
 
 
 namespace TREX {
@@ -129,8 +131,16 @@ namespace TREX {
       m_thisObserver(new TeleoObserver(m_id)),
       m_thisServer(new TeleoServer(m_id)),
       m_syncUsage(RStat::zeroed), m_searchUsage(RStat::zeroed),
+      m_stepSamples(0), m_deferredCount(0), m_stepMean(0.0), m_stepDev(0.0),
+      m_stepDeferred(false), m_deferredTick(0), m_tickSearchTime(0.0),
+      m_share(string_cast<double>(1.0, checked_string(configData.Attribute("share")))),
       m_shouldLog(string_cast<bool>(logDefault, checked_string(configData.Attribute("log")))),
+      m_traceId(TraceLog::reactorId(m_name)),
+      m_tickStartLatency(addLatencyPhase("handleTickStart")),
+      m_syncLatency(addLatencyPhase("synchronize")),
+      m_resumeLatency(addLatencyPhase("resume")),
       m_debugStream(debugFileName(m_agentName, m_name).c_str()) {
+    checkError(m_share > 0.0, "Reactor " << m_name.toString() << " share must be positive");
     TREX_INFO("TeleoReactor:TeleoReactor", "Allocating '" << agentName.toString() << "." << m_name.toString());
   }
 
@@ -143,10 +153,17 @@ namespace TREX {
       m_thisObserver(new TeleoObserver(m_id)),
       m_thisServer(new TeleoServer(m_id)),
       m_syncUsage(RStat::zeroed), m_searchUsage(RStat::zeroed),
+      m_stepSamples(0), m_deferredCount(0), m_stepMean(0.0), m_stepDev(0.0),
+      m_stepDeferred(false), m_deferredTick(0), m_tickSearchTime(0.0),
+      m_share(1.0),
       m_shouldLog(log),
+      m_traceId(TraceLog::reactorId(m_name)),
+      m_tickStartLatency(addLatencyPhase("handleTickStart")),
+      m_syncLatency(addLatencyPhase("synchronize")),
+      m_resumeLatency(addLatencyPhase("resume")),
       m_debugStream(debugFileName(m_agentName, m_name).c_str())
  {
-    DebugMessage::setStream(getStream());
+    DebugStream::select(getStream());
     TREX_INFO("TeleoReactor:TeleoReactor", "Allocating '" << agentName.toString() << "." << m_name.toString());
   }
 
@@ -160,14 +177,22 @@ namespace TREX {
       m_thisObserver(new TeleoObserver(m_id)),
       m_thisServer(new TeleoServer(m_id)),
       m_syncUsage(RStat::zeroed), m_searchUsage(RStat::zeroed),
+      m_stepSamples(0), m_deferredCount(0), m_stepMean(0.0), m_stepDev(0.0),
+      m_stepDeferred(false), m_deferredTick(0), m_tickSearchTime(0.0),
+      m_share(string_cast<double>(1.0, checked_string(configData.Attribute("share")))),
       m_shouldLog(string_cast<bool>(logDefault, checked_string(configData.Attribute("log")))), 
+      m_traceId(TraceLog::reactorId(m_name)),
+      m_tickStartLatency(addLatencyPhase("handleTickStart")),
+      m_syncLatency(addLatencyPhase("synchronize")),
+      m_resumeLatency(addLatencyPhase("resume")),
       m_debugStream(debugFileName(m_agentName, m_name).c_str()){
-    DebugMessage::setStream(getStream());
+    checkError(m_share > 0.0, "Reactor " << m_name.toString() << " share must be positive");
+    DebugStream::select(getStream());
     TREX_INFO("TeleoReactor:TeleoReactor", "Allocating '" << agentName.toString() << "." << m_name.toString());
   }
 
   TeleoReactor::~TeleoReactor(){
-    DebugMessage::setStream(Agent::instance()->getStream());
+    DebugStream::select(Agent::instance()->getStream());
     m_thisObserver.release();
     m_thisServer.release();
     m_id.remove();
@@ -234,9 +259,10 @@ namespace TREX {
   }
 
   bool TeleoReactor::doSynchronize() {
-    DebugMessage::setStream(getStream());
+    DebugStream::select(getStream());
     ++m_syncCount;    
     RStatLap chrono(m_syncUsage, RStat::self);
+    LatencyLap lap(m_syncLatency);
     { // To be "sure" that chrono is created before we call synchronize
       TREX_INFO("trex:debug:timing", "BEFORE synchronization:" << timeString());
       bool result = synchronize();
@@ -246,21 +272,54 @@ namespace TREX {
   }
 
   void TeleoReactor::doResume() {
-    DebugMessage::setStream(getStream());
+    DebugStream::select(getStream());
 
     ++m_searchCount;
-    RStatLap chrono(m_searchUsage, RStat::self);
+    RStat step(RStat::zeroed);
     {
+      RStatLap chrono(step, RStat::self);
+      LatencyLap lap(m_resumeLatency);
       TREX_INFO("trex:debug:timing", "BEFORE resume:" << timeString());
       resume();
       TREX_INFO("trex:debug:timing", "AFTER resume:" << timeString());
     }
+    m_searchUsage = m_searchUsage+step;
+    m_stepDeferred = false;
+
+    double cost = step.wall_time().tv_sec + step.wall_time().tv_usec*1e-6;
+    m_tickSearchTime += cost;
+    if(m_stepSamples++ == 0){
+      m_stepMean = cost;
+      m_stepDev = cost/2;
+    }
+    else {
+      double err = cost - m_stepMean;
+      m_stepMean += err/8;
+      m_stepDev += (std::fabs(err) - m_stepDev)/4;
+    }
+  }
+
+  double TeleoReactor::getStepCostEstimate() const {
+    return m_stepMean + 2*m_stepDev;
+  }
+
+  void TeleoReactor::deferStep() {
+    ++m_deferredCount;
+    if(!m_stepDeferred){
+      m_stepDeferred = true;
+      m_deferredTick = getCurrentTick();
+    }
+    TREX_INFO("trex:debug:timing", "Deferred a step estimated to " << getStepCostEstimate() << " secs.");
+  }
+
+  bool TeleoReactor::isStepOverdue() const {
+    return m_stepDeferred && m_deferredTick < getCurrentTick();
   }
 
   void TeleoReactor::doHandleInit(TICK initialTick, 
 				   std::map<double, ServerId> const &serversByTimeline, 
 				   ObserverId const &observer) {
-    DebugMessage::setStream(getStream());
+    DebugStream::select(getStream());
 
     m_syncCount = 0;
     m_syncUsage.reset();
@@ -270,22 +329,60 @@ namespace TREX {
 
     log->addField(getName().toString()+".sync.nSyncs", m_syncCount);
     log->addField(getName().toString()+".sync.userTime", m_syncUsage.user_time());
+    log->addField(getName().toString()+".sync.wallTime", m_syncUsage.wall_time());
+    log->addField(getName().toString()+".sync.threadTime", m_syncUsage.thread_time());
     log->addField(getName().toString()+".search.nResume", m_searchCount);
     log->addField(getName().toString()+".search.userTime", m_searchUsage.user_time());
+    log->addField(getName().toString()+".search.wallTime", m_searchUsage.wall_time());
+    log->addField(getName().toString()+".search.threadTime", m_searchUsage.thread_time());
+    log->addField(getName().toString()+".search.involCtxSwitches", m_searchUsage.n_involuntary_switches());
+    log->addField(getName().toString()+".search.stepCost", m_stepMean);
+    log->addField(getName().toString()+".search.nDeferred", m_deferredCount);
 
     handleInit(initialTick, serversByTimeline, observer);
   }
 
+  void TeleoReactor::doCompact() {
+    DebugStream::select(getStream());
+    compact();
+  }
+
   void TeleoReactor::doHandleTickStart() {
-    DebugMessage::setStream(getStream());
+    DebugStream::select(getStream());
 
     m_syncCount = 0;
     m_syncUsage.reset();
     m_searchCount = 0;
     m_searchUsage.reset();
+    m_tickSearchTime = 0.0;
+
+    LatencyLap lap(m_tickStartLatency);
     handleTickStart();
   }
 
+  LatencyHistogram& TeleoReactor::addLatencyPhase(const std::string& name){
+    m_latencyTotal.push_back(LatencyHistogram(name));
+    m_latency.push_back(LatencyHistogram(name));
+    return m_latency.back();
+  }
+
+  void TeleoReactor::addStartupPhase(const std::string& name, uint64_t nsec){
+    m_startupPhases.push_back(std::make_pair(name, nsec));
+  }
+
+  void TeleoReactor::reportLatency(std::ostream& out, bool final){
+    std::list<LatencyHistogram>::iterator total = m_latencyTotal.begin();
+    for(std::list<LatencyHistogram>::iterator it = m_latency.begin(); it != m_latency.end(); ++it, ++total){
+      total->add(*it);
+      const LatencyHistogram& h = (final ? *total : *it);
+      out << (final ? "total" : "interval") << '\t' << getCurrentTick() << '\t' 
+	  << getName().toString() << '\t' << h.name() << '\t';
+      h.print(out);
+      out << std::endl;
+      it->reset();
+    }
+  }
+
   /**
    * @brief Handle in the derived class if provided
    */
@@ -295,7 +392,7 @@ namespace TREX {
    * @brief Log the request prior to delegation
    */
   bool TeleoReactor::request(const TokenId& goal){
-    DebugMessage::setStream(getStream());
+    DebugStream::select(getStream());
     Agent::instance()->logRequest(goal);
     TREXLog() << nameString() << "Request received: " << tokenToString(goal);
     return handleRequest(goal);
@@ -311,7 +408,7 @@ namespace TREX {
    */
   void TeleoReactor::recall(const TokenId& goal){
     Agent::instance()->logRecall(goal);
-    DebugMessage::setStream(getStream());
+    DebugStream::select(getStream());
     TREXLog() << nameString() << "Recall received: " << tokenToString(goal) << std::endl;
     handleRecall(goal);
   }
@@ -329,6 +426,10 @@ namespace TREX {
     return m_lookAhead;
   }
 
+  TICK TeleoReactor::getPlanningDeadline() const {
+    return getCurrentTick() + getLatency();
+  }
+
   std::ostream& TeleoReactor::getStream(){
     return m_debugStream;
   }
@@ -45,9 +45,12 @@
 #include "Observer.hh"
 #include "LogManager.hh"
 #include "RStat.hh"
+#include "TraceLog.hh"
+#include "LatencyHistogram.hh"
 
 #include <list>
 #include <map>
+#include <vector>
 
 namespace TREX {
 
@@ -109,6 +112,13 @@ namespace TREX {
      */
     virtual void notify(const Observation& observation);
 
+    /**
+     * @brief Test if an observation from outside the agent could be handled by notify.
+     * @return false if the reactor observes the timeline but the observation does not fit its model. Defaults to true.
+     * @see Agent::isValidObservation
+     */
+    virtual bool isValidObservation(const Observation& observation) const {return true;}
+
     /**
      * @brief Commands the server to handle a request expressed as a goal network.
      * @param goal The goal token.
@@ -132,6 +142,18 @@ namespace TREX {
      */
     TICK getLookAhead() const;
 
+    /**
+     * @brief Relative share of the deliberation time this reactor should get under the weighted agenda policy.
+     * Set with the share attribute of the reactor configuration. Defaults to 1.
+     */
+    double getShare() const {return m_share;}
+
+    /**
+     * @brief The tick by which the current deliberation has to be complete. Used by the deadline agenda policy.
+     * Defaults to the current tick plus latency.
+     */
+    virtual TICK getPlanningDeadline() const;
+
     /**
      * @brief Retrieves the timelines according to each mode.
      * @param externals Results for all timelines which are externally owned. Will dispatch goals and synchronize with observations.
@@ -144,6 +166,12 @@ namespace TREX {
       return m_shouldLog;
     }
 
+    /**
+     * @brief Identifier of this reactor in trace records
+     * @see TraceLog
+     */
+    uint16_t getTraceId() const {return m_traceId;}
+
     static TeleoReactorId createInstance(const LabelStr& agentName, const LabelStr& component, const TiXmlElement& configData);
 
     /**
@@ -213,6 +241,67 @@ namespace TREX {
 
     void doResume();
 
+    /**
+     * @brief Expected wall time of the next doResume, in seconds.
+     * Mean plus twice the mean deviation of the previous steps, smoothed as for TCP round trip times.
+     * @return 0 before the first step.
+     */
+    double getStepCostEstimate() const;
+
+    /**
+     * @brief Wall time spent in doResume since the start of the tick, in seconds.
+     */
+    double getTickSearchTime() const {return m_tickSearchTime;}
+
+    /**
+     * @brief Called by the agent when it did not resume this reactor because the step would not fit in the tick.
+     */
+    void deferStep();
+
+    /**
+     * @brief True if a step deferred on an earlier tick has not run since. The agent runs it whatever its estimate,
+     * so that a reactor whose steps take most of a tick is not starved by the reactors that synchronize before it.
+     */
+    bool isStepOverdue() const;
+
+    /**
+     * @brief Number of steps deferred by the agent since the start of the mission.
+     */
+    size_t getDeferredCount() const {return m_deferredCount;}
+
+    /**
+     * @brief Release the bookkeeping no longer needed by the reactor. Called periodically by the agent
+     * in bounded memory mode.
+     * @see compact()
+     */
+    void doCompact();
+
+    /**
+     * @brief The reactor keeps nothing that ended before this tick. By default, it keeps no history at all.
+     * @see compact()
+     */
+    virtual TICK getArchiveFrontier() const {return getCurrentTick();}
+
+    /**
+     * @brief Write latency percentiles for each phase of this reactor, one line per phase.
+     * @param out The output stream
+     * @param final If false, report the samples since the last report. If true, report all the samples of the run.
+     * @see LatencyHistogram
+     */
+    void reportLatency(std::ostream& out, bool final);
+
+    /**
+     * @brief Record how long a step of the construction or initialization of this reactor took.
+     * @param name The name of the step in startup.log
+     * @param nsec The duration in nanoseconds
+     */
+    void addStartupPhase(const std::string& name, uint64_t nsec);
+
+    /**
+     * @brief Steps recorded with addStartupPhase, in the order they were recorded.
+     */
+    const std::vector<std::pair<std::string, uint64_t> >& getStartupPhases() const {return m_startupPhases;}
+
 
   protected:
     /**
@@ -246,6 +335,11 @@ namespace TREX {
      */
     virtual void resume() = 0;
 
+    /**
+     * @brief Drop what is kept about the past and cannot affect the present or the future.
+     */
+    virtual void compact(){}
+
     /**
      * @brief Constructor will set the timing parameters
      * @param configData xml configuration element.
@@ -274,6 +368,13 @@ namespace TREX {
      */
     TeleoReactor(const LabelStr& agentName, const TiXmlElement& configData, TICK lookAhead, TICK latency, bool logDefault=false);
 
+    /**
+     * @brief Declare a phase whose latency is to be reported.
+     * @param name The name of the phase in the report
+     * @return The histogram to record the phase in, with a LatencyLap. It lasts as long as the reactor.
+     */
+    LatencyHistogram& addLatencyPhase(const std::string& name);
+
   private:
     static TICK getLookAheadFromXML(const TiXmlElement& configData);
     static std::string debugFileName(const LabelStr& agentName, const LabelStr& reactorName);
@@ -287,8 +388,21 @@ namespace TREX {
 
     size_t m_syncCount, m_searchCount;
     RStat m_syncUsage, m_searchUsage;
+    size_t m_stepSamples, m_deferredCount; /*!< Steps measured, and steps deferred by the agent */
+    double m_stepMean, m_stepDev; /*!< Smoothed duration of a step and its mean deviation, in seconds */
+    bool m_stepDeferred; /*!< True from a deferred step until the next doResume */
+    TICK m_deferredTick; /*!< Tick of the first deferral since the last doResume */
+    double m_tickSearchTime; /*!< Wall time of the steps of this tick, in seconds */
+    double const m_share;
 
     bool const m_shouldLog;
+    uint16_t const m_traceId;
+    std::list<LatencyHistogram> m_latency; /*!< Phase latencies since the last report */
+    std::list<LatencyHistogram> m_latencyTotal; /*!< Phase latencies over the run, in the same order */
+    LatencyHistogram& m_tickStartLatency;
+    LatencyHistogram& m_syncLatency;
+    LatencyHistogram& m_resumeLatency;
+    std::vector<std::pair<std::string, uint64_t> > m_startupPhases; /*!< Startup steps and their durations in nanoseconds */
     std::ofstream m_debugStream;
 
   };
@@ -52,10 +52,13 @@ using namespace TREX;
 
 // structors :
 
-TextLog::TextLog() {}
+TextLog::TextLog()
+  :m_open(false), m_enabled(true) {}
 
 TextLog::TextLog(std::string const &name)
-  :m_log(name.c_str()) {}
+  :m_log(name.c_str()), m_enabled(true) {
+  m_open = m_log.is_open();
+}
 
 TextLog::~TextLog() {}
 
@@ -65,6 +68,7 @@ void TextLog::open(std::string const &name) {
   Guardian<Mutex> guard(m_lock);
   
   m_log.open(name.c_str());
+  m_open = m_log.is_open();
 }
 
 void TextLog::write(std::string const &text) {
@@ -104,6 +104,25 @@ namespace TREX {
      */
     void open(std::string const &file);
 
+    /** @brief Check if entries are written
+     *
+     * @retval true if a file is open and the log was not disabled
+     * @retval false otherwise. Callers should then skip formatting their entry.
+     *
+     * @sa setEnabled(bool)
+     * @sa TREXLog()
+     */
+    bool isEnabled() const {
+      return m_open && m_enabled;
+    }
+    /** @brief Enable or disable the log
+     *
+     * @param enabled new state
+     */
+    void setEnabled(bool enabled) {
+      m_enabled = enabled;
+    }
+
   private:
     /** @brief stream mutex
      *
@@ -115,6 +134,10 @@ namespace TREX {
      * This is the file that will be updated by TextLog::write.
      */
     std::ofstream m_log;
+    /** @brief Is there a file open */
+    bool m_open;
+    /** @brief Set by setEnabled */
+    bool m_enabled;
 
     /** @brief Physical log writing
      *
@@ -112,6 +112,64 @@ void Thread::yield() {
   ::sched_yield();
 }
 
+namespace {
+
+  /** @brief Fill a CPU set from CPU indices */
+  void toCpuSet(std::vector<int> const &cpus, cpu_set_t &set, std::string const &from) {
+    CPU_ZERO(&set);
+    for(std::vector<int>::const_iterator i=cpus.begin(); cpus.end()!=i; ++i) {
+      if( *i<0 || *i>=CPU_SETSIZE )
+	throw ErrnoExcept(from, "CPU index out of range");
+      CPU_SET(*i, &set);
+    }
+  }
+
+} // <unnamed>
+
+void Thread::setCurrentAffinity(std::vector<int> const &cpus) {
+  cpu_set_t set;
+  toCpuSet(cpus, set, "Thread::setCurrentAffinity");
+  int ret = ::pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+  if( 0!=ret ) {
+    errno = ret;
+    throw ErrnoExcept("Thread::setCurrentAffinity");
+  }
+}
+
+std::vector<int> Thread::getCurrentAffinity() {
+  cpu_set_t set;
+  int ret = ::pthread_getaffinity_np(pthread_self(), sizeof(set), &set);
+  if( 0!=ret ) {
+    errno = ret;
+    throw ErrnoExcept("Thread::getCurrentAffinity");
+  }
+  std::vector<int> cpus;
+  for(int i=0; i<CPU_SETSIZE; ++i)
+    if( CPU_ISSET(i, &set) )
+      cpus.push_back(i);
+  return cpus;
+}
+
+void Thread::setCurrentScheduling(Thread::Policy policy, int priority) {
+  sched_param param;
+  param.sched_priority = priority;
+  int ret = ::pthread_setschedparam(pthread_self(), policy, &param);
+  if( 0!=ret ) {
+    errno = ret;
+    throw ErrnoExcept("Thread::setCurrentScheduling");
+  }
+}
+
+void Thread::getCurrentScheduling(int &policy, int &priority) {
+  sched_param param;
+  int ret = ::pthread_getschedparam(pthread_self(), &policy, &param);
+  if( 0!=ret ) {
+    errno = ret;
+    throw ErrnoExcept("Thread::getCurrentScheduling");
+  }
+  priority = param.sched_priority;
+}
+
 // Structors :
 
 Thread::Thread() 
@@ -143,6 +201,30 @@ void Thread::setStackSize(size_t size) {
     throw ErrnoExcept("Thread::setStackSize");
 }
 
+void Thread::setAffinity(std::vector<int> const &cpus) {
+  cpu_set_t set;
+  toCpuSet(cpus, set, "Thread::setAffinity");
+  int ret = ::pthread_attr_setaffinity_np(&m_attr, sizeof(set), &set);
+  if( 0!=ret ) {
+    errno = ret;
+    throw ErrnoExcept("Thread::setAffinity");
+  }
+}
+
+void Thread::setScheduling(Thread::Policy policy, int priority) {
+  sched_param param;
+  param.sched_priority = priority;
+  int ret = ::pthread_attr_setinheritsched(&m_attr, PTHREAD_EXPLICIT_SCHED);
+  if( 0==ret )
+    ret = ::pthread_attr_setschedpolicy(&m_attr, policy);
+  if( 0==ret )
+    ret = ::pthread_attr_setschedparam(&m_attr, &param);
+  if( 0!=ret ) {
+    errno = ret;
+    throw ErrnoExcept("Thread::setScheduling");
+  }
+}
+
 // Manipulators :
 
 void Thread::start() {
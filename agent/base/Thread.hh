@@ -45,6 +45,10 @@
 
 #include "MutexWrapper.hh"
 
+#include <vector>
+
+#include <sched.h>
+
 namespace TREX {
 
   class ThreadImpl;
@@ -95,6 +99,15 @@ namespace TREX {
       detached = PTHREAD_CREATE_DETACHED //!< Thread is detached
     }; // Thread::DetachState
 
+    /** @brief Thread scheduling policy.
+     *
+     * This type is used to set/know the scheduling policy of a Thread.
+     */
+    enum Policy {
+      otherPolicy = SCHED_OTHER, //!< Default time sharing
+      fifoPolicy = SCHED_FIFO //!< Real-time first in first out
+    }; // Thread::Policy
+
     /** @brief Constructor.
      *
      * Create a new thread.
@@ -150,6 +163,28 @@ namespace TREX {
      */
     void setStackSize(size_t size);
 
+    /** @brief Set thread CPU affinity.
+     *
+     * @param cpus The indices of the CPUs the thread may run on
+     *
+     * @pre The Thread is not runnning yet.
+     *
+     * @throw ErrnoExcept Error while trying to change thread affinity.
+     */
+    void setAffinity(std::vector<int> const &cpus);
+    /** @brief Set thread scheduling.
+     *
+     * @param policy A scheduling policy
+     * @param priority A priority valid for @e policy. 0 for Thread::otherPolicy
+     *
+     * The thread will not inherit the scheduling of its creator.
+     *
+     * @pre The Thread is not runnning yet.
+     *
+     * @throw ErrnoExcept Error while trying to change thread scheduling.
+     */
+    void setScheduling(Policy policy, int priority);
+
     /** @brief Get thread scope.
      *
      * @return current instance thread scope.
@@ -212,6 +247,38 @@ namespace TREX {
      */
     static pthread_t current(); 
 
+    /** @brief Set the caller CPU affinity.
+     *
+     * @param cpus The indices of the CPUs the caller may run on
+     *
+     * @throw ErrnoExcept Error while trying to change the affinity.
+     */
+    static void setCurrentAffinity(std::vector<int> const &cpus);
+    /** @brief Get the caller CPU affinity.
+     *
+     * @return The indices of the CPUs the caller may run on
+     *
+     * @throw ErrnoExcept Error while trying to get the affinity.
+     */
+    static std::vector<int> getCurrentAffinity();
+    /** @brief Set the caller scheduling.
+     *
+     * @param policy A scheduling policy
+     * @param priority A priority valid for @e policy. 0 for Thread::otherPolicy
+     *
+     * @throw ErrnoExcept Error while trying to change the scheduling,
+     * typically EPERM when the process lacks real-time privileges.
+     */
+    static void setCurrentScheduling(Policy policy, int priority);
+    /** @brief Get the caller scheduling.
+     *
+     * @param[out] policy The scheduling policy
+     * @param[out] priority The priority
+     *
+     * @throw ErrnoExcept Error while trying to get the scheduling.
+     */
+    static void getCurrentScheduling(int &policy, int &priority);
+
     /** @brief exit function.
      *
      * @param ret A return value.
@@ -0,0 +1,350 @@
+/*********************************************************************
+* Software License Agreement (BSD License)
+* 
+*  Copyright (c) 2007. MBARI.
+*  All rights reserved.
+* 
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+* 
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the TREX Project nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+* 
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* -*- C++ -*-
+ * $Id$
+ */
+/** @file "TraceLog.cc"
+ */
+#include <fstream>
+
+#include <pthread.h>
+#include <time.h>
+
+#include "Debug.hh"
+#include "Guardian.hh"
+#include "MutexWrapper.hh"
+
+#include "TraceLog.hh"
+
+using namespace TREX;
+
+namespace {
+
+  struct EventInfo {
+    TraceEvent event;
+    TraceCategory category;
+    char const *marker;
+    char const *text;
+  };
+
+  /* Rendering of each event by trextrace. {key} and {arg} are replaced
+   * by the fields of the record. Must follow the order of TraceEvent. */
+  EventInfo const sl_events[] = {
+    {TRACE_SYNCH_RESOLVE, TRACE_SYNCHRONIZATION, "trex:debug:synchronization", 
+     "Starting synchronization with {arg} tokens on the agenda"},
+    {TRACE_SYNCH_RESOLVED, TRACE_SYNCHRONIZATION, "trex:debug:synchronization", 
+     "Synchronization succeeded in {arg} steps"},
+    {TRACE_SYNCH_FAILED, TRACE_SYNCHRONIZATION, "trex:debug:synchronization", 
+     "Synchronization failed after {arg} steps"},
+    {TRACE_SYNCH_EVALUATE, TRACE_SYNCHRONIZATION, "trex:debug:synchronization:resolveTokens", 
+     "Evaluating token({key})"},
+    {TRACE_SYNCH_PARK, TRACE_SYNCHRONIZATION, "trex:debug:synchronization:resolveTokens", 
+     "Excluding token({key}) until its timeline changes"},
+    {TRACE_SYNCH_RESOLVE_TOKEN, TRACE_SYNCHRONIZATION, "trex:debug:synchronization:resolveTokens", 
+     "Resolving token({key})"},
+    {TRACE_SYNCH_MERGE, TRACE_SYNCHRONIZATION, "trex:debug:synchronization:mergeToken", 
+     "Merging token({key}) onto token({arg})"},
+    {TRACE_SYNCH_INSERT, TRACE_SYNCHRONIZATION, "trex:debug:synchronization:insertToken", 
+     "Inserting token({key})"},
+    {TRACE_SYNCH_SKIP_PAST, TRACE_SYNCHRONIZATION, "trex:debug:synchronization:insertToken", 
+     "Skipping insertion of token({key}) which is in the past."},
+    {TRACE_SYNCH_INSERT_DEFAULT, TRACE_SYNCHRONIZATION, "trex:debug:synchronization:insertDefaultValue", 
+     "Insert token({key}) On timeline({arg})"},
+    {TRACE_SYNCH_CONFLICT, TRACE_SYNCHRONIZATION, "trex:monitor:conflicts", 
+     "Failed to resolve token({key})"},
+    {TRACE_RELAX_START, TRACE_RELAX, "trex:debug:synchronization:relax", 
+     "START discarding current values: {arg}"},
+    {TRACE_RELAX_CANCEL, TRACE_RELAX, "trex:debug:synchronization:relaxLocal", 
+     "Cancelling token({key})"},
+    {TRACE_RELAX_COPY, TRACE_RELAX, "trex:debug:synchronization:copyValue", 
+     "Replaced token({key}) with token({arg})"},
+    {TRACE_RELAX_END, TRACE_RELAX, "trex:debug:synchronization:relax", 
+     "END success: {arg}"},
+    {TRACE_AGENDA_ADD, TRACE_TOKEN_AGENDA, "trex:debug:tokenAgenda:addToTokenAgenda", 
+     "token({key})"},
+    {TRACE_AGENDA_REMOVE, TRACE_TOKEN_AGENDA, "trex:debug:tokenAgenda:removeFromTokenAgenda", 
+     "token({key})"},
+    {TRACE_DBCORE_OBSERVATION, TRACE_DBCORE, "trex:info:trace", 
+     "Observation token({key}) with {arg} parameters"},
+    {TRACE_DBCORE_COMMIT, TRACE_DBCORE, "trex:debug:synchronization:commitAndRestrict", 
+     "Committing token({key})"},
+    {TRACE_DBCORE_EXTEND, TRACE_DBCORE, "DbCore:extendCurrentValue:token", 
+     "Extending token({key}) for end >= {arg}"},
+    {TRACE_DBCORE_ARCHIVE, TRACE_DBCORE, "DbCore:archive", 
+     "token({key}) is a candidate for termination."},
+    {TRACE_DBCORE_INVALID, TRACE_DBCORE, "trex:warning", 
+     "Database marked invalid"},
+    {TRACE_DISPATCH_REQUEST, TRACE_DISPATCH, "trex:dispatching", 
+     "Dispatching token({key})"},
+    {TRACE_DISPATCH_RECALL, TRACE_DISPATCH, "trex:dispatching", 
+     "Recalling token({key})"}
+  };
+
+  char const *sl_categories[] = {
+    "synchronization", "relax", "tokenAgenda", "dbcore", "dispatch"
+  };
+
+  char const TRACE_MAGIC[] = "TRXTRACE";
+  uint32_t const TRACE_VERSION = 1;
+
+  Mutex &traceMutex() {
+    static Mutex sl_mutex;
+    return sl_mutex;
+  }
+
+  std::vector<std::string> &reactorNames() {
+    static std::vector<std::string> sl_names;
+    return sl_names;
+  }
+
+  void writeU32(std::ostream &out, uint32_t val) {
+    out.write(reinterpret_cast<char const *>(&val), sizeof(val));
+  }
+
+  void writeString(std::ostream &out, std::string const &str) {
+    writeU32(out, str.length());
+    out.write(str.data(), str.length());
+  }
+
+}
+
+/*
+ * class TraceLog::Buffer
+ */
+class TraceLog::Buffer {
+public:
+  Buffer(uint32_t thread, size_t capacity)
+    :m_thread(thread), m_records(capacity), m_next(0), m_wrapped(false) {}
+  
+  void push(TraceRecord const &rec) {
+    m_records[m_next] = rec;
+    if( ++m_next==m_records.size() ) {
+      m_next = 0;
+      m_wrapped = true;
+    }
+  }
+  
+  /* Oldest record first */
+  void write(std::ostream &out) const {
+    writeU32(out, m_thread);
+    if( m_wrapped ) {
+      writeU32(out, m_records.size());
+      out.write(reinterpret_cast<char const *>(&m_records[m_next]), 
+		(m_records.size()-m_next)*sizeof(TraceRecord));
+    } else
+      writeU32(out, m_next);
+    out.write(reinterpret_cast<char const *>(&m_records[0]), 
+	      m_next*sizeof(TraceRecord));
+  }
+
+  void copy(std::vector<TraceRecord> &out) const {
+    if( m_wrapped )
+      out.insert(out.end(), m_records.begin()+m_next, m_records.end());
+    out.insert(out.end(), m_records.begin(), m_records.begin()+m_next);
+  }
+
+  void clear(size_t capacity) {
+    m_records.resize(capacity);
+    m_next = 0;
+    m_wrapped = false;
+  }
+
+  static std::vector<Buffer *> &all() {
+    static std::vector<Buffer *> sl_buffers;
+    return sl_buffers;
+  }
+
+private:
+  uint32_t const m_thread;
+  std::vector<TraceRecord> m_records;
+  size_t m_next;
+  bool m_wrapped;
+}; // TREX::TraceLog::Buffer
+
+/*
+ * class TraceLog
+ */
+
+// statics :
+
+unsigned TraceLog::s_mask(0);
+size_t TraceLog::s_capacity(1<<16);
+
+namespace {
+  pthread_key_t sl_bufferKey;
+  pthread_once_t sl_bufferKeyOnce = PTHREAD_ONCE_INIT;
+
+  void createBufferKey() {
+    pthread_key_create(&sl_bufferKey, NULL);
+  }
+}
+
+TraceLog::Buffer &TraceLog::buffer() {
+  pthread_once(&sl_bufferKeyOnce, createBufferKey);
+  Buffer *buf = static_cast<Buffer *>(pthread_getspecific(sl_bufferKey));
+
+  if( NULL==buf ) {
+    // Buffers are kept after the thread exits so they can still be dumped
+    Guardian<Mutex> guard(traceMutex());
+    buf = new Buffer(Buffer::all().size(), s_capacity);
+    Buffer::all().push_back(buf);
+    pthread_setspecific(sl_bufferKey, buf);
+  }
+  return *buf;
+}
+
+void TraceLog::enable(TraceCategory category) {
+  s_mask |= (1u<<category);
+}
+
+void TraceLog::disable(TraceCategory category) {
+  s_mask &= ~(1u<<category);
+}
+
+void TraceLog::enable(std::string const &names) {
+  size_t pos = 0;
+  
+  while( pos<=names.length() ) {
+    size_t next = names.find(',', pos);
+    if( std::string::npos==next )
+      next = names.length();
+    std::string name(names, pos, next-pos);
+
+    if( "all"==name ) 
+      s_mask = ~0u;
+    else if( !name.empty() ) {
+      unsigned i;
+      for(i=0; i<TRACE_CATEGORY_COUNT && name!=sl_categories[i]; ++i);
+      checkError(i<TRACE_CATEGORY_COUNT, "TraceLog: unknown trace category \""<<name<<'\"');
+      enable(static_cast<TraceCategory>(i));
+    }
+    pos = next+1;
+  }
+}
+
+void TraceLog::setCapacity(size_t capacity) {
+  checkError(capacity>0, "TraceLog: capacity must be positive");
+  s_capacity = capacity;
+}
+
+uint16_t TraceLog::reactorId(LabelStr const &name) {
+  Guardian<Mutex> guard(traceMutex());
+  std::vector<std::string> &names = reactorNames();
+  std::string const &str = name.toString();
+  uint16_t i;
+
+  for(i=0; i<names.size() && names[i]!=str; ++i);
+  if( i==names.size() )
+    names.push_back(str);
+  return i;
+}
+
+void TraceLog::record(TraceCategory category, TraceEvent event, TICK tick,
+		      uint16_t reactor, int key, int arg) {
+  TraceRecord rec;
+  timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  rec.nsec = static_cast<uint64_t>(now.tv_sec)*1000000000ull+now.tv_nsec;
+  rec.tick = tick;
+  rec.key = key;
+  rec.arg = arg;
+  rec.reactor = reactor;
+  rec.category = category;
+  rec.event = event;
+  buffer().push(rec);
+}
+
+bool TraceLog::dump(std::string const &fileName) {
+  Guardian<Mutex> guard(traceMutex());
+  std::vector<Buffer *> const &buffers = Buffer::all();
+
+  if( buffers.empty() )
+    return false;
+
+  std::ofstream out(fileName.c_str(), std::ios::binary);
+  if( !out )
+    return false;
+
+  out.write(TRACE_MAGIC, 8);
+  writeU32(out, TRACE_VERSION);
+  writeU32(out, sizeof(TraceRecord));
+
+  writeU32(out, TRACE_CATEGORY_COUNT);
+  for(unsigned i=0; i<TRACE_CATEGORY_COUNT; ++i)
+    writeString(out, sl_categories[i]);
+
+  writeU32(out, TRACE_EVENT_COUNT);
+  for(unsigned i=0; i<TRACE_EVENT_COUNT; ++i) {
+    checkError(sl_events[i].event==i, "TraceLog: event table out of order at "<<i);
+    writeU32(out, sl_events[i].category);
+    writeString(out, sl_events[i].marker);
+    writeString(out, sl_events[i].text);
+  }
+
+  std::vector<std::string> const &names = reactorNames();
+  writeU32(out, names.size());
+  for(std::vector<std::string>::const_iterator i=names.begin(); names.end()!=i; ++i)
+    writeString(out, *i);
+
+  writeU32(out, buffers.size());
+  for(std::vector<Buffer *>::const_iterator i=buffers.begin(); buffers.end()!=i; ++i)
+    (*i)->write(out);
+  
+  debugMsg("TraceLog", "Wrote "<<buffers.size()<<" trace buffers to "<<fileName);
+  return !!out;
+}
+
+void TraceLog::snapshot(std::vector<TraceRecord> &out) {
+  Guardian<Mutex> guard(traceMutex());
+  std::vector<Buffer *> const &buffers = Buffer::all();
+
+  for(std::vector<Buffer *>::const_iterator i=buffers.begin(); buffers.end()!=i; ++i)
+    (*i)->copy(out);
+}
+
+void TraceLog::reset() {
+  Guardian<Mutex> guard(traceMutex());
+  std::vector<Buffer *> const &buffers = Buffer::all();
+
+  for(std::vector<Buffer *>::const_iterator i=buffers.begin(); buffers.end()!=i; ++i)
+    (*i)->clear(s_capacity);
+  reactorNames().clear();
+}
+
+char const *TraceLog::categoryName(TraceCategory category) {
+  checkError(category<TRACE_CATEGORY_COUNT, "TraceLog: invalid category "<<category);
+  return sl_categories[category];
+}
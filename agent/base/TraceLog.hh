@@ -0,0 +1,219 @@
+/* -*- C++ -*-
+ * $Id$
+ */
+/** @file "TraceLog.hh"
+ * @brief Structured, binary trace events for synchronization and DbCore.
+ */
+#ifndef _TRACELOG_HH
+#define _TRACELOG_HH
+
+
+/*********************************************************************
+* Software License Agreement (BSD License)
+* 
+*  Copyright (c) 2007. MBARI.
+*  All rights reserved.
+* 
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions
+*  are met:
+* 
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of the TREX Project nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+* 
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+*  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+*  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+*  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+*  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+*  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+*  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+*  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+*  POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+
+#include "TREXDefs.hh"
+
+/** @brief Compile time trace categories.
+ *
+ * Each bit enables the matching TREX::TraceCategory. A category whose bit
+ * is cleared here is removed by the compiler along with all its TREX_TRACE
+ * calls.
+ */
+#ifndef TREX_TRACE_CATEGORIES
+# define TREX_TRACE_CATEGORIES 0xffffffffu
+#endif
+
+/** @brief Record a trace event
+ *
+ * @param category A TREX::TraceCategory
+ * @param event A TREX::TraceEvent
+ * @param tick The current tick
+ * @param reactor The trace id of the reactor (TeleoReactor::getTraceId)
+ * @param key The key of the entity involved, usually a token
+ * @param arg An additional integer argument, meaning depends on @e event
+ *
+ * Nothing is formatted: the event is copied as a fixed size record in the
+ * ring buffer of the calling thread. When the category is disabled the cost
+ * is a single test.
+ */
+#define TREX_TRACE(category, event, tick, reactor, key, arg) { \
+  if( ((TREX_TRACE_CATEGORIES) & (1u<<(category))) && TREX::TraceLog::isEnabled(category) ) \
+    TREX::TraceLog::record(category, event, tick, reactor, key, arg); \
+}
+
+namespace TREX {
+
+  enum TraceCategory {
+    TRACE_SYNCHRONIZATION = 0,
+    TRACE_RELAX,
+    TRACE_TOKEN_AGENDA,
+    TRACE_DBCORE,
+    TRACE_DISPATCH,
+    TRACE_CATEGORY_COUNT
+  };
+
+  /** @brief Trace event kinds.
+   *
+   * The marker and text used to render each event are given by the table in
+   * TraceLog.cc which must follow the order of this enum.
+   */
+  enum TraceEvent {
+    TRACE_SYNCH_RESOLVE = 0,
+    TRACE_SYNCH_RESOLVED,
+    TRACE_SYNCH_FAILED,
+    TRACE_SYNCH_EVALUATE,
+    TRACE_SYNCH_PARK,
+    TRACE_SYNCH_RESOLVE_TOKEN,
+    TRACE_SYNCH_MERGE,
+    TRACE_SYNCH_INSERT,
+    TRACE_SYNCH_SKIP_PAST,
+    TRACE_SYNCH_INSERT_DEFAULT,
+    TRACE_SYNCH_CONFLICT,
+    TRACE_RELAX_START,
+    TRACE_RELAX_CANCEL,
+    TRACE_RELAX_COPY,
+    TRACE_RELAX_END,
+    TRACE_AGENDA_ADD,
+    TRACE_AGENDA_REMOVE,
+    TRACE_DBCORE_OBSERVATION,
+    TRACE_DBCORE_COMMIT,
+    TRACE_DBCORE_EXTEND,
+    TRACE_DBCORE_ARCHIVE,
+    TRACE_DBCORE_INVALID,
+    TRACE_DISPATCH_REQUEST,
+    TRACE_DISPATCH_RECALL,
+    TRACE_EVENT_COUNT
+  };
+
+  /** @brief A trace event as stored and written to disk
+   *
+   * All the records have the same size in order to be stored in a simple
+   * ring buffer and written as is.
+   */
+  struct TraceRecord {
+    uint64_t nsec;    /*!< CLOCK_MONOTONIC date of the event in nanoseconds */
+    uint32_t tick;
+    int32_t key;
+    int32_t arg;
+    uint16_t reactor;
+    uint8_t category;
+    uint8_t event;
+  };
+
+  /** @brief Binary trace log
+   *
+   * Every thread writes its events in its own ring buffer of fixed capacity,
+   * so recording never allocates nor locks once the buffer exists. The
+   * buffers are written with dump, usually when the agent is deleted, and
+   * rendered as text by the trextrace script. They are reset when the first
+   * agent of a run is created.
+   *
+   * @warn dump does not stop the other threads from recording. It should be
+   * called when the agent is not running.
+   */
+  class TraceLog {
+  public:
+    /** @brief Check if @e category is enabled at run time */
+    static bool isEnabled(TraceCategory category) {
+      return 0!=(s_mask & (1u<<category));
+    }
+    /** @brief Enable categories from a comma separated list of names
+     *
+     * @param names The list of categories. "all" enables every category.
+     *
+     * @sa categoryName(TraceCategory)
+     */
+    static void enable(std::string const &names);
+    static void enable(TraceCategory category);
+    static void disable(TraceCategory category);
+    /** @brief Set the number of records kept per thread
+     *
+     * Only affects the buffers created after this call.
+     */
+    static void setCapacity(size_t capacity);
+    
+    /** @brief Identifier of a reactor in trace records
+     *
+     * @param name The reactor name
+     *
+     * @return The index of @e name in the reactor table written with the trace.
+     */
+    static uint16_t reactorId(LabelStr const &name);
+
+    static void record(TraceCategory category, TraceEvent event, TICK tick,
+		       uint16_t reactor, int key, int arg);
+
+    /** @brief Write all the buffers to a file
+     *
+     * @param fileName The file name
+     *
+     * @return false if nothing was recorded or the file could not be written.
+     */
+    static bool dump(std::string const &fileName);
+    /** @brief Copy the records of all the buffers
+     *
+     * @param out Where the records are appended, buffer after buffer and
+     * oldest first within each buffer
+     */
+    static void snapshot(std::vector<TraceRecord> &out);
+    /** @brief Drop all the records and the reactor table
+     *
+     * Called when a new run starts so that its trace does not hold the
+     * events of the previous one. The buffers get the current capacity.
+     *
+     * @warn As for dump, no other thread should be recording.
+     */
+    static void reset();
+
+    static char const *categoryName(TraceCategory category);
+
+  private:
+    class Buffer;
+    
+    static Buffer &buffer();
+    
+    static unsigned s_mask;
+    static size_t s_capacity;
+    
+    TraceLog();
+  }; // TREX::TraceLog
+
+} // TREX
+
+#endif // _TRACELOG_HH
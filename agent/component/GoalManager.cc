@@ -89,7 +89,8 @@ namespace TREX{
       m_maxIterations(1000),
       m_plateau(5),
       m_positionSourceCfg(""),
-      m_state(STATE_DONE) {
+      m_state(STATE_DONE),
+      m_nextToken(TokenId::noId()) {
 
     // Set the robot's initial position to be the origin.
     m_position.x = 0;
@@ -129,6 +130,7 @@ namespace TREX{
     if (m_currentSolution.empty() && m_ommissions.empty()) {
       debugMsg("GoalManager", "No goals, quitting.");
       setState(STATE_DONE);
+      updateNextToken();
       return;
     }
 
@@ -180,6 +182,8 @@ namespace TREX{
       condDebugMsg(m_watchDog >= m_plateau, "trex:debug:planning:GoalManager", "Reached a local minimum.");
       debugMsg("trex:debug:planning:GoalManager", "Returning after " << m_iteration << " iterations" << toString(m_currentSolution));
     }
+
+    updateNextToken();
   }
 
 
@@ -203,22 +207,27 @@ namespace TREX{
     }
 
     m_constraints.clear();
+    updateNextToken();
   }
 
   bool GoalManager::isNextToken(TokenId token) {
-    if (!noMoreFlaws()) {
-      return false;
-    }
-    TokenId nextGoal = TokenId::noId();
+    return m_nextToken.isId() && m_nextToken == token;
+  }
+
+  TokenId GoalManager::findNextToken() {
+    if (!noMoreFlaws())
+      return TokenId::noId();
     for(SOLUTION::const_iterator it = m_currentSolution.begin(); it != m_currentSolution.end(); ++it){
       TokenId t = *it;
       checkError(t.isValid(), "A token that has been deleted is in the solution.");
-      if (t->isInactive()){
-	nextGoal = t;
-	break;
-      }
+      if (t->isInactive())
+	return t;
     }
-    return (nextGoal == token);
+    return TokenId::noId();
+  }
+
+  void GoalManager::updateNextToken() {
+    m_nextToken = findNextToken();
   }
 
   /**
@@ -232,6 +241,7 @@ namespace TREX{
     if(token->getState()->baseDomain().isMember(Token::REJECTED)){
       debugMsg("GoalManager:addFlaw", "Adding flaw: " << token->toString());
       setState(STATE_REQUIRE_PLANNING);
+      updateNextToken();
     }
   }
 
@@ -259,6 +269,8 @@ namespace TREX{
 
     // Clear from ommittedTokens
     m_ommissions.erase(token);
+
+    updateNextToken();
   }
 
   void GoalManager::handleInitialize(){
@@ -548,7 +560,7 @@ namespace TREX{
   void GoalManager::setInitialConditions(){    
 
     // Start time
-    const IntervalIntDomain& horizon = DeliberationFilter::getHorizon();
+    const IntervalIntDomain& horizon = DeliberationFilter::getHorizon(getPlanDatabase());
     m_startTime = (int) horizon.getLowerBound();
     m_timeBudget = (int) (horizon.getUpperBound() - horizon.getLowerBound());
     debugMsg("GoalManager", "Time budget: " << m_timeBudget << " (" <<
@@ -103,6 +103,11 @@ namespace TREX {
      * @brief True if the token is the next in the plan.
      */
     bool isNextToken(TokenId token);
+    /**
+     * @brief The first inactive token of the solution once planning is done, by a scan of the solution.
+     * isNextToken uses the value cached when the state or the solution last changed.
+     */
+    TokenId findNextToken();
     /**
      * @brief True if the planner has no more work to do.
      */
@@ -206,6 +211,11 @@ namespace TREX {
      */
     void setState(const State& s);
 
+    /**
+     * @brief Recompute the next goal. Called whenever the state or the solution changes.
+     */
+    void updateNextToken();
+
     // Configuration derived members
     unsigned int m_maxIterations;
     unsigned int m_plateau;
@@ -214,6 +224,7 @@ namespace TREX {
 
     State m_state;
     SOLUTION m_currentSolution;
+    TokenId m_nextToken; /*!< First inactive goal of the solution once planning is done */
     TokenSet m_ommissions;
     std::vector< std::pair<int, ConstraintId> > m_constraints;
 
@@ -34,6 +34,8 @@
 
 #include "OrienteeringSolver.hh"
 #include "Token.hh"
+#include "MutexWrapper.hh"
+#include "Guardian.hh"
 
 namespace TREX {
   DynamicGoalFilter::DynamicGoalFilter(const TiXmlElement& configData): FlawFilter(configData, true) {}
@@ -47,12 +49,36 @@ namespace TREX {
 
 
 
-  std::vector<OrienteeringSolverId> OrienteeringSolver::s_goalSolvers;
+  namespace {
+    Mutex& goalSolversMutex(){
+      static Mutex sl_mutex;
+      return sl_mutex;
+    }
+  }
+
+  std::multimap<PlanDatabaseId, OrienteeringSolverId>& OrienteeringSolver::goalSolvers(){
+    static std::multimap<PlanDatabaseId, OrienteeringSolverId> sl_solvers;
+    return sl_solvers;
+  }
 
   bool OrienteeringSolver::isGlobalNextGoal(TokenId token) {
-    for (std::vector<OrienteeringSolverId>::iterator it = s_goalSolvers.begin(); 
-	 it != s_goalSolvers.end(); it++) {
-      if ((*it)->isNextGoal(token)) {
+    typedef std::multimap<PlanDatabaseId, OrienteeringSolverId>::const_iterator solver_iter;
+    Guardian<Mutex> guard(goalSolversMutex());
+    std::pair<solver_iter, solver_iter> solvers = goalSolvers().equal_range(token->getPlanDatabase());
+    for (solver_iter it = solvers.first; it != solvers.second; it++) {
+      if (it->second->isNextGoal(token)) {
+	return true;
+      }
+    }
+    return false;
+  }
+
+  bool OrienteeringSolver::scanGlobalNextGoal(TokenId token) {
+    typedef std::multimap<PlanDatabaseId, OrienteeringSolverId>::const_iterator solver_iter;
+    Guardian<Mutex> guard(goalSolversMutex());
+    std::pair<solver_iter, solver_iter> solvers = goalSolvers().equal_range(token->getPlanDatabase());
+    for (solver_iter it = solvers.first; it != solvers.second; it++) {
+      if (it->second->m_goalManager->findNextToken() == token) {
 	return true;
       }
     }
@@ -67,15 +93,14 @@ namespace TREX {
 
 
   OrienteeringSolver::OrienteeringSolver(const TiXmlElement& cfgXml) 
-    : FlawManagerSolver(cfgXml), m_goalManager(GoalManagerId::noId()), m_stepCount(0) {
-    s_goalSolvers.push_back(this->getId());
-  }
+    : FlawManagerSolver(cfgXml), m_goalManager(GoalManagerId::noId()), m_stepCount(0) {}
   
   OrienteeringSolver::~OrienteeringSolver() {
-    for (std::vector<OrienteeringSolverId>::iterator it = s_goalSolvers.begin(); 
-	 it != s_goalSolvers.end(); it++) {
-      if ((OrienteeringSolver*)(*it) == this) {
-	s_goalSolvers.erase(it);
+    Guardian<Mutex> guard(goalSolversMutex());
+    std::multimap<PlanDatabaseId, OrienteeringSolverId>::iterator it = goalSolvers().lower_bound(m_db);
+    for (; it != goalSolvers().end() && it->first == m_db; it++) {
+      if ((OrienteeringSolver*)(it->second) == this) {
+	goalSolvers().erase(it);
 	break;
       }
     }
@@ -90,6 +115,10 @@ namespace TREX {
     assertTrue((GoalManager*)getFlawManager(0),
 	       "You must have one and only one GoalManager per solver, and nothing else.");
     m_goalManager = ((GoalManager*)getFlawManager(0))->getId();
+
+    m_db = db;
+    Guardian<Mutex> guard(goalSolversMutex());
+    goalSolvers().insert(std::pair<PlanDatabaseId, OrienteeringSolverId>(m_db, getId()));
   }
   
   bool OrienteeringSolver::isExhausted() {
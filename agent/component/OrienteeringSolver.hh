@@ -38,6 +38,8 @@
 #include "DbSolver.hh"
 #include "GoalManager.hh"
 
+#include <map>
+
 namespace TREX {
   class DynamicGoalFilter : public FlawFilter {
   public:
@@ -95,16 +97,25 @@ namespace TREX {
      */
     void reset();
     /**
-     * @brief Tests all orientering solvers to see if the token is the next goal.
+     * @brief Tests the orientering solvers of the token's database to see if the token is the next goal.
+     * Each solver checks the next goal its goal manager cached when its solution last changed.
      */
     static bool isGlobalNextGoal(TokenId token);
+    /**
+     * @brief Same as isGlobalNextGoal, but scans the solutions of the goal managers. Used to check the cached goals.
+     */
+    static bool scanGlobalNextGoal(TokenId token);
     /**
      * @brief Tests is the token is the next goal.
      */
     bool isNextGoal(TokenId token);
   private:
+    /**
+     * @brief The solvers of each database. A reactor only ever looks up its own database.
+     */
+    static std::multimap<PlanDatabaseId, OrienteeringSolverId>& goalSolvers();
     GoalManagerId m_goalManager; /*! The goal manager. */
-    static std::vector<OrienteeringSolverId> s_goalSolvers;  /*! Static list of solvers. */
+    PlanDatabaseId m_db; /*! Database given at init. */
     unsigned int m_stepCount; /*! Counts steps. */
   };
 }
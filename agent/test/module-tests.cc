@@ -33,16 +33,44 @@
 */
 
 #include "Agent.hh"
+#include "Adapter.hh"
+#include "Observer.hh"
 #include "Schema.hh"
 #include "Debug.hh"
 #include "Nddl.hh"
 #include "Utilities.hh"
 #include "TestMonitor.hh"
+#include "DbCore.hh"
+#include "DbWriter.hh"
+#include "LogManager.hh"
+#include "DebugStream.hh"
+#include "Thread.hh"
+#include "ObservationCodec.hh"
+#include "ObservationBus.hh"
+#include "ErrnoExcept.hh"
+#include "TraceLog.hh"
+#include "Compression.hh"
+#include "OrienteeringSolver.hh"
 #include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
 #include <time.h>
 #include <errno.h>
+#include <limits.h>
+#include <stdlib.h>
 
+#include <algorithm>
 #include <iostream>
+#include <sstream>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <cstring>
+#include <map>
+#include <set>
+#include <vector>
 
 using namespace EUROPA;
 
@@ -88,12 +116,228 @@ void runAgentWithSchema(const char* configFile, unsigned int stepsPerTick, const
   assertTrue(result, TREX::TestMonitor::toString().c_str());
 }
 
+/**
+ * Read the fields of the binary logs
+ */
+uint32_t readU32(const char*& data){
+  uint32_t value;
+  memcpy(&value, data, sizeof(value));
+  data += sizeof(value);
+  return value;
+}
+
+std::string readString(const char*& data){
+  uint32_t length = readU32(data);
+  std::string value(data, length);
+  data += length;
+  return value;
+}
+
+/**
+ * Writes debug output from its own thread
+ */
+class DebugWriter: public Thread {
+public:
+  std::ostringstream m_out;
+protected:
+  void *run(){
+    DebugStream::select(m_out);
+    for(unsigned int i = 0; i < 1000; i++)
+      DebugMessage::getStream().rdbuf()->sputn("x\n", 2);
+    return NULL;
+  }
+};
+
+/**
+ * Runs 2 reactors on its own thread, switching the debug stream between them as the agent does
+ */
+class ReactorLogger: public Thread {
+public:
+  ReactorLogger(char id): m_id(id) {}
+  std::ostringstream m_out[2];
+  /**
+   * @brief Check that each stream got all the lines of its reactor, and only those
+   */
+  bool check() const {
+    for(unsigned int r = 0; r < 2; r++){
+      std::istringstream lines(m_out[r].str());
+      std::string line;
+      unsigned int count = 0;
+      while(std::getline(lines, line)){
+	std::ostringstream expected;
+	expected << m_id << r << " " << count / 2 << " " << 0.5 * count;
+	if(line != expected.str())
+	  return false;
+	count++;
+      }
+      if(count != 1000)
+	return false;
+    }
+    return true;
+  }
+protected:
+  void *run(){
+    // The shared debug ostream keeps format state, so format through a stream of
+    // this thread over the same router
+    std::ostream out(DebugMessage::getStream().rdbuf());
+    for(unsigned int i = 0; i < 1000; i++)
+      for(unsigned int r = 0; r < 2; r++){
+	DebugStream::select(m_out[r]);
+	// Formatted output in 2 statements, as a debug message and its continuation
+	out << m_id << r << " " << i / 2;
+	out << " " << 0.5 * i << std::endl;
+      }
+    return NULL;
+  }
+private:
+  char m_id;
+};
+
+/**
+ * A reactor without timelines that spends fixed times synchronizing and stepping. Used to test the agenda
+ * of the agent. Configured with the syncTime and stepTime attributes, in seconds, and stepsPerTick, the steps
+ * it has work for at each tick (0, the default, to always have work).
+ */
+class TimedReactor: public TeleoReactor {
+public:
+  TimedReactor(const LabelStr& agentName, const TiXmlElement& configData)
+    : TeleoReactor(agentName, configData),
+      m_syncTime(configData.Attribute("syncTime") == NULL ? 0.0 : atof(configData.Attribute("syncTime"))),
+      m_stepTime(configData.Attribute("stepTime") == NULL ? 0.0 : atof(configData.Attribute("stepTime"))),
+      m_stepsPerTick(configData.Attribute("stepsPerTick") == NULL ? 0 : atoi(configData.Attribute("stepsPerTick"))),
+      m_left(0) {}
+
+  /**
+   * @brief Tick and name of the reactors stepped, in order, since the last clear
+   */
+  static std::vector<std::pair<TICK, std::string> >& steps(){
+    static std::vector<std::pair<TICK, std::string> > sl_steps;
+    return sl_steps;
+  }
+
+  /**
+   * @brief Tick of each step of this reactor
+   */
+  const std::vector<TICK>& stepTicks() const {return m_stepTicks;}
+
+  void queryTimelineModes(std::list<LabelStr>& externals, std::list<LabelStr>& internals){}
+
+  bool hasWork(){return m_stepsPerTick == 0 || m_left > 0;}
+
+protected:
+  void handleTickStart(){m_left = m_stepsPerTick;}
+
+  bool synchronize(){
+    if(m_syncTime > 0)
+      Clock::sleep(m_syncTime);
+    return true;
+  }
+
+  void resume(){
+    if(m_stepTime > 0)
+      Clock::sleep(m_stepTime);
+    if(m_left > 0)
+      m_left--;
+    m_stepTicks.push_back(getCurrentTick());
+    steps().push_back(std::make_pair(getCurrentTick(), getName().toString()));
+  }
+
+private:
+  const double m_syncTime, m_stepTime;
+  const unsigned int m_stepsPerTick;
+  unsigned int m_left;
+  std::vector<TICK> m_stepTicks;
+};
+
+TeleoReactor::ConcreteFactory<TimedReactor> l_TimedReactor_Factory("TimedReactor");
+
+/**
+ * An adapter that observes a value read from its configuration at each tick. The values attribute is a comma
+ * separated list of integers, the last one repeated once the list is exhausted. They are published as the value
+ * parameter of the predicate attribute on the timelineName timeline. With the burst attribute, each value is
+ * preceded in the same tick by that value plus burst.
+ */
+class ScriptAdapter: public Adapter {
+public:
+  ScriptAdapter(const LabelStr& agentName, const TiXmlElement& configData)
+    : Adapter(agentName, configData),
+      m_timeline(extractData(configData, "timelineName")),
+      m_predicate(extractData(configData, "predicate")),
+      m_burst(configData.Attribute("burst") == NULL ? 0 : atoi(configData.Attribute("burst"))) {
+    std::istringstream values(extractData(configData, "values").toString());
+    std::string value;
+    while(std::getline(values, value, ','))
+      m_values.push_back(atoi(value.c_str()));
+    checkError(!m_values.empty(), "No values for " << getName().toString());
+  }
+
+protected:
+  bool synchronize(){
+    int value = m_values[std::min((size_t) getCurrentTick(), m_values.size() - 1)];
+    if(m_burst != 0)
+      observe(value + m_burst);
+    observe(value);
+    return true;
+  }
+
+private:
+  void observe(int value){
+    ObservationByValue obs(m_timeline, m_predicate);
+    obs.push_back("value", new IntervalIntDomain(value, value));
+    sendNotify(obs);
+  }
+
+  const LabelStr m_timeline, m_predicate;
+  const int m_burst;
+  std::vector<int> m_values;
+};
+
+TeleoReactor::ConcreteFactory<ScriptAdapter> l_ScriptAdapter_Factory("ScriptAdapter");
+
+/**
+ * A reactor that observes the timelineName timeline and records the tick and value of every observation it gets
+ */
+class ObservationRecorder: public TeleoReactor {
+public:
+  ObservationRecorder(const LabelStr& agentName, const TiXmlElement& configData)
+    : TeleoReactor(agentName, configData),
+      m_timeline(extractData(configData, "timelineName")) {}
+
+  /**
+   * @brief Tick and value parameter of each observation received, in order
+   */
+  const std::vector<std::pair<TICK, int> >& received() const {return m_received;}
+
+  void queryTimelineModes(std::list<LabelStr>& externals, std::list<LabelStr>& internals){
+    externals.push_back(m_timeline);
+  }
+
+  void notify(const Observation& observation){
+    m_received.push_back(std::make_pair(getCurrentTick(), (int) observation[0].second->getSingletonValue()));
+  }
+
+  bool hasWork(){return false;}
+
+protected:
+  void resume(){}
+
+private:
+  const LabelStr m_timeline;
+  std::vector<std::pair<TICK, int> > m_received;
+};
+
+TeleoReactor::ConcreteFactory<ObservationRecorder> l_ObservationRecorder_Factory("ObservationRecorder");
+
 class GamePlayTests {
 public:
   static bool test(){ 
     runTest(testActionAdapter);
     runTest(testDispatch);
     runTest(testSqueezeObserver);
+    runTest(testPerReactorHorizon);
+    runTest(testAgendaPolicies);
+    runTest(testSynchronizationQueue);
+    runTest(testAgentOnThread);
     runTest(testSimulation);
     runTest(testUndefinedSingleTimeline);
     runTest(testUndefinedDerived);
@@ -101,8 +345,14 @@ public:
     runTest(testSynch);
     runTest(testExtensions);
     runTest(testRecall);
+    runTest(testStartupLog);
     runTest(testRepair);
+    runTest(testLocalRepair);
     runTest(testLogging);
+    runTest(testPlanDeltas);
+    runTest(testUnchangedObservation);
+    runTest(testCoalescedObservations);
+    runTest(testSocketAdapter);
     runTest(testPersistence);
     runTest(testSimulationWithPlannerTimeouts);
     runTest(testScalability);
@@ -111,6 +361,7 @@ public:
     runTest(bugFixes); 
     runTest(testOneDeliberatorOneAdapter);
     runTest(OrienteeringSolver);
+    runTest(testNextGoalCache);
     runTest(testInconsistent);
     runTest(testOneStepAhead);
     runTest(testFileSearch);
@@ -142,6 +393,318 @@ private:
     return true;
   }
   
+  typedef std::map<std::string, std::map<std::string, std::vector<std::string> > > PlanState;
+
+  /**
+   * @brief Read a step log as the trexplans script does : lines are grouped by entity key, and each
+   * delta replaces the groups of the entities it holds over the previous step.
+   */
+  static void readStepLog(const std::string& fileName, std::vector<PlanState>& steps){
+    static const char* ppIdColumns[][2] = {{".objects", "3"}, {".tokens", "4"}, {".ruleInstances", "1"},
+					   {".ruleInstanceSlaveMap", "2"}, {".variables", "1"},
+					   {".constraints", "1"}, {".constraintVarMap", "2"}};
+    std::ifstream in(fileName.c_str(), std::ios::binary);
+    std::string file((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    assertTrue(file.compare(0, 8, "TRXSTEPS") == 0, fileName);
+    const char* data = file.data() + 8;
+    const char* end = file.data() + file.size();
+    assertTrue(readU32(data) == 2);
+    uint32_t headerSize = readU32(data);
+    std::vector<std::string> names(readU32(data));
+    for(unsigned int i = 0; i < names.size(); i++)
+      names[i] = readString(data);
+
+    PlanState state;
+    while(data + headerSize <= end){
+      uint32_t size, rawSize, flags;
+      memcpy(&size, data, 4);
+      memcpy(&rawSize, data + 4, 4);
+      memcpy(&flags, data + 24, 4);
+      data += headerSize;
+      std::string raw;
+      assertTrue(uncompress(data, size, rawSize, raw));
+      data += size;
+
+      const char* pos = raw.data();
+      std::map<std::string, std::string> sections;
+      for(unsigned int i = 0; i < names.size(); i++){
+	uint32_t length = readU32(pos);
+	sections[names[i]] = std::string(pos, length);
+	pos += length;
+      }
+      if(flags & 1)
+	state.clear();
+      else {
+	for(uint32_t count = readU32(pos); count > 0; count--){
+	  int32_t key;
+	  memcpy(&key, pos, 4);
+	  pos += 4;
+	  std::ostringstream oss;
+	  oss << key;
+	  for(PlanState::iterator it = state.begin(); it != state.end(); ++it)
+	    it->second.erase(oss.str());
+	}
+      }
+
+      // The partial plan id differs between writers
+      for(unsigned int c = 0; c < 7; c++){
+	std::map<std::string, std::vector<std::string> > groups;
+	std::istringstream lines(sections[ppIdColumns[c][0]]);
+	unsigned int column = atoi(ppIdColumns[c][1]);
+	std::string line;
+	while(std::getline(lines, line)){
+	  std::vector<std::string> fields;
+	  std::string::size_type from = 0, tab;
+	  while((tab = line.find('\t', from)) != std::string::npos){
+	    fields.push_back(line.substr(from, tab - from));
+	    from = tab + 1;
+	  }
+	  fields.push_back(line.substr(from));
+	  if(column < fields.size())
+	    fields[column] = "0";
+	  std::string normalized = fields[0];
+	  for(unsigned int f = 1; f < fields.size(); f++)
+	    normalized += "\t" + fields[f];
+	  groups[fields[0]].push_back(normalized);
+	}
+	for(std::map<std::string, std::vector<std::string> >::const_iterator it = groups.begin(); it != groups.end(); ++it)
+	  state[ppIdColumns[c][0]][it->first] = it->second;
+      }
+      steps.push_back(state);
+    }
+  }
+
+  /**
+   * @brief Write the same database at every step in full and as deltas. Applying each delta on the
+   * previous steps must give the full dump. The database gets new tokens on a timeline, with the slaves
+   * of their rules, and loses a goal.
+   */
+  static bool testPlanDeltas(){
+    // The agent sets up the log directories
+    PseudoClock clock(0.0, 15);
+    TiXmlElement* root = initXml(findFile("SqueezeObserver.cfg").c_str());
+    Agent::initialize(*root, clock);
+    LogManager::instance().handleInit();
+
+    std::string fullLog = LogManager::instance().reactor_dir_path("Numbers", "DeltaFull", "plans") + "/steps.0.bin";
+    std::string deltaLog = LogManager::instance().reactor_dir_path("Numbers", "DeltaSteps", "plans") + "/steps.0.bin";
+    {
+      Assembly assembly("Numbers", "DeltaTest");
+      assertTrue(assembly.playTransactions(findFile("Numbers.A.nddl").c_str()));
+      const PlanDatabaseId& db = assembly.getPlanDatabase();
+      const ConstraintEngineId& ce = assembly.getConstraintEngine();
+      DbWriter full("Numbers", "DeltaFull", db, ce, assembly.getRulesEngine());
+      DbWriter delta("Numbers", "DeltaSteps", db, ce, assembly.getRulesEngine());
+      full.setBinary(1<<20);
+      delta.setBinary(1<<20);
+      delta.setKeyframePeriod(1000);
+
+      TimelineId timeline = db->getObject("n");
+      assertTrue(timeline.isId());
+      TokenId previous, goal;
+      for(TICK tick = 0; tick < 6; tick++){
+	TokenId token = db->getClient()->createToken("NumberTimeline.holds", false);
+	token->activate();
+	token->start()->restrictBaseDomain(IntervalIntDomain(tick, tick));
+	token->end()->restrictBaseDomain(IntervalIntDomain(tick + 1, PLUS_INFINITY));
+	token->getObject()->specify(timeline);
+	if(previous.isId())
+	  timeline->constrain(previous, token);
+	else
+	  timeline->constrain(token, token);
+	previous = token;
+
+	if(tick == 2)
+	  goal = db->getClient()->createToken("NumberTimeline.holds", true);
+	else if(tick == 4)
+	  goal->discard();
+
+	assertTrue(ce->propagate());
+	full.write(tick, 0);
+	delta.write(tick, 0);
+      }
+    }
+
+    Agent::reset();
+    delete root;
+
+    std::vector<PlanState> fullSteps, deltaSteps;
+    readStepLog(fullLog, fullSteps);
+    readStepLog(deltaLog, deltaSteps);
+    assertTrue(fullSteps.size() == 6 && deltaSteps.size() == 6);
+    for(unsigned int i = 0; i < 6; i++)
+      assertTrue(fullSteps[i] == deltaSteps[i], "A delta differs from the full step");
+    return true;
+  }
+
+  /**
+   * @brief An observation repeating the current value is absorbed by the inertial value assumption: no token
+   * is made for it and it is counted in nUnchangedObs. A changed value still makes a new token.
+   */
+  static bool testUnchangedObservation(){
+    checkUnchangedObservation(0);
+    return true;
+  }
+
+  /**
+   * @brief Run Observe.cfg and check the tokens made for its observations at each tick.
+   * @param burst The burst of its ScriptAdapter. Coalescing has to keep the values preceding the scripted ones from the DbCore.
+   */
+  static void checkUnchangedObservation(int burst){
+    // Values observed from tick 0: 1, 1, 1, 2, 2, 3
+    static const bool expectNewToken[] = {true, false, false, true, false, true};
+    PseudoClock clock(0.0, 5);
+    TiXmlElement* root = initXml(findFile("Observe.cfg").c_str());
+    for(TiXmlElement* child = root->FirstChildElement(); child != NULL; child = child->NextSiblingElement())
+      if(std::string(child->Attribute("name")) == "C")
+	child->SetAttribute("burst", burst);
+    Agent::initialize(*root, clock);
+    LogManager::instance().handleInit();
+    DbCoreId db = Agent::instance()->getReactor("A");
+
+    std::set<int> before;
+    for(unsigned int tick = 0; !Agent::instance()->missionCompleted(); tick++){
+      Agent::instance()->doNext();
+      std::set<int> keys;
+      getPlanKeys(db, keys);
+      std::vector<int> added;
+      std::set_difference(keys.begin(), keys.end(), before.begin(), before.end(), std::back_inserter(added));
+      unsigned int unchanged = db->getUnchangedObservationCount();
+
+      std::ostringstream ss;
+      ss << "Tick " << tick << ": " << added.size() << " new tokens, " << unchanged << " unchanged observations";
+      assertTrue(tick < sizeof(expectNewToken) / sizeof(expectNewToken[0]), ss.str());
+      if(expectNewToken[tick])
+	assertTrue(!added.empty() && unchanged == 0, ss.str());
+      else
+	assertTrue(added.empty() && unchanged == 1, ss.str());
+      before.swap(keys);
+    }
+
+    Agent::reset();
+    delete root;
+  }
+
+  /**
+   * @brief Observations of a timeline posted within a tick before its observers synchronize reach them as the last
+   * value only, the DbCore included. With coalesce="false" or the timeline listed in uncoalesced, every one of them is
+   * delivered, in the order posted.
+   */
+  static bool testCoalescedObservations(){
+    checkUnchangedObservation(10);
+
+    static const char* modes[][2] = {{NULL, NULL}, {"coalesce", "false"}, {"uncoalesced", "s"}};
+    for(unsigned int i = 0; i < 3; i++){
+      PseudoClock clock(0.0, 5);
+      TiXmlElement* root = initXml(findFile("Coalesce.cfg").c_str());
+      if(modes[i][0] != NULL)
+	root->SetAttribute(modes[i][0], modes[i][1]);
+      Agent::initialize(*root, clock);
+      LogManager::instance().handleInit();
+      const ObservationRecorder* recorder = dynamic_cast<const ObservationRecorder*>((TeleoReactor*) Agent::instance()->getReactor("R"));
+      assertTrue(recorder != NULL);
+
+      while(!Agent::instance()->missionCompleted())
+	Agent::instance()->doNext();
+
+      // C observes 1, 2 then 3 until the end, each preceded by itself plus 10
+      const std::vector<std::pair<TICK, int> >& received = recorder->received();
+      unsigned int perTick = (i == 0 ? 1 : 2);
+      assertTrue(!received.empty() && received.size() % perTick == 0);
+      for(unsigned int j = 0; j < received.size(); j++){
+	TICK tick = j / perTick;
+	int value = std::min((int) tick, 2) + 1;
+	if(perTick == 2 && j % 2 == 0)
+	  value += 10;
+	std::ostringstream ss;
+	ss << (modes[i][0] == NULL ? "coalesced" : modes[i][0]) << ": got " << received[j].second << " at tick " << received[j].first;
+	assertTrue(received[j].first == tick && received[j].second == value, ss.str());
+      }
+
+      Agent::reset();
+      delete root;
+    }
+    return true;
+  }
+
+  /**
+   * @brief Send frames to a SocketAdapter for the timeline of Observe.cfg. Frames naming a predicate or a parameter
+   * that the model does not have are dropped, and the valid frames that follow them still get through.
+   */
+  static bool testSocketAdapter(){
+    static const char* path = "SocketAdapterTest.sock";
+    PseudoClock clock(0.0, 5);
+    TiXmlElement* root = initXml(findFile("Observe.cfg").c_str());
+    for(TiXmlElement* child = root->FirstChildElement(); child != NULL; child = child->NextSiblingElement())
+      if(std::string(child->Attribute("name")) == "C"){
+	child->SetAttribute("component", "SocketAdapter");
+	child->SetAttribute("socket", path);
+      }
+
+    // A file at the socket path is left alone
+    std::ofstream(path) << "not a socket";
+    bool rejected = false;
+    try {
+      Agent::initialize(*root, clock);
+    }
+    catch(ConfigurationException* e){
+      rejected = true;
+      delete e;
+    }
+    assertTrue(rejected && access(path, F_OK) == 0, "Replaced a file by the socket");
+    unlink(path);
+
+    Agent::initialize(*root, clock);
+    LogManager::instance().handleInit();
+    DbCoreId db = Agent::instance()->getReactor("A");
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+    assertTrue(fd >= 0 && connect(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) == 0, "Cannot connect");
+
+    ObservationEncoder encoder;
+    ObservationByValue unknownPredicate("s", "Sensor.Writes");
+    unknownPredicate.push_back("value", new IntervalIntDomain(1, 1));
+    ObservationByValue unknownParameter("s", "Sensor.Reads");
+    unknownParameter.push_back("speed", new IntervalIntDomain(1, 1));
+    ObservationByValue wrongType("s", "Sensor.Reads");
+    wrongType.push_back("value", new SymbolDomain(LabelStr("high"), SymbolDT::instance()));
+    ObservationByValue one("s", "Sensor.Reads");
+    one.push_back("value", new IntervalIntDomain(1, 1));
+    ObservationByValue two("s", "Sensor.Reads");
+    two.push_back("value", new IntervalIntDomain(2, 2));
+
+    // Tick 0: invalid frames then a valid one. Tick 1: invalid frames only. Tick 2: a new value.
+    const Observation* frames[3][3] = {{&unknownPredicate, &unknownParameter, &one},
+				       {&unknownParameter, &unknownPredicate, &wrongType},
+				       {&two, NULL, NULL}};
+    std::set<int> before;
+    for(unsigned int tick = 0; tick < 3; tick++){
+      std::string data;
+      for(unsigned int i = 0; i < 3 && frames[tick][i] != NULL; i++)
+	encoder.encode(*frames[tick][i], data);
+      assertTrue(write(fd, data.data(), data.size()) == (ssize_t) data.size());
+
+      Agent::instance()->doNext();
+      std::set<int> keys;
+      getPlanKeys(db, keys);
+      std::vector<int> added;
+      std::set_difference(keys.begin(), keys.end(), before.begin(), before.end(), std::back_inserter(added));
+      std::ostringstream ss;
+      ss << "Tick " << tick << ": " << added.size() << " new tokens";
+      assertTrue(added.empty() == (tick == 1), ss.str());
+      before.swap(keys);
+    }
+
+    close(fd);
+    Agent::reset();
+    delete root;
+    return true;
+  }
+
   static bool testFileSearch(){
     setenv("TREX_START_DIR", "search_tests/a", 1);
     runAgentWithSchema("st.cfg", 50, "search_test.0");
@@ -229,6 +792,227 @@ private:
     return true;
   }
 
+  /**
+   * @brief Step the given reactor if it has work, and check that the horizon of the other one, as seen by its
+   * deliberation filter too, did not change.
+   */
+  static void checkHorizonKept(const DbCoreId& stepped, const DbCoreId& other){
+    if(!stepped->hasWork())
+      return;
+    IntervalIntDomain before(other->getPlanningHorizon());
+    stepped->doResume();
+    assertTrue(other->getPlanningHorizon() == before, other->getPlanningHorizon().toString());
+    assertTrue(DeliberationFilter::getHorizon(other->getPlanDatabase()) == before,
+	       DeliberationFilter::getHorizon(other->getPlanDatabase()).toString());
+  }
+
+  /**
+   * @brief Interleave the same 2 reactors step by step and check that each one deliberates within its own horizon.
+   * B deliberating over its long horizon must not widen the horizon of A, and conversely.
+   */
+  static bool testPerReactorHorizon(){
+    PseudoClock clock(0.0, 15);
+    TiXmlElement* root = initXml(findFile("SqueezeObserver.cfg").c_str());
+    Agent::initialize(*root, clock);
+    LogManager::instance().handleInit();
+
+    DbCoreId a = Agent::instance()->getReactor("A");
+    DbCoreId b = Agent::instance()->getReactor("B");
+    assertTrue(a.isId() && b.isId());
+
+    bool diverged = false;
+    while(!Agent::instance()->missionCompleted()){
+      Agent::instance()->doNext();
+      // Step each reactor on its own, and check that it leaves the horizon of the other one as it was
+      checkHorizonKept(b, a);
+      checkHorizonKept(a, b);
+      const IntervalIntDomain& ha = a->getPlanningHorizon();
+      const IntervalIntDomain& hb = b->getPlanningHorizon();
+      if(ha.getUpperBound() != PLUS_INFINITY)
+	assertTrue(ha.getUpperBound() - ha.getLowerBound() <= a->getLookAhead(), ha.toString());
+      if(hb.getUpperBound() != PLUS_INFINITY){
+	assertTrue(hb.getUpperBound() - hb.getLowerBound() <= b->getLookAhead(), hb.toString());
+	diverged = diverged || hb.getUpperBound() - hb.getLowerBound() > a->getLookAhead();
+      }
+    }
+    assertTrue(diverged);
+
+    Agent::reset();
+    delete root;
+    return true;
+  }
+
+  /**
+   * @brief Every agenda policy must get both reactors of SqueezeObserver through the mission.
+   */
+  static bool testAgendaPolicies(){
+    static const char* policies[] = {"priority", "roundRobin", "weighted", "deadline"};
+    for(unsigned int i = 0; i < 4; i++){
+      PseudoClock clock(0.0, 15);
+      TiXmlElement* root = initXml(findFile("SqueezeObserver.cfg").c_str());
+      root->SetAttribute("agenda", policies[i]);
+      Agent::initialize(*root, clock, 0, true);
+      LogManager::instance().handleInit();
+
+      TeleoReactorId b = Agent::instance()->getReactor("B");
+      assertTrue(b.isId() && b->getShare() == 1.0);
+
+      while(!Agent::instance()->missionCompleted())
+	Agent::instance()->doNext();
+      assertTrue(!Agent::instance()->getEventLog().empty(), policies[i]);
+
+      Agent::reset();
+      delete root;
+    }
+
+    checkAgenda("roundRobin");
+    checkAgenda("weighted");
+    checkAgenda("deadline");
+    return true;
+  }
+
+  /**
+   * @brief Run Agenda.cfg with a policy and check the order of the steps. A has a share of 1 and a latency of 2,
+   * B a share of 3 and a latency of 1. Both always have work, except for the deadline policy where each has 4 steps per tick.
+   */
+  static void checkAgenda(const char* policy){
+    std::string name(policy);
+    PseudoClock clock(0.0, 20);
+    TiXmlElement* root = initXml(findFile("Agenda.cfg").c_str());
+    root->SetAttribute("agenda", policy);
+    if(name == "deadline")
+      for(TiXmlElement* child = root->FirstChildElement(); child != NULL; child = child->NextSiblingElement())
+	child->SetAttribute("stepsPerTick", 4);
+    Agent::initialize(*root, clock);
+    LogManager::instance().handleInit();
+    TimedReactor::steps().clear();
+
+    TeleoReactorId a = Agent::instance()->getReactor("A");
+    TeleoReactorId b = Agent::instance()->getReactor("B");
+    double shareB = 0.0;
+    unsigned int ticks = 0;
+    while(!Agent::instance()->missionCompleted()){
+      Agent::instance()->doNext();
+      ticks++;
+      double sa = Agent::instance()->getCpuShare(a), sb = Agent::instance()->getCpuShare(b);
+      // The achieved shares are fractions of the deliberation time of the tick
+      assertTrue(sa >= 0.0 && sb >= 0.0 && sa + sb <= 1.0 + 1e-9, name + ": cpu shares over 1");
+      shareB += sb;
+    }
+
+    const std::vector<std::pair<TICK, std::string> >& steps = TimedReactor::steps();
+    unsigned int countA = 0, countB = 0;
+    for(unsigned int i = 0; i < steps.size(); i++){
+      (steps[i].second == "A" ? countA : countB)++;
+      bool sameTick = (i > 0 && steps[i-1].first == steps[i].first);
+      if(name == "roundRobin" && sameTick)
+	assertTrue(steps[i-1].second != steps[i].second, "Round robin did not alternate");
+      // B plans for an earlier tick, so A only steps once B is done with the tick
+      if(name == "deadline" && sameTick)
+	assertTrue(steps[i-1].second == steps[i].second || steps[i].second == "A", "Deadline order not followed");
+    }
+    assertTrue(countA > 0 && countB > 0, name + ": a reactor was starved");
+
+    if(name == "weighted"){
+      // B gets 3 times the deliberation time of A
+      double ratio = (double) countB / countA;
+      assertTrue(ratio > 2.0 && ratio < 4.5, name + ": steps not in the ratio of the shares");
+      shareB /= ticks;
+      assertTrue(shareB > 0.6 && shareB < 0.9, name + ": cpu share not in the ratio of the shares");
+    }
+    if(name == "deadline")
+      assertTrue(countA == countB, name + ": steps missing");
+
+    Agent::reset();
+    delete root;
+  }
+
+  /**
+   * @brief Check the work queue of the synchronizer from its trace. Within a synchronization, a token is evaluated
+   * again only after a token was resolved or a default value inserted, since only these change the start, end or object
+   * of the tokens on the agenda. A token found out of scope comes back once another token gets resolved.
+   */
+  static bool testSynchronizationQueue(){
+    PseudoClock clock(0.0, 15);
+    TiXmlElement* root = initXml(findFile("SqueezeObserver.cfg").c_str());
+    root->SetAttribute("trace", "synchronization");
+    Agent::initialize(*root, clock);
+    LogManager::instance().handleInit();
+    while(!Agent::instance()->missionCompleted())
+      Agent::instance()->doNext();
+
+    std::vector<TraceRecord> records;
+    TraceLog::snapshot(records);
+    TraceLog::disable(TRACE_SYNCHRONIZATION);
+    Agent::reset();
+    delete root;
+
+    std::map<int, unsigned int> evaluated, parked;
+    unsigned int passes = 0, parks = 0, revived = 0, lastChange = 0;
+    for(unsigned int i = 0; i < records.size(); i++){
+      const TraceRecord& record = records[i];
+      switch(record.event){
+      case TRACE_SYNCH_RESOLVE:
+	passes++;
+	evaluated.clear();
+	parked.clear();
+	lastChange = i;
+	break;
+      case TRACE_SYNCH_RESOLVE_TOKEN:
+      case TRACE_SYNCH_INSERT_DEFAULT:
+	lastChange = i;
+	break;
+      case TRACE_SYNCH_EVALUATE: {
+	std::map<int, unsigned int>::iterator it = evaluated.find(record.key);
+	if(it != evaluated.end())
+	  assertTrue(lastChange > it->second, "Token evaluated again with no change in between");
+	evaluated[record.key] = i;
+	it = parked.find(record.key);
+	if(it != parked.end()){
+	  assertTrue(lastChange > it->second, "Parked token evaluated with no token resolved since");
+	  revived++;
+	  parked.erase(it);
+	}
+	break;
+      }
+      case TRACE_SYNCH_PARK:
+	parks++;
+	parked[record.key] = i;
+	break;
+      default:
+	break;
+      }
+    }
+    assertTrue(passes > 0 && parks > 0 && revived > 0);
+    return true;
+  }
+
+  /**
+   * @brief Run the same 2 reactors on a separate thread while the main thread writes debug output.
+   * Meant to be run under ThreadSanitizer as well: reactors should not touch state shared with the main thread.
+   */
+  static bool testAgentOnThread(){
+    class Runner: public Thread {
+    protected:
+      void *run(){
+	runAgentWithSchema("SqueezeObserver.cfg", 15, "SqueezeObserver");
+	return NULL;
+      }
+    } runner;
+
+    std::ostringstream out;
+    DebugStream::select(out);
+    runner.start();
+    for(unsigned int i = 0; i < 1000; i++)
+      DebugMessage::getStream().rdbuf()->sputn("main\n", 5);
+    runner.join();
+
+    // The reactors selected their own streams: none of their output came here
+    assertTrue(out.str().size() == 5000, out.str());
+    DebugStream::select(DebugMessage::getStream());
+    return true;
+  }
+
   /**
    * @brief Tests the recall functionality to force dispatch of recall commands based on detected plan failure.
    * Set up a 3 reactor system. 2 of them are deliberative reactors, one is an adapter. There are 3 timelines: a, b, c. The adapter manages
@@ -248,6 +1032,56 @@ private:
     return true;
   }
 
+  /**
+   * @brief startup.log lists the agent configuration, then the phases of each reactor in order, then the total.
+   * DbCore records the steps of its constructor before the agent records the whole construction.
+   */
+  static bool testStartupLog(){
+    PseudoClock clock(0.0, 5);
+    TiXmlElement* root = initXml(findFile("Recall.cfg").c_str());
+    Agent::initialize(*root, clock);
+
+    std::ifstream in(LogManager::instance().file_name("startup.log").c_str());
+    std::string line;
+    assertTrue(std::getline(in, line) && line == "reactor\tphase\tmsec", "Missing header");
+    std::vector<std::pair<std::string, std::string> > phases;
+    std::map<std::string, double> reactorTimes;
+    double total = -1;
+    while(std::getline(in, line)){
+      std::istringstream fields(line);
+      std::string reactor, phase;
+      double msec = -1;
+      fields >> reactor >> phase >> msec;
+      assertTrue(msec >= 0, "Invalid line " + line);
+      phases.push_back(std::make_pair(reactor, phase));
+      if(phase == "construct" || phase == "handleInit")
+	reactorTimes[reactor] += msec;
+      if(phase == "total")
+	total = msec;
+    }
+
+    static const char* expected[][2] = {{"Recall", "config"},
+					{"A", "model"}, {"A", "solver"}, {"A", "setup"}, {"A", "construct"}, {"A", "handleInit"},
+					{"B", "model"}, {"B", "solver"}, {"B", "setup"}, {"B", "construct"}, {"B", "handleInit"},
+					{"C", "construct"}, {"C", "handleInit"},
+					{"Recall", "total"}};
+    unsigned int count = sizeof(expected) / sizeof(expected[0]);
+    assertTrue(phases.size() == count, "Unexpected number of phases");
+    for(unsigned int i = 0; i < count; i++)
+      assertTrue(phases[i].first == expected[i][0] && phases[i].second == expected[i][1],
+		 "Unexpected phase " + phases[i].first + " " + phases[i].second);
+
+    // The reactors are set up one after the other within the total
+    double sum = 0;
+    for(std::map<std::string, double>::const_iterator it = reactorTimes.begin(); it != reactorTimes.end(); ++it)
+      sum += it->second;
+    assertTrue(sum <= total + 1e-3, "Reactor phases longer than the total");
+
+    Agent::reset();
+    delete root;
+    return true;
+  }
+
   /**
    * This test will see that when an internal timeline value becomes a fact, it is persisted unless a consistent and complete plan
    * produces a new fact to replace it. Planning will be resumed to try to recover the situation but this will always fail.
@@ -307,6 +1141,84 @@ private:
     return true;
   }
 
+  static void getPlanKeys(const DbCoreId& reactor, std::set<int>& keys){
+    DbCore::PlanDescription plan;
+    reactor->getPlanDescription(plan);
+    const std::vector<DbCore::PlanDescription::TimelineDescription>* timelines[] = {&plan.m_internalTimelines, &plan.m_externalTimelines};
+    for(unsigned int i = 0; i < 2; i++)
+      for(unsigned int j = 0; j < timelines[i]->size(); j++)
+	for(unsigned int k = 0; k < (*timelines[i])[j].tokens.size(); k++)
+	  keys.insert((*timelines[i])[j].tokens[k].key);
+  }
+
+  /**
+   * @brief Follow the repairs of the repair and recall scenarios in their trace. A local repair cancels the subtrees
+   * of the conflicting goals and keeps the rest of the plan: tokens of the previous plan keep their key, whereas a
+   * global relax would have replaced them with copies. When there is nothing to relax locally, or the local repair
+   * does not resolve, the whole database is relaxed.
+   */
+  static bool testLocalRepair(){
+    static const char* configs[][3] = {{"repair.0.cfg", "client", "server"}, {"repair.1.cfg", "client", "server"},
+				       {"repair.3.cfg", "client", "server"}, {"Recall.cfg", "A", "B"}};
+    unsigned int local = 0, global = 0;
+    for(unsigned int c = 0; c < 4; c++){
+      PseudoClock clock(0.0, 50);
+      TiXmlElement* root = initXml(findFile(configs[c][0]).c_str());
+      root->SetAttribute("trace", "synchronization,relax");
+      Agent::initialize(*root, clock);
+      LogManager::instance().handleInit();
+
+      DbCoreId reactors[2] = {Agent::instance()->getReactor(configs[c][1]), Agent::instance()->getReactor(configs[c][2])};
+      assertTrue(reactors[0].isId() && reactors[1].isId(), configs[c][0]);
+      unsigned int seen = 0;
+      while(!Agent::instance()->missionCompleted()){
+	std::set<int> before[2];
+	for(unsigned int i = 0; i < 2; i++)
+	  getPlanKeys(reactors[i], before[i]);
+
+	Agent::instance()->doNext();
+
+	std::vector<TraceRecord> records;
+	TraceLog::snapshot(records);
+	for(unsigned int i = 0; i < 2; i++){
+	  bool relaxed = false;
+	  std::set<int> cancelled;
+	  for(unsigned int j = seen; j < records.size(); j++){
+	    if(records[j].reactor != reactors[i]->getTraceId())
+	      continue;
+	    if(records[j].event == TRACE_RELAX_CANCEL){
+	      assertTrue(!relaxed, "Local relax must be tried before the global one");
+	      cancelled.insert(records[j].key);
+	    }
+	    else if(records[j].event == TRACE_RELAX_START)
+	      relaxed = true;
+	  }
+
+	  if(relaxed)
+	    global++;
+	  else if(!cancelled.empty()){
+	    local++;
+	    std::set<int> after;
+	    getPlanKeys(reactors[i], after);
+	    unsigned int kept = 0;
+	    for(std::set<int>::const_iterator it = before[i].begin(); it != before[i].end(); ++it)
+	      if(cancelled.find(*it) == cancelled.end() && after.find(*it) != after.end())
+		kept++;
+	    assertTrue(kept > 0, "Local repair did not keep the rest of the plan");
+	  }
+	}
+	seen = records.size();
+      }
+
+      TraceLog::disable(TRACE_SYNCHRONIZATION);
+      TraceLog::disable(TRACE_RELAX);
+      Agent::reset();
+      delete root;
+    }
+    assertTrue(local > 0 && global > 0);
+    return true;
+  }
+
   /**
    * Tests dispatching.
    */
@@ -329,14 +1241,64 @@ private:
     runAgentWithSchema("orienteering.4.cfg", 50, "orienteering.4");
     return true;
   }
+
+  /**
+   * @brief The next goal of the goal managers is cached when their solution changes. Check it against a scan of
+   * their solutions for every token, at every tick. Few steps per tick so that ticks end in the middle of planning.
+   */
+  static bool testNextGoalCache(){
+    unsigned int nextGoals = 0;
+    for(unsigned int i = 0; i < 5; i++){
+      std::ostringstream cfg;
+      cfg << "orienteering." << i << ".cfg";
+      PseudoClock clock(0.0, 5);
+      TiXmlElement* root = initXml(findFile(cfg.str()).c_str());
+      Agent::initialize(*root, clock);
+      LogManager::instance().handleInit();
+      DbCoreId db = Agent::instance()->getReactor("orienteer");
+
+      while(!Agent::instance()->missionCompleted()){
+	Agent::instance()->doNext();
+	const TokenSet& tokens = db->getPlanDatabase()->getTokens();
+	for(TokenSet::const_iterator it = tokens.begin(); it != tokens.end(); ++it){
+	  bool next = TREX::OrienteeringSolver::isGlobalNextGoal(*it);
+	  assertTrue(next == TREX::OrienteeringSolver::scanGlobalNextGoal(*it), cfg.str() + ": stale next goal " + (*it)->toString());
+	  if(next)
+	    nextGoals++;
+	}
+      }
+
+      Agent::reset();
+      delete root;
+    }
+    assertTrue(nextGoals > 0, "No next goal was ever selected");
+    return true;
+  }
 };
 
 class AgentTests {
 public:
   static bool test(){
     runTest(testRealTimeClock);
+    runTest(testRealTimeClockDeadline);
+    runTest(testDeferredStep);
+    runTest(testBurstCap);
+    runTest(testCpusAttribute);
     runTest(testForeverConfiguration);
     runTest(testTimelimitOverride);
+    runTest(testMultipleAgents);
+    runTest(testLatencyHistogram);
+    runTest(testTraceLog);
+    runTest(testCompression);
+    runTest(testDebugStream);
+    runTest(testObservationBuffer);
+    runTest(testObservationPool);
+    runTest(testObservationCodec);
+    runTest(testObservationBus);
+    runTest(testCheckpoint);
+    runTest(testCheckpointResume);
+    runTest(testMonitorCapacity);
+    runTest(testCompaction);
     return true;
   }
 
@@ -371,6 +1333,127 @@ private:
     return true;
   }
 
+  static bool testRealTimeClockDeadline(){
+    RealTimeClock clk(0.1);
+    clk.start();
+
+    // An absolute sleep wakes up at the tick date. The checks below only rely on sleeps not
+    // ending early: a loaded machine may wake up late, which only adds overruns.
+    double left = clk.timeToDeadline();
+    assertTrue(left > 0 && left <= 0.1);
+    clk.sleep();
+    TICK tick = clk.getNextTick();
+    assertTrue(tick >= 1 && clk.overruns() == tick - 1 && clk.jitter().count() == 1);
+
+    // Missing ticks counts overruns: at least 2 when sleeping 2.5 ticks past a tick date
+    clk.sleep();
+    Clock::sleep(0.25);
+    assertTrue(clk.timeToDeadline() < 0);
+    TICK next = clk.getNextTick();
+    assertTrue(next >= tick + 3, "Missed ticks not counted");
+    assertTrue(clk.overruns() == next - 2 && clk.jitter().count() == 2);
+
+    PseudoClock pseudo(0.0, 1);
+    assertTrue(pseudo.timeToDeadline() > 1e9);
+    return true;
+  }
+
+  /**
+   * @brief A deliberator whose steps no longer fit in what the other reactors leave of a tick is deferred,
+   * but runs on the next tick whatever its estimate instead of waiting forever.
+   */
+  static bool testDeferredStep(){
+    RealTimeClock clock(0.1);
+    TiXmlElement* root = initXml(findFile("Deferral.cfg").c_str());
+    Agent::initialize(*root, clock);
+    TeleoReactorId slow = Agent::instance()->getReactor("Slow");
+    Agent::instance()->run();
+
+    const TimedReactor* reactor = dynamic_cast<const TimedReactor*>((TeleoReactor*) slow);
+    const std::vector<TICK>& ticks = reactor->stepTicks();
+    assertTrue(reactor->getDeferredCount() > 0, "The slow step was never deferred");
+    // A step deferred at some tick runs at the next one, even on a loaded machine
+    assertTrue(ticks.size() >= Agent::instance()->getFinalTick() / 2, "The slow reactor was starved");
+    for(unsigned int i = 1; i < ticks.size(); i++)
+      assertTrue(ticks[i] <= ticks[i-1] + 2, "The slow reactor waited more than a tick");
+
+    Agent::reset();
+    delete root;
+    return true;
+  }
+
+  /**
+   * @brief A zero latency reactor that always has work would never cede control. The burst cap stops its bursts,
+   * so that the agent sees the end of the ticks and completes the mission.
+   */
+  static bool testBurstCap(){
+    PseudoClock clock(0.0, 20);
+    TiXmlElement* root = initXml(findFile("Burst.cfg").c_str());
+    Agent::initialize(*root, clock);
+    LogManager::instance().handleInit();
+    TimedReactor::steps().clear();
+
+    // Without the cap, the first doNext would not return
+    unsigned int ticks = 0;
+    while(!Agent::instance()->missionCompleted()){
+      Agent::instance()->doNext();
+      ticks++;
+    }
+
+    // Every tick ends between 2 bursts of 5 steps
+    std::map<TICK, unsigned int> stepsPerTick;
+    const std::vector<std::pair<TICK, std::string> >& steps = TimedReactor::steps();
+    for(unsigned int i = 0; i < steps.size(); i++)
+      stepsPerTick[steps[i].first]++;
+    assertTrue(stepsPerTick.size() == ticks, "Not stepped at every tick");
+    for(std::map<TICK, unsigned int>::const_iterator it = stepsPerTick.begin(); it != stepsPerTick.end(); ++it)
+      assertTrue(it->second > 0 && it->second % 5 == 0, "A burst went past the cap");
+
+    Agent::reset();
+    delete root;
+    return true;
+  }
+
+  static bool testCpusAttribute(){
+    std::vector<int> cpus = Agent::parseCpus("2");
+    assertTrue(cpus.size() == 1 && cpus[0] == 2);
+    cpus = Agent::parseCpus("0,2-4,7");
+    assertTrue(cpus.size() == 5 && cpus[0] == 0 && cpus[1] == 2 && cpus[3] == 4 && cpus[4] == 7);
+    cpus = Agent::parseCpus("3-3");
+    assertTrue(cpus.size() == 1 && cpus[0] == 3);
+
+    static const char* invalid[] = {"", ",", "1,", ",1", "1,,2", "a", "1a", "1-", "-1", "3-1", " 1", "1 ", "+1", "1-2-3",
+				    "0-99999", "99999999999999999999"};
+    for(unsigned int i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++){
+      bool rejected = false;
+      try {
+	Agent::parseCpus(invalid[i]);
+      }
+      catch(ConfigurationException* e){
+	rejected = true;
+	delete e;
+      }
+      assertTrue(rejected, std::string("Accepted cpus ") + invalid[i]);
+    }
+
+    // Invalid settings are rejected before the agent is built
+    PseudoClock clock(0.0, 1);
+    TiXmlElement* root = initXml("Forever.cfg");
+    root->SetAttribute("scheduler", "batch");
+    bool rejected = false;
+    try {
+      Agent::initialize(*root, clock, 10);
+    }
+    catch(ConfigurationException* e){
+      rejected = true;
+      delete e;
+    }
+    assertTrue(rejected, "Accepted scheduler batch");
+    assertTrue(Agent::instance().isNoId(), "An agent was left behind");
+    delete root;
+    return true;
+  }
+
   static bool testForeverConfiguration(){
     PseudoClock clock(0.0, 1);
     TiXmlElement* root = initXml("Forever.cfg");
@@ -398,6 +1481,646 @@ private:
     delete root;
     return true;
   }
+
+  static bool testMultipleAgents(){
+    PseudoClock clockA(0.0, 1), clockB(0.0, 1);
+    TiXmlElement* root = initXml("Forever.cfg");
+
+    // An agent that fails to build does not count: the next one is still the first
+    TiXmlElement invalid(*root);
+    invalid.SetAttribute("agenda", "none");
+    bool rejected = false;
+    try {
+      Agent::initialize(invalid, clockA, 10);
+    }
+    catch(ConfigurationException* e){
+      rejected = true;
+      delete e;
+    }
+    assertTrue(rejected && Agent::instance().isNoId());
+
+    AgentId a = Agent::initialize(*root, clockA, 10);
+    assertTrue(LogManager::s_current == NULL, "The first agent does not use the logs of the process");
+    AgentId b = Agent::initialize(*root, clockB, 20);
+
+    // The last one created is current, and has its own logs
+    assertTrue(a != b && Agent::instance() == b);
+    std::string logsB = LogManager::instance().get_log_path();
+    {
+      Agent::Scope scope(a);
+      assertTrue(Agent::instance() == a && Agent::instance()->getFinalTick() == (TICK) 10);
+      assertTrue(LogManager::instance().get_log_path() != logsB);
+
+      // "latest" still refers to the logs of the first agent
+      const char* base = getenv("TREX_LOG_DIR");
+      char link[PATH_MAX];
+      ssize_t length = readlink((std::string(base != NULL ? base : ".") + "/" + LATEST_DIR).c_str(), link, sizeof(link));
+      assertTrue(length > 0 && std::string(link, length) == LogManager::instance().get_log_path());
+    }
+    assertTrue(Agent::instance() == b && Agent::instance()->getFinalTick() == (TICK) 20);
+
+    // Stepping one agent leaves the other one where it was
+    b->doNext();
+    assertTrue(b->getCurrentTick() == 1 && a->getCurrentTick() == 0);
+    assertTrue(Agent::instance() == b);
+
+    // Back to the first agent once the current one is gone
+    Agent::reset();
+    assertTrue(Agent::instance() == a);
+    Agent::reset();
+    assertTrue(Agent::instance().isNoId());
+
+    delete root;
+    return true;
+  }
+
+  static bool testLatencyHistogram(){
+    LatencyHistogram h("test");
+    assertTrue(h.count() == 0 && h.percentile(0.5) == 0);
+
+    // 1..1000 microseconds
+    for(uint64_t i=1; i<=1000; i++)
+      h.record(i*1000);
+
+    assertTrue(h.count() == 1000);
+    assertTrue(h.min() == 1000 && h.max() == 1000000);
+
+    // Buckets are accurate to 1%
+    uint64_t p50 = h.percentile(0.5), p99 = h.percentile(0.99);
+    assertTrue(p50 >= 500000 && p50 <= 505000);
+    assertTrue(p99 >= 990000 && p99 <= 1000000);
+
+    LatencyHistogram total("test");
+    total.add(h);
+    total.add(h);
+    h.reset();
+    assertTrue(h.count() == 0 && total.count() == 2000);
+    assertTrue(total.percentile(0.5) == p50);
+    return true;
+  }
+
+  static bool testTraceLog(){
+    TraceLog::setCapacity(4);
+    TraceLog::reset();
+    uint16_t reactor = TraceLog::reactorId("r");
+    assertTrue(reactor == 0 && TraceLog::reactorId("r") == reactor);
+
+    // Disabled categories are not recorded, and the ring keeps the last records
+    TREX_TRACE(TRACE_DBCORE, TRACE_DBCORE_COMMIT, 1, reactor, 10, 0);
+    TraceLog::enable("synchronization");
+    for(int i = 0; i < 6; i++)
+      TREX_TRACE(TRACE_SYNCHRONIZATION, TRACE_SYNCH_EVALUATE, i, reactor, 100 + i, i);
+    TraceLog::disable(TRACE_SYNCHRONIZATION);
+    std::vector<TraceRecord> records;
+    TraceLog::snapshot(records);
+    assertTrue(records.size() == 4);
+    for(int i = 0; i < 4; i++)
+      assertTrue(records[i].key == 102 + i && records[i].tick == (uint32_t) (2 + i) && records[i].arg == 2 + i &&
+		 records[i].reactor == reactor && records[i].category == TRACE_SYNCHRONIZATION && records[i].event == TRACE_SYNCH_EVALUATE);
+
+    // The layout read by trextrace
+    assertTrue(TraceLog::dump("trace.test.bin"));
+    std::ifstream in("trace.test.bin", std::ios::binary);
+    std::string file((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    const char* data = file.data();
+    assertTrue(file.compare(0, 8, "TRXTRACE") == 0);
+    data += 8;
+    assertTrue(readU32(data) == 1 && readU32(data) == sizeof(TraceRecord));
+    assertTrue(readU32(data) == TRACE_CATEGORY_COUNT && readString(data) == "synchronization");
+    for(unsigned int i = 1; i < TRACE_CATEGORY_COUNT; i++)
+      readString(data);
+    assertTrue(readU32(data) == TRACE_EVENT_COUNT);
+    for(unsigned int i = 0; i < TRACE_EVENT_COUNT; i++){
+      uint32_t category = readU32(data);
+      std::string marker = readString(data), text = readString(data);
+      if(i == TRACE_SYNCH_EVALUATE)
+	assertTrue(category == TRACE_SYNCHRONIZATION && marker == "trex:debug:synchronization:resolveTokens" && text == "Evaluating token({key})");
+    }
+    assertTrue(readU32(data) == 1 && readString(data) == "r");
+    uint32_t buffers = readU32(data), count = 0;
+    for(uint32_t i = 0; i < buffers; i++){
+      readU32(data);
+      uint32_t n = readU32(data);
+      for(uint32_t j = 0; j < n; j++, count++){
+	TraceRecord record;
+	memcpy(&record, data, sizeof(record));
+	data += sizeof(record);
+	assertTrue(record.key == records[count].key && record.nsec == records[count].nsec);
+      }
+    }
+    assertTrue(count == 4 && data == file.data() + file.size());
+    unlink("trace.test.bin");
+
+    // A new run starts empty
+    TraceLog::setCapacity(1<<16);
+    TraceLog::reset();
+    records.clear();
+    TraceLog::snapshot(records);
+    assertTrue(records.empty());
+    return true;
+  }
+
+  static bool checkRoundTrip(const std::string& raw){
+    std::string block, out("x");
+    compress(raw.data(), raw.length(), block);
+    return uncompress(block.data(), block.length(), raw.length(), out) && out == "x" + raw;
+  }
+
+  /**
+   * @brief compress and uncompress must restore any input, including matches longer than a nibble, matches far back
+   * in the output and data that does not compress. Corrupted blocks must be rejected.
+   */
+  static bool testCompression(){
+    assertTrue(checkRoundTrip(""));
+    assertTrue(checkRoundTrip("a"));
+    assertTrue(checkRoundTrip("abcdabcdabcdabcdabcdabcdabcdabcdabcdabcd"));
+    assertTrue(checkRoundTrip(std::string(100000, 'z')));
+
+    std::ostringstream tsv;
+    for(unsigned int i = 0; i < 5000; i++)
+      tsv << i << "\tNumberTimeline.holds\t" << i % 7 << "\t[0 +inf]\n";
+    assertTrue(checkRoundTrip(tsv.str()));
+
+    std::string noise;
+    unsigned int seed = 12345;
+    for(unsigned int i = 0; i < 70000; i++){
+      seed = seed * 1103515245 + 12345;
+      noise += (char) (seed >> 16);
+    }
+    assertTrue(checkRoundTrip(noise));
+    assertTrue(checkRoundTrip(noise + tsv.str() + noise));
+
+    std::string block, out;
+    compress(tsv.str().data(), tsv.str().length(), block);
+    assertTrue(block.length() < tsv.str().length() / 2);
+    assertTrue(!uncompress(block.data(), block.length(), tsv.str().length() + 1, out));
+    out.clear();
+    assertTrue(!uncompress(block.data(), block.length() / 2, tsv.str().length(), out));
+    // A size no block could expand to is rejected before anything is allocated for it
+    out.clear();
+    assertTrue(!uncompress(block.data(), block.length(), block.length() * 256, out));
+    assertTrue(out.capacity() < block.length() * 256);
+    return true;
+  }
+
+  static bool testDebugStream(){
+    DebugWriter a, b;
+    std::ostream& before = DebugStream::current();
+    a.start();
+    b.start();
+    a.join();
+    b.join();
+
+    // Each thread only sees its own output, and the main thread is unaffected
+    assertTrue(a.m_out.str().size() == 2000 && b.m_out.str().size() == 2000);
+    assertTrue(&DebugStream::current() == &before);
+
+    // Many reactors logging at once, each thread switching between its own reactors
+    std::vector<ReactorLogger*> loggers;
+    for(char id = 'a'; id < 'i'; id++)
+      loggers.push_back(new ReactorLogger(id));
+    for(unsigned int i = 0; i < loggers.size(); i++)
+      loggers[i]->start();
+    for(unsigned int i = 0; i < loggers.size(); i++){
+      loggers[i]->join();
+      assertTrue(loggers[i]->check());
+      delete loggers[i];
+    }
+    assertTrue(&DebugStream::current() == &before);
+    return true;
+  }
+
+  static bool testObservationBuffer(){
+    class Recorder: public Observer {
+    public:
+      void notify(const Observation& observation){
+	m_received.push_back(observation.getObjectName().toString() + "." + observation.getPredicate().toString());
+      }
+      std::vector<std::string> m_received;
+    } recorder;
+
+    ObservationBuffer buffer;
+    buffer.push(ObservationByValue("a", "A.First"));
+    buffer.push(ObservationByValue("b", "B.Only"));
+    buffer.push(ObservationByValue("a", "A.Last"));
+    buffer.push(ObservationByValue("c", "C.First"), false);
+    buffer.push(ObservationByValue("c", "C.Last"), false);
+    assertTrue(buffer.coalesced() == 1);
+
+    // Latest value of a in the place of the first, and every value of c
+    buffer.flush(recorder);
+    assertTrue(buffer.empty());
+    assertTrue(recorder.m_received.size() == 4);
+    assertTrue(recorder.m_received[0] == "a.A.Last" && recorder.m_received[1] == "b.B.Only");
+    assertTrue(recorder.m_received[2] == "c.C.First" && recorder.m_received[3] == "c.C.Last");
+    return true;
+  }
+
+  static bool testObservationPool(){
+    // More parameters than stored inline
+    ObservationByValue* first = ObservationPool::acquire("a", "A.Pred");
+    for(int i = 0; i < 6; i++){
+      std::stringstream name;
+      name << "p" << i;
+      first->push_back(LabelStr(name.str()), new IntervalIntDomain(i, i));
+    }
+    assertTrue(first->countParameters() == 6);
+    assertTrue((*first)[5].first == LabelStr("p5") && (*first)[5].second->getSingletonValue() == 5);
+    assertTrue((*first)[1].first == LabelStr("p1") && (*first)[1].second->getSingletonValue() == 1);
+    ObservationPool::release(first);
+
+    // Recycled without its former parameters
+    ObservationByValue* second = ObservationPool::acquire("b", "B.Pred");
+    assertTrue(second == first);
+    assertTrue(second->countParameters() == 0 && second->getObjectName() == LabelStr("b") && second->getPredicate() == LabelStr("B.Pred"));
+    ObservationPool::release(second);
+    return true;
+  }
+
+  static bool testObservationCodec(){
+    ObservationByValue obs("a", "A.Pred");
+    obs.push_back("i", new IntervalIntDomain(3, 7));
+    obs.push_back("f", new IntervalDomain(0.5));
+    obs.push_back("b", new BoolDomain(true));
+    obs.push_back("s", new SymbolDomain(LabelStr("on"), SymbolDT::instance()));
+
+    ObservationEncoder encoder;
+    std::string first, second;
+    encoder.encode(obs, first);
+    encoder.encode(obs, second);
+    // Labels are only sent with the first observation
+    assertTrue(second.size() < first.size());
+
+    int fds[2];
+    assertTrue(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+    fcntl(fds[1], F_SETFL, fcntl(fds[1], F_GETFL) | O_NONBLOCK);
+    assertTrue(write(fds[0], first.data(), first.size()) == (ssize_t) first.size());
+    // Split the second observation to check that partial frames are kept
+    assertTrue(write(fds[0], second.data(), 3) == 3);
+
+    ObservationDecoder decoder;
+    assertTrue(decoder.read(fds[1]));
+    ObservationByValue* decoded = decoder.next();
+    assertTrue(decoded != NULL && decoder.next() == NULL);
+    assertTrue(decoded->getObjectName() == LabelStr("a") && decoded->getPredicate() == LabelStr("A.Pred"));
+    assertTrue(decoded->countParameters() == 4);
+    for(unsigned int i = 0; i < 4; i++)
+      assertTrue(decoded->operator[](i).first == obs[i].first && *(decoded->operator[](i).second) == *(obs[i].second));
+    ObservationPool::release(decoded);
+
+    assertTrue(write(fds[0], second.data() + 3, second.size() - 3) == (ssize_t) (second.size() - 3));
+    close(fds[0]);
+    assertTrue(!decoder.read(fds[1]));
+    decoded = decoder.next();
+    assertTrue(decoded != NULL && *(decoded->operator[](3).second) == *(obs[3].second));
+    ObservationPool::release(decoded);
+    close(fds[1]);
+
+    // Bounds that EUROPA would not accept are rejected as a corrupted stream
+    double const nan = std::numeric_limits<double>::quiet_NaN(), inf = std::numeric_limits<double>::infinity();
+    assertTrue(decodesInterval(new IntervalIntDomain(3, 7), 3, 7));
+    assertTrue(decodesInterval(new IntervalIntDomain(3, 7), MINUS_INFINITY, PLUS_INFINITY));
+    assertTrue(!decodesInterval(new IntervalIntDomain(3, 7), nan, 7));
+    assertTrue(!decodesInterval(new IntervalIntDomain(3, 7), 3, nan));
+    assertTrue(!decodesInterval(new IntervalIntDomain(3, 7), 3, inf));
+    assertTrue(!decodesInterval(new IntervalIntDomain(3, 7), -1e300, 7));
+    assertTrue(!decodesInterval(new IntervalIntDomain(3, 7), 3, 1e12));
+    assertTrue(!decodesInterval(new IntervalIntDomain(3, 7), 3.5, 7));
+    assertTrue(decodesInterval(new IntervalDomain(0.5), 0.25, 0.75));
+    assertTrue(!decodesInterval(new IntervalDomain(0.5), nan, 0.75));
+    assertTrue(!decodesInterval(new IntervalDomain(0.5), -inf, 0.75));
+    assertTrue(!decodesInterval(new IntervalDomain(0.5), 0.25, 1e300));
+    return true;
+  }
+
+  /**
+   * @brief Encode an observation with the single parameter @e dom, overwrite its bounds with @e lb and @e ub
+   * and tell whether the decoder accepts it.
+   */
+  static bool decodesInterval(AbstractDomain* dom, double lb, double ub){
+    ObservationByValue obs("a", "A.Pred");
+    obs.push_back("x", dom);
+    ObservationEncoder encoder;
+    std::string frames;
+    encoder.encode(obs, frames);
+    memcpy(&frames[frames.size() - 2 * sizeof(double)], &lb, sizeof(lb));
+    memcpy(&frames[frames.size() - sizeof(double)], &ub, sizeof(ub));
+
+    ObservationDecoder decoder;
+    decoder.append(frames.data(), frames.size());
+    try {
+      ObservationByValue* decoded = decoder.next();
+      bool const valid = (decoded != NULL);
+      ObservationPool::release(decoded);
+      return valid;
+    }
+    catch(ErrnoExcept const&){
+      return false;
+    }
+  }
+
+  static bool testObservationBus(){
+    ObservationBus bus("/trex.module-tests", 4096);
+    ObservationBusReader reader(bus.name(), true);
+    BusRecord record;
+    assertTrue(!reader.next(record));
+
+    ObservationByValue obs("a", "A.Pred");
+    obs.push_back("i", new IntervalIntDomain(3, 7));
+    bus.publish(5, obs);
+    assertTrue(reader.next(record) && !reader.next(record));
+    assertTrue(record.kind == ObservationBus::OBSERVATION && record.tick == 5);
+    BusRecord::Cursor cursor(record);
+    assertTrue(cursor.str() == "a" && cursor.str() == "A.Pred" && cursor.u16() == 1 && cursor.str() == "i");
+    assertTrue(cursor.u8() == ObservationEncoder::INT && cursor.f64() == 3 && cursor.f64() == 7);
+
+    // A reader left behind loses the oldest records, but not the most recent one
+    for(TICK i = 0; i < 1000; i++)
+      bus.publish(i, obs);
+    TICK last = -1;
+    while(reader.next(record))
+      last = record.tick;
+    assertTrue(reader.lost() > 0 && last == 999);
+
+    // Plan counts past the range of a u16
+    bus.beginPlan(1000, "r", 70000);
+    bus.addTimeline("t", 65536);
+    bus.endPlan();
+    assertTrue(reader.next(record) && record.kind == ObservationBus::PLAN);
+    BusRecord::Cursor plan(record);
+    assertTrue(plan.str() == "r" && plan.u32() == 70000 && plan.str() == "t" && plan.u32() == 65536 && plan.done());
+
+    // A record larger than half the ring is dropped, and counted
+    assertTrue(bus.dropped() == 0);
+    bus.beginPlan(1001, "r", 64);
+    for(unsigned int i = 0; i < 64; i++)
+      bus.addTimeline(std::string(64, 't'), 0);
+    bus.endPlan();
+    assertTrue(bus.dropped() == 1 && !reader.next(record));
+
+    // The bus of a running agent is not taken over
+    bool rejected = false;
+    try {
+      ObservationBus other(bus.name(), 4096);
+    }
+    catch(ErrnoExcept const&){
+      rejected = true;
+    }
+    assertTrue(rejected, "Replaced the bus of a running agent");
+    bus.publish(1002, obs);
+    assertTrue(reader.next(record) && record.tick == 1002, "The bus stopped working");
+    return true;
+  }
+
+  static bool testCheckpoint(){
+    Checkpoint saved("agent", 42);
+    Checkpoint::Token token;
+    token.kind = Checkpoint::GOAL;
+    token.predicate = "A.Pred";
+    Checkpoint::Domain start;
+    start.form = Checkpoint::INTERVAL;
+    start.lb = 3;
+    start.ub = 7;
+    token.variables.push_back(std::make_pair(std::string("start"), start));
+    Checkpoint::Domain object;
+    object.form = Checkpoint::OBJECTS;
+    object.labels.push_back("a");
+    token.variables.push_back(std::make_pair(std::string("object"), object));
+    token.key = 7;
+    Checkpoint::Domain dispatched;
+    dispatched.form = Checkpoint::NUMBERS;
+    dispatched.numbers.push_back(41);
+    token.specified.push_back(std::make_pair(std::string("dispatch_time"), dispatched));
+    Checkpoint::Link link;
+    link.local = 7;
+    link.reactor = "other";
+    link.foreign = 12;
+    Checkpoint::Reactor& reactor = saved.addReactor("r");
+    reactor.tokens.push_back(token);
+    reactor.links.push_back(link);
+    saved.write("checkpoint.bin");
+
+    Checkpoint loaded;
+    loaded.read("checkpoint.bin");
+    assertTrue(loaded.agent() == "agent" && loaded.tick() == 42 && loaded.reactor("other") == NULL);
+    const Checkpoint::Reactor* r = loaded.reactor("r");
+    assertTrue(r != NULL && r->tokens.size() == 1);
+    const Checkpoint::Token& t = r->tokens[0];
+    assertTrue(t.kind == Checkpoint::GOAL && t.predicate == "A.Pred" && t.variables.size() == 2);
+    assertTrue(t.variables[0].second.form == Checkpoint::INTERVAL && t.variables[0].second.lb == 3 && t.variables[0].second.ub == 7);
+    assertTrue(t.variables[1].first == "object" && t.variables[1].second.labels.size() == 1 && t.variables[1].second.labels[0] == "a");
+    assertTrue(t.key == 7 && t.specified.size() == 1 && t.specified[0].first == "dispatch_time");
+    assertTrue(t.specified[0].second.form == Checkpoint::NUMBERS && t.specified[0].second.numbers.size() == 1 && t.specified[0].second.numbers[0] == 41);
+    assertTrue(r->links.size() == 1 && r->links[0].local == 7 && r->links[0].reactor == "other" && r->links[0].foreign == 12);
+
+    // A corrupted size is rejected without trying to allocate it
+    {
+      std::fstream patch("checkpoint.bin", std::ios::in | std::ios::out | std::ios::binary);
+      uint32_t huge = 0xffffffff;
+      patch.seekp(12);
+      patch.write(reinterpret_cast<const char*>(&huge), sizeof(huge));
+    }
+    assertTrue(!readsCheckpoint("checkpoint.bin"));
+
+    // A truncated file is rejected
+    saved.write("checkpoint.bin");
+    truncate("checkpoint.bin", 12);
+    assertTrue(!readsCheckpoint("checkpoint.bin"));
+    unlink("checkpoint.bin");
+    return true;
+  }
+
+  /**
+   * @brief True if @e path is read as a checkpoint, false if it is rejected
+   */
+  static bool readsCheckpoint(const char* path){
+    Checkpoint loaded;
+    try {
+      loaded.read(path);
+    }
+    catch(ErrnoExcept const&){
+      return false;
+    }
+    return true;
+  }
+
+  /**
+   * @brief The name of the timeline of a token saved in a checkpoint. Empty if not bound to one.
+   */
+  static std::string timelineOf(const Checkpoint::Token& token){
+    for(unsigned int i = 0; i < token.variables.size(); i++)
+      if(token.variables[i].first == "object" && token.variables[i].second.labels.size() == 1)
+	return token.variables[i].second.labels[0];
+    return "";
+  }
+
+  /**
+   * @brief Describe the current values of a checkpoint, in any order, and its plan, in order. A dispatched token
+   * is described as any other planned one, as whether it is dispatched depends on its server.
+   */
+  static void describeCheckpoint(const Checkpoint::Reactor& state, std::multiset<std::string>& current, std::vector<std::string>& plan){
+    for(std::vector<Checkpoint::Token>::const_iterator it = state.tokens.begin(); it != state.tokens.end(); ++it){
+      bool planned = (it->kind == Checkpoint::PLANNED || it->kind == Checkpoint::PLANNED_GOAL || it->kind == Checkpoint::DISPATCHED);
+      std::ostringstream out;
+      out << (int) (it->kind == Checkpoint::DISPATCHED ? Checkpoint::PLANNED : it->kind) << " " << it->predicate << " " << timelineOf(*it);
+      if(planned)
+	plan.push_back(out.str());
+      else
+	current.insert(out.str());
+    }
+  }
+
+  /**
+   * @brief Resume an agent from the checkpoint of another one, once A has dispatched requests to B and C in the
+   * Recall scenario. The resumed agent starts with the same current values, plan and links of goals to requests:
+   * capturing its state again gives back the checkpoint. The requests B linked to its goals are not dispatched
+   * again. C is an adapter built anew, so the requests it was sent are dispatched again.
+   */
+  static bool testCheckpointResume(){
+    Checkpoint saved;
+    std::map<std::string, unsigned int> dispatched;
+    {
+      PseudoClock clock(0.0, 50);
+      TiXmlElement* root = initXml(findFile("Recall.cfg").c_str());
+      root->SetAttribute("checkpoint", "resume.bin");
+      root->SetAttribute("checkpointPeriod", "1");
+      Agent::initialize(*root, clock);
+      LogManager::instance().handleInit();
+
+      while((dispatched["b"] == 0 || dispatched["c"] == 0) && !Agent::instance()->missionCompleted()){
+	Agent::instance()->doNext();
+	Agent::instance()->waitForCheckpoint();
+	saved.read("resume.bin");
+	assertTrue(saved.tick() < Agent::instance()->getCurrentTick());
+	dispatched.clear();
+	for(unsigned int r = 0; r < 2; r++){
+	  const Checkpoint::Reactor* state = saved.reactor(r == 0 ? "A" : "B");
+	  assertTrue(state != NULL);
+	  for(unsigned int i = 0; i < state->tokens.size(); i++)
+	    if(state->tokens[i].kind == Checkpoint::DISPATCHED)
+	      dispatched[timelineOf(state->tokens[i])]++;
+	}
+      }
+
+      Agent::reset();
+      delete root;
+    }
+    assertTrue(dispatched["b"] > 0 && dispatched["c"] > 0, "A never dispatched requests to both B and C");
+    assertTrue(saved.reactor("B") != NULL && !saved.reactor("B")->links.empty(), "B has no goal requested by A");
+
+    PseudoClock clock(0.0, 50);
+    TiXmlElement* root = initXml(findFile("Recall.cfg").c_str());
+    root->SetAttribute("trace", "dispatch");
+    Agent::initialize(*root, clock, 0, false, "resume.bin");
+    LogManager::instance().handleInit();
+    assertTrue(Agent::instance()->getCurrentTick() == saved.tick() + 1);
+
+    Checkpoint again(saved.agent(), saved.tick());
+    const char* names[] = {"A", "B"};
+    std::set<int> linked;
+    for(unsigned int i = 0; i < 2; i++){
+      DbCoreId db = Agent::instance()->getReactor(names[i]);
+      db->checkpoint(again);
+
+      std::multiset<std::string> savedCurrent, restoredCurrent;
+      std::vector<std::string> savedPlan, restoredPlan;
+      describeCheckpoint(*saved.reactor(names[i]), savedCurrent, savedPlan);
+      describeCheckpoint(*again.reactor(names[i]), restoredCurrent, restoredPlan);
+      assertTrue(savedCurrent == restoredCurrent, std::string("Current state of ") + names[i] + " differs");
+      assertTrue(savedPlan == restoredPlan, std::string("Plan of ") + names[i] + " differs");
+      assertTrue(saved.reactor(names[i])->links.size() == again.reactor(names[i])->links.size(),
+		 std::string("Goals of ") + names[i] + " lost their requests");
+
+      // Only the requests B holds as goals are still dispatched
+      const std::vector<Checkpoint::Token>& tokens = again.reactor(names[i])->tokens;
+      for(unsigned int j = 0; j < tokens.size(); j++)
+	if(tokens[j].kind == Checkpoint::DISPATCHED){
+	  assertTrue(timelineOf(tokens[j]) == "b", "A request to the adapter is still marked as dispatched");
+	  linked.insert(tokens[j].key);
+	}
+    }
+    assertTrue(linked.size() == dispatched["b"]);
+
+    // What B holds is not dispatched again, what C was sent is
+    Agent::instance()->doNext();
+    std::vector<TraceRecord> records;
+    TraceLog::snapshot(records);
+    unsigned int resent = 0;
+    for(unsigned int i = 0; i < records.size(); i++){
+      if(records[i].event != TRACE_DISPATCH_REQUEST)
+	continue;
+      assertTrue(linked.find(records[i].key) == linked.end(), "A request linked by B was requested again");
+      EntityId entity = Entity::getEntity(records[i].key);
+      if(entity.isId() && TokenId::convertable(entity)){
+	TokenId token = entity;
+	if(token->getObject()->lastDomain().isSingleton() &&
+	   ObjectId(token->getObject()->lastDomain().getSingletonValue())->getName() == LabelStr("c"))
+	  resent++;
+      }
+    }
+    assertTrue(resent >= dispatched["c"], "The requests to the adapter C were not dispatched again");
+
+    TraceLog::disable(TRACE_DISPATCH);
+    Agent::reset();
+    delete root;
+    unlink("resume.bin");
+    return true;
+  }
+
+  static bool testMonitorCapacity(){
+    PerformanceMonitor monitor;
+    monitor.setCapacity(10);
+    RStat usage(RStat::zeroed);
+    for(unsigned int i = 0; i < 1000; i++)
+      monitor.addTickData(usage, usage);
+    assertTrue(monitor.getData().size() >= 10 && monitor.getData().size() < 20);
+    assertTrue(monitor.getStats().size() == monitor.getData().size());
+    return true;
+  }
+
+  /**
+   * @brief Run the synchronization problem five times longer than usual in bounded memory mode. The archive
+   * frontier follows the execution, and once the first ticks are archived the database and the bookkeeping of
+   * each reactor stop growing: the late ticks use no more than the early ones.
+   */
+  static bool testCompaction(){
+    PseudoClock clock(0.0, 50);
+    TiXmlElement* root = initXml(findFile("synchronize.cfg").c_str());
+    root->SetAttribute("historyLimit", "10");
+    Agent::initialize(*root, clock, 300);
+    LogManager::instance().handleInit();
+
+    const char* names[] = {"r.0.0", "r.1.0"};
+    unsigned long early[2][4] = {{0}}, late[2][4] = {{0}};
+    while(!Agent::instance()->missionCompleted()){
+      Agent::instance()->doNext();
+      TICK tick = Agent::instance()->getCurrentTick();
+      if(tick < 50 || (tick >= 100 && tick < 250))
+	continue;
+
+      for(unsigned int i = 0; i < 2; i++){
+	DbCoreId db = Agent::instance()->getReactor(names[i]);
+	unsigned long usage[4];
+	db->getMemoryUsage(usage[0], usage[1], usage[2], usage[3]);
+	for(unsigned int j = 0; j < 4; j++){
+	  unsigned long& peak = (tick < 100 ? early[i][j] : late[i][j]);
+	  peak = std::max(peak, usage[j]);
+	}
+      }
+    }
+
+    const char* counts[] = {"tokens", "variables", "constraints", "keys"};
+    for(unsigned int i = 0; i < 2; i++){
+      DbCoreId db = Agent::instance()->getReactor(names[i]);
+      assertTrue(db->getArchiveFrontier() > 150, std::string("The archive frontier of ") + names[i] + " did not follow the execution");
+      for(unsigned int j = 0; j < 4; j++)
+	assertTrue(late[i][j] <= early[i][j], std::string("The ") + counts[j] + " of " + names[i] + " kept growing");
+    }
+
+    Agent::reset();
+    delete root;
+    return true;
+  }
 };
 
 int main() {
@@ -0,0 +1,171 @@
+#!/usr/bin/env python
+
+# System modules
+import sys,os
+import struct
+import mmap
+
+##############################################################################
+# BusReader
+#   This class complements the TREX ObservationBus. It follows the ring
+#   buffer the agent publishes in POSIX shared memory (bus attribute of the
+#   agent) and decodes its records. See ObservationBus.hh for the layout.
+#   Several readers can follow the same bus : none of them is known by the
+#   agent, which never waits for them.
+##############################################################################
+
+class BusRecord():
+  def __init__(self, kind, tick, data):
+    self.kind = kind
+    self.tick = tick
+    self.data = data
+
+class BusReader():
+  MAGIC = b"TRXBUS\0\0"
+  VERSION = 2
+  HEADER = struct.Struct("=8sII")
+  HEADER_SIZE = 64
+  U64 = struct.Struct("=Q")
+  HEAD_OFFSET = 16
+  TAIL_OFFSET = 24
+  # size, kind, 0 ; the tick follows except for PAD records
+  PAD_HEADER = struct.Struct("=IHH")
+  I32 = struct.Struct("=i")
+  RECORD_HEADER_SIZE = 12
+
+  PAD, OBSERVATION, REQUEST, RECALL, PLAN = range(5)
+  KINDS = ["pad", "observation", "request", "recall", "plan"]
+  # Value types of TREX::ObservationEncoder
+  BOOL, INT, FLOAT, STRING, SYMBOL = range(1, 6)
+
+  U8 = struct.Struct("=B")
+  U16 = struct.Struct("=H")
+  U32 = struct.Struct("=I")
+  F64 = struct.Struct("=d")
+  BOUNDS = struct.Struct("=dddd")
+
+  # Attach to the bus name (such as /trex.agent). Only the records published
+  # from now on are read unless from_start is set.
+  def __init__(self, name, from_start=False):
+    path = os.path.join("/dev/shm", name.lstrip("/"))
+    self.file = open(path, "rb")
+    self.map = mmap.mmap(self.file.fileno(), 0, access=mmap.ACCESS_READ)
+    magic, version, capacity = BusReader.HEADER.unpack_from(self.map, 0)
+    if magic != BusReader.MAGIC:
+      raise IOError("%s is not a TREX observation bus" % name)
+    if version != BusReader.VERSION:
+      raise IOError("Unsupported bus version %d" % version)
+    if BusReader.HEADER_SIZE + capacity > len(self.map):
+      raise IOError("Truncated observation bus %s" % name)
+    self.capacity = capacity
+    self.lost = 0
+    if from_start:
+      self.pos = self._tail()
+    else:
+      self.pos = self._head()
+
+  def close(self):
+    self.map.close()
+    self.file.close()
+
+  def _head(self):
+    return BusReader.U64.unpack_from(self.map, BusReader.HEAD_OFFSET)[0]
+
+  def _tail(self):
+    return BusReader.U64.unpack_from(self.map, BusReader.TAIL_OFFSET)[0]
+
+  # Next record or None if nothing new was published. Records overwritten
+  # before they could be read are counted in self.lost (in bytes)
+  def next(self):
+    while True:
+      head = self._head()
+      if self.pos >= head:
+        return None
+      tail = self._tail()
+      if self.pos < tail:
+        self.lost += tail - self.pos
+        self.pos = tail
+        continue
+
+      offset = BusReader.HEADER_SIZE + (self.pos & (self.capacity - 1))
+      size, kind, zero = BusReader.PAD_HEADER.unpack_from(self.map, offset)
+      valid = size >= BusReader.PAD_HEADER.size and size % 8 == 0 \
+          and offset + size <= len(self.map) \
+          and (kind == BusReader.PAD or size >= BusReader.RECORD_HEADER_SIZE)
+      record = None
+      if valid and kind != BusReader.PAD:
+        tick = BusReader.I32.unpack_from(self.map, offset + 8)[0]
+        data = self.map[offset + BusReader.RECORD_HEADER_SIZE:offset + size]
+        record = BusRecord(kind, tick, data)
+      # The agent may have overwritten the record while it was copied
+      if self.pos < self._tail():
+        continue
+      if not valid:
+        raise IOError("Corrupted observation bus record")
+      self.pos += size
+      if record:
+        return record
+
+  # All the records published since the last call
+  def records(self):
+    result = []
+    record = self.next()
+    while record:
+      result.append(record)
+      record = self.next()
+    return result
+
+  # Decode the payload of a record :
+  #  observation     : (timeline, predicate, [(name, value)])
+  #  request, recall : (timeline, predicate, (start_lb, start_ub), (end_lb, end_ub))
+  #  plan            : (reactor, [(timeline, [(predicate, (start_lb, start_ub), (end_lb, end_ub))])])
+  # Values are a bool, None for {false, true}, a (lb, ub) pair for numbers or a string
+  def decode(self, record):
+    cursor = [0]
+    data = record.data
+
+    def unpack(fmt):
+      val = fmt.unpack_from(data, cursor[0])
+      cursor[0] += fmt.size
+      return val
+    def string():
+      length = unpack(BusReader.U16)[0]
+      cursor[0] += length
+      return data[cursor[0] - length:cursor[0]].decode("utf-8", "replace")
+    def bounds():
+      start_lb, start_ub, end_lb, end_ub = unpack(BusReader.BOUNDS)
+      return ((start_lb, start_ub), (end_lb, end_ub))
+    def value():
+      kind = unpack(BusReader.U8)[0]
+      if kind == BusReader.BOOL:
+        flag = unpack(BusReader.U8)[0]
+        if flag == 2:
+          return None
+        return flag == 1
+      elif kind == BusReader.INT or kind == BusReader.FLOAT:
+        return (unpack(BusReader.F64)[0], unpack(BusReader.F64)[0])
+      return string()
+
+    if record.kind == BusReader.OBSERVATION:
+      timeline = string()
+      predicate = string()
+      params = [(string(), value()) for i in range(unpack(BusReader.U16)[0])]
+      return (timeline, predicate, params)
+    elif record.kind == BusReader.REQUEST or record.kind == BusReader.RECALL:
+      timeline = string()
+      predicate = string()
+      start, end = bounds()
+      return (timeline, predicate, start, end)
+    elif record.kind == BusReader.PLAN:
+      reactor = string()
+      timelines = []
+      for i in range(unpack(BusReader.U32)[0]):
+        timeline = string()
+        tokens = []
+        for j in range(unpack(BusReader.U32)[0]):
+          predicate = string()
+          start, end = bounds()
+          tokens.append((predicate, start, end))
+        timelines.append((timeline, tokens))
+      return (reactor, timelines)
+    raise IOError("Unknown bus record kind %d" % record.kind)
@@ -0,0 +1,184 @@
+#!/usr/bin/env python
+
+# System modules
+import sys,os
+import re
+import struct
+from collections import OrderedDict
+
+##############################################################################
+# StepLogReader
+#   This class complements the binary export of TREX::DbWriter. It reads the
+#   segmented step log (plans/steps.N.bin) written by a reactor configured
+#   with binaryPlans="1" and restores the PlanWorks layout for the steps
+#   asked for. With planKeyframe="N" most records only hold the lines of the
+#   entities that changed : the reader replays them over the last keyframe.
+##############################################################################
+
+# Decode a block written by TREX::compress (see Compression.hh)
+def uncompress(data, raw_size):
+  out = bytearray()
+  pos = 0
+  end = len(data)
+  while pos < end:
+    token = data[pos]
+    pos += 1
+    n_lit = token >> 4
+    length = token & 0xf
+    if n_lit == 15:
+      while True:
+        b = data[pos]
+        pos += 1
+        n_lit += b
+        if b != 255:
+          break
+    out += data[pos:pos+n_lit]
+    pos += n_lit
+    if pos >= end:
+      break
+    offset = data[pos] | (data[pos+1] << 8)
+    pos += 2
+    if length == 15:
+      while True:
+        b = data[pos]
+        pos += 1
+        length += b
+        if b != 255:
+          break
+    length += 4
+    start = len(out) - offset
+    if offset == 0 or start < 0:
+      raise IOError("Corrupted step record")
+    # The match may overlap what it produces
+    for i in range(length):
+      out.append(out[start+i])
+  if len(out) != raw_size:
+    raise IOError("Corrupted step record")
+  return bytes(out)
+
+class Step():
+  def __init__(self, tick, attempt, pp_id, sections, keyframe=True):
+    self.tick = tick
+    self.attempt = attempt
+    self.pp_id = pp_id
+    # False if the record only held what changed since the previous step
+    self.keyframe = keyframe
+    # file extension -> content
+    self.sections = sections
+
+  def name(self):
+    return "%d.%d.plan" % (self.tick, self.attempt)
+
+# Lines of each section grouped by their first column, the key of the entity they describe
+class PlanState():
+  # Column of the partial plan id in each section, rewritten for every step
+  PP_ID_COLUMN = {".objects": 3, ".tokens": 4, ".ruleInstances": 1, ".ruleInstanceSlaveMap": 2,
+                  ".variables": 1, ".constraints": 1, ".constraintVarMap": 2}
+
+  def __init__(self, names):
+    self.sections = OrderedDict([(name, OrderedDict()) for name in names])
+
+  def _groups(self, content):
+    groups = OrderedDict()
+    for line in content.splitlines():
+      fields = line.split(b"\t")
+      groups.setdefault(fields[0], []).append(fields)
+    return groups
+
+  def apply(self, contents, keyframe, removed):
+    if keyframe:
+      for name in self.sections:
+        self.sections[name] = OrderedDict()
+    else:
+      for section in self.sections.values():
+        for key in removed:
+          section.pop(key, None)
+    for (name, content) in contents.items():
+      self.sections[name].update(self._groups(content))
+
+  def render(self, pp_id):
+    pp_id = str(pp_id).encode("ascii")
+    contents = {}
+    for (name, section) in self.sections.items():
+      column = PlanState.PP_ID_COLUMN.get(name)
+      lines = []
+      for group in section.values():
+        for fields in group:
+          if column is not None and column < len(fields):
+            fields = fields[:column] + [pp_id] + fields[column+1:]
+          lines.append(b"\t".join(fields) + b"\n")
+      contents[name] = b"".join(lines)
+    return contents
+
+class StepLogReader():
+  MAGIC = "TRXSTEPS"
+  VERSION = 2
+  # Layout of the StepHeader in DbWriter.cc
+  HEADER = struct.Struct("=IIiIqII")
+  KEYFRAME = 1
+  U32 = struct.Struct("=I")
+  I32 = struct.Struct("=i")
+
+  def _u32(self, f):
+    return StepLogReader.U32.unpack(f.read(4))[0]
+
+  # The segments of the step log in a plans directory, in order
+  def segments(self, plans_dir):
+    found = []
+    for name in os.listdir(plans_dir):
+      m = re.match(r"steps\.(\d+)\.bin$", name)
+      if m:
+        found.append((int(m.group(1)), os.path.join(plans_dir, name)))
+    found.sort()
+    return [path for (index, path) in found]
+
+  # Iterate over the complete steps of a segment. A record truncated by a crash ends the segment.
+  def steps(self, file_name):
+    f = open(file_name, "rb")
+    if f.read(8).decode("ascii") != StepLogReader.MAGIC:
+      raise IOError("%s is not a TREX step log" % file_name)
+    version = self._u32(f)
+    if version != StepLogReader.VERSION:
+      raise IOError("Unsupported step log version %d" % version)
+    if self._u32(f) != StepLogReader.HEADER.size:
+      raise IOError("Step header size does not match this reader")
+    names = [f.read(self._u32(f)).decode("ascii") for i in range(self._u32(f))]
+    state = PlanState(names)
+
+    while True:
+      header = f.read(StepLogReader.HEADER.size)
+      if len(header) < StepLogReader.HEADER.size:
+        break
+      (size, raw_size, tick, attempt, pp_id, flags, reserved) = StepLogReader.HEADER.unpack(header)
+      block = bytearray(f.read(size))
+      if len(block) < size:
+        break
+      raw = uncompress(block, raw_size)
+      sections = {}
+      pos = 0
+      for name in names:
+        length = StepLogReader.U32.unpack(raw[pos:pos+4])[0]
+        sections[name] = raw[pos+4:pos+4+length]
+        pos += 4 + length
+      keyframe = (flags & StepLogReader.KEYFRAME) != 0
+      removed = []
+      if not keyframe:
+        count = StepLogReader.U32.unpack(raw[pos:pos+4])[0]
+        pos += 4
+        for i in range(count):
+          key = StepLogReader.I32.unpack(raw[pos:pos+4])[0]
+          removed.append(str(key).encode("ascii"))
+          pos += 4
+      state.apply(sections, keyframe, removed)
+      yield Step(tick, attempt, pp_id, state.render(pp_id), keyframe)
+    f.close()
+
+  # Write a step as DbWriter does in the PlanWorks layout
+  def write(self, step, plans_dir):
+    step_dir = os.path.join(plans_dir, step.name())
+    if not os.path.isdir(step_dir):
+      os.mkdir(step_dir)
+    for (name, content) in step.sections.items():
+      f = open(os.path.join(step_dir, "plan" + name), "wb")
+      f.write(content)
+      f.close()
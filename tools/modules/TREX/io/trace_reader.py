@@ -0,0 +1,93 @@
+#!/usr/bin/env python
+
+# System modules
+import sys,os
+import struct
+
+##############################################################################
+# TraceReader
+#   This class complements the TREX TraceLog. It loads the binary trace file
+#   written by the agent (trace.bin in the log directory) and renders the
+#   records in the same form as the TREX_INFO messages they replace.
+##############################################################################
+
+class TraceRecord():
+  def __init__(self, thread, nsec, tick, key, arg, reactor, category, event):
+    self.thread = thread
+    self.nsec = nsec
+    self.tick = tick
+    self.key = key
+    self.arg = arg
+    self.reactor = reactor
+    self.category = category
+    self.event = event
+
+class TraceReader():
+  MAGIC = "TRXTRACE"
+  VERSION = 1
+  # Layout of TREX::TraceRecord
+  RECORD = struct.Struct("=QIiiHBB")
+  U32 = struct.Struct("=I")
+
+  def __init__(self):
+    self.categories = []
+    self.events = []
+    self.reactors = []
+    self.records = []
+
+  def _u32(self, f):
+    return TraceReader.U32.unpack(f.read(4))[0]
+
+  def _string(self, f):
+    return f.read(self._u32(f)).decode("ascii")
+
+  # Load a trace file. Records of all threads are merged in date order
+  def load(self, file_name):
+    f = open(file_name, "rb")
+    if f.read(8).decode("ascii") != TraceReader.MAGIC:
+      raise IOError("%s is not a TREX trace file" % file_name)
+    version = self._u32(f)
+    if version != TraceReader.VERSION:
+      raise IOError("Unsupported trace version %d" % version)
+    if self._u32(f) != TraceReader.RECORD.size:
+      raise IOError("Trace record size does not match this reader")
+
+    self.categories = [self._string(f) for i in range(self._u32(f))]
+    self.events = []
+    for i in range(self._u32(f)):
+      category = self._u32(f)
+      marker = self._string(f)
+      text = self._string(f)
+      self.events.append((category, marker, text))
+    self.reactors = [self._string(f) for i in range(self._u32(f))]
+
+    self.records = []
+    for i in range(self._u32(f)):
+      thread = self._u32(f)
+      count = self._u32(f)
+      data = f.read(count*TraceReader.RECORD.size)
+      for j in range(count):
+        fields = TraceReader.RECORD.unpack_from(data, j*TraceReader.RECORD.size)
+        self.records.append(TraceRecord(thread, *fields))
+    f.close()
+
+    self.records.sort(key=lambda r: r.nsec)
+    return self.records
+
+  # Render a record as "[marker][reactor][tick]text"
+  def render(self, record):
+    category, marker, text = self.events[record.event]
+    reactor = self.reactors[record.reactor] if record.reactor < len(self.reactors) else "?"
+    text = text.replace("{key}", str(record.key)).replace("{arg}", str(record.arg))
+    return "[%s][%s][%d]%s" % (marker, reactor, record.tick, text)
+
+  def select(self, categories=None, reactors=None, key=None):
+    records = self.records
+    if categories:
+      ids = [self.categories.index(c) for c in categories]
+      records = [r for r in records if r.category in ids]
+    if reactors:
+      records = [r for r in records if self.reactors[r.reactor] in reactors]
+    if key is not None:
+      records = [r for r in records if r.key == key or r.arg == key]
+    return records